@@ -0,0 +1,629 @@
+/*------------------------------------------------
+
+  GAnimCompressed.cpp
+
+	compressed skeleton anim data. each bone has a rotation and
+	translation track, keys that can be interpolated from their
+	neighbours (within a tolerance) are removed and the rest are
+	quantized to 16 bits per component
+
+-------------------------------------------------*/
+
+
+//	Includes
+//------------------------------------------------
+#include "GAnimCompressed.h"
+#include "GBinaryData.h"
+#include "GDebug.h"
+
+
+//	globals
+//------------------------------------------------
+#define PACKED_QUATERNION_MAX		32767.f		//	15 bits per component
+#define PACKED_QUATERNION_RANGE		0.70710678f	//	the smaller three components of a unit quaternion are within +/- 1/sqrt(2)
+#define PACKED_TRANSLATION_MAX		65535.f
+
+
+//	Definitions
+//------------------------------------------------
+
+
+//-------------------------------------------------------------------------
+//	drop the largest component and store the other three in 15 bits each
+//-------------------------------------------------------------------------
+void PackQuaternion(const GQuaternion& Quaternion, GPackedQuaternion& Packed)
+{
+	int i;
+	GQuaternion Normalised( Quaternion );
+	Normalised.Normalise();
+
+	int Largest = 0;
+	for ( i=1;	i<4;	i++ )
+		if ( fabsf( Normalised.xyzw_a[i] ) > fabsf( Normalised.xyzw_a[Largest] ) )
+			Largest = i;
+
+	//	q and -q are the same rotation, flip so the dropped component is positive
+	float Sign = ( Normalised.xyzw_a[Largest] < 0.f ) ? -1.f : 1.f;
+
+	int c = 0;
+	for ( i=0;	i<4;	i++ )
+	{
+		if ( i == Largest )
+			continue;
+
+		float Value = ( Normalised.xyzw_a[i] * Sign / PACKED_QUATERNION_RANGE ) * 0.5f + 0.5f;
+		if ( Value < 0.f )	Value = 0.f;
+		if ( Value > 1.f )	Value = 1.f;
+
+		Packed.Data[c++] = (u16)( Value * PACKED_QUATERNION_MAX + 0.5f );
+	}
+
+	Packed.Data[0] |= (u16)( ( Largest & 1 ) << 15 );
+	Packed.Data[1] |= (u16)( ( Largest >> 1 ) << 15 );
+}
+
+
+void UnpackQuaternion(const GPackedQuaternion& Packed, GQuaternion& Quaternion)
+{
+	int Largest = ( Packed.Data[0] >> 15 ) | ( ( Packed.Data[1] >> 15 ) << 1 );
+
+	float LengthSq = 0.f;
+	int c = 0;
+	for ( int i=0;	i<4;	i++ )
+	{
+		if ( i == Largest )
+			continue;
+
+		float Value = ( (float)( Packed.Data[c++] & 0x7fff ) * ( 2.f / PACKED_QUATERNION_MAX ) - 1.f ) * PACKED_QUATERNION_RANGE;
+		Quaternion.xyzw_a[i] = Value;
+		LengthSq += Value * Value;
+	}
+
+	Quaternion.xyzw_a[Largest] = ( LengthSq < 1.f ) ? sqrtf( 1.f - LengthSq ) : 0.f;
+}
+
+
+//-------------------------------------------------------------------------
+//	angle between two rotations. acos of the dot product loses too much
+//	precision for small angles so this uses the chord lengths instead
+//-------------------------------------------------------------------------
+float QuaternionAngle(const GQuaternion& a, const GQuaternion& b)
+{
+	float Sign = ( a.xyzw.DotProduct( b.xyzw ) < 0.f ) ? -1.f : 1.f;
+
+	float DiffSq = 0.f;
+	float SumSq = 0.f;
+	for ( int i=0;	i<4;	i++ )
+	{
+		float Diff = a.xyzw_a[i] - b.xyzw_a[i] * Sign;
+		float Sum = a.xyzw_a[i] + b.xyzw_a[i] * Sign;
+		DiffSq += Diff * Diff;
+		SumSq += Sum * Sum;
+	}
+
+	return 4.f * atan2f( sqrtf( DiffSq ), sqrtf( SumSq ) );
+}
+
+
+GAnimCompressed::GAnimCompressed()
+{
+	m_BoneCount				= 0;
+	m_RotationTolerance		= ANIMCOMPRESSED_DEFAULT_ROTATION_TOLERANCE;
+	m_TranslationTolerance	= ANIMCOMPRESSED_DEFAULT_TRANSLATION_TOLERANCE;
+}
+
+
+//-------------------------------------------------------------------------
+//	build compressed tracks from the anim's keyframes
+//-------------------------------------------------------------------------
+void GAnimCompressed::Compress(GSkeletonAnim& Anim, float RotationTolerance, float TranslationTolerance)
+{
+	m_BoneCount				= Anim.m_BoneCount;
+	m_RotationTolerance		= RotationTolerance;
+	m_TranslationTolerance	= TranslationTolerance;
+
+	//	all the keyframes including the first frame
+	GList<GAnimKeyFrame*> Keyframes;
+	Keyframes.Add( &Anim.m_FirstFrame );
+	Keyframes.Add( Anim.m_Keyframes );
+
+	m_Frames.Resize( Keyframes.Size() );
+	m_RootOffsets.Resize( Keyframes.Size() );
+	for ( int k=0;	k<Keyframes.Size();	k++ )
+	{
+		Keyframes[k]->UpdateBoneCount( m_BoneCount );
+		m_Frames[k] = Keyframes[k]->m_FrameNumber;
+		m_RootOffsets[k] = Keyframes[k]->m_RootOffset;
+	}
+
+	m_RotationTracks.Resize( m_BoneCount );
+	m_TranslationTracks.Resize( m_BoneCount );
+	m_RotationKeys.Empty();
+	m_RotationKeyFrames.Empty();
+	m_TranslationKeys.Empty();
+	m_TranslationKeyFrames.Empty();
+
+	for ( int b=0;	b<m_BoneCount;	b++ )
+	{
+		CompressRotationTrack( b, Keyframes );
+		CompressTranslationTrack( b, Keyframes );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	quantize all the bone's rotations then keep only the keys needed to
+//	interpolate the rest within the tolerance. the error is measured
+//	against the quantized keys so the tolerance includes quantization
+//-------------------------------------------------------------------------
+void GAnimCompressed::CompressRotationTrack(int Bone, GList<GAnimKeyFrame*>& Keyframes)
+{
+	int k;
+	int Keys = Keyframes.Size();
+
+	GList<GQuaternion> Original;
+	GList<GPackedQuaternion> Packed;
+	GList<GQuaternion> Decoded;
+	Original.Resize( Keys );
+	Packed.Resize( Keys );
+	Decoded.Resize( Keys );
+
+	for ( k=0;	k<Keys;	k++ )
+	{
+		Original[k] = Keyframes[k]->m_Rotations[Bone];
+		Original[k].Normalise();
+		PackQuaternion( Original[k], Packed[k] );
+		UnpackQuaternion( Packed[k], Decoded[k] );
+	}
+
+	GList<int> KeptKeys;
+	KeptKeys.Add( 0 );
+
+	//	constant track only needs the first key
+	Bool Constant = TRUE;
+	for ( k=1;	k<Keys && Constant;	k++ )
+		if ( QuaternionAngle( Decoded[0], Original[k] ) > m_RotationTolerance )
+			Constant = FALSE;
+
+	if ( !Constant )
+	{
+		//	extend each segment until a key between its ends can't be interpolated
+		int Start = 0;
+		for ( int End=Start+2;	End<Keys;	End++ )
+		{
+			float FrameLength = m_Frames[End] - m_Frames[Start];
+			for ( int i=Start+1;	i<End;	i++ )
+			{
+				float t = ( m_Frames[i] - m_Frames[Start] ) / FrameLength;
+				if ( QuaternionAngle( InterpQ( Decoded[Start], Decoded[End], t ), Original[i] ) > m_RotationTolerance )
+				{
+					Start = End-1;
+					KeptKeys.Add( Start );
+					break;
+				}
+			}
+		}
+		KeptKeys.Add( Keys-1 );
+	}
+
+	GAnimRotationTrack& Track = m_RotationTracks[Bone];
+	Track.FirstKey = m_RotationKeys.Size();
+	Track.KeyCount = KeptKeys.Size();
+
+	for ( k=0;	k<KeptKeys.Size();	k++ )
+	{
+		m_RotationKeys.Add( Packed[ KeptKeys[k] ] );
+		m_RotationKeyFrames.Add( (u16)KeptKeys[k] );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	quantize translations in the range of the track then remove keys the
+//	same way as rotations
+//-------------------------------------------------------------------------
+void GAnimCompressed::CompressTranslationTrack(int Bone, GList<GAnimKeyFrame*>& Keyframes)
+{
+	int k, i;
+	int Keys = Keyframes.Size();
+
+	GAnimTranslationTrack& Track = m_TranslationTracks[Bone];
+
+	//	get range of the track
+	float3 Min = Keyframes[0]->m_Translations[Bone];
+	float3 Max = Min;
+	for ( k=1;	k<Keys;	k++ )
+	{
+		float3 Translation = Keyframes[k]->m_Translations[Bone];
+		for ( i=0;	i<3;	i++ )
+		{
+			if ( Translation[i] < Min[i] )	Min[i] = Translation[i];
+			if ( Translation[i] > Max[i] )	Max[i] = Translation[i];
+		}
+	}
+
+	Track.Min = Min;
+	Track.Scale = ( Max - Min ) * ( 1.f / PACKED_TRANSLATION_MAX );
+
+	GList<GPackedTranslation> Packed;
+	GList<float3> Decoded;
+	Packed.Resize( Keys );
+	Decoded.Resize( Keys );
+
+	for ( k=0;	k<Keys;	k++ )
+	{
+		float3 Translation = Keyframes[k]->m_Translations[Bone];
+		for ( i=0;	i<3;	i++ )
+		{
+			float Value = ( Track.Scale[i] > 0.f ) ? ( Translation[i] - Min[i] ) / Track.Scale[i] : 0.f;
+			if ( Value < 0.f )						Value = 0.f;
+			if ( Value > PACKED_TRANSLATION_MAX )	Value = PACKED_TRANSLATION_MAX;
+
+			Packed[k].Data[i] = (u16)( Value + 0.5f );
+			Decoded[k][i] = Min[i] + (float)Packed[k].Data[i] * Track.Scale[i];
+		}
+	}
+
+	GList<int> KeptKeys;
+	KeptKeys.Add( 0 );
+
+	//	constant track only needs the first key
+	Bool Constant = TRUE;
+	for ( k=1;	k<Keys && Constant;	k++ )
+		if ( ( Decoded[0] - Keyframes[k]->m_Translations[Bone] ).Length() > m_TranslationTolerance )
+			Constant = FALSE;
+
+	if ( !Constant )
+	{
+		int Start = 0;
+		for ( int End=Start+2;	End<Keys;	End++ )
+		{
+			float FrameLength = m_Frames[End] - m_Frames[Start];
+			for ( i=Start+1;	i<End;	i++ )
+			{
+				float t = ( m_Frames[i] - m_Frames[Start] ) / FrameLength;
+				float3 Translation = Decoded[Start] + ( Decoded[End] - Decoded[Start] ) * t;
+				if ( ( Translation - Keyframes[i]->m_Translations[Bone] ).Length() > m_TranslationTolerance )
+				{
+					Start = End-1;
+					KeptKeys.Add( Start );
+					break;
+				}
+			}
+		}
+		KeptKeys.Add( Keys-1 );
+	}
+
+	Track.FirstKey = m_TranslationKeys.Size();
+	Track.KeyCount = KeptKeys.Size();
+
+	for ( k=0;	k<KeptKeys.Size();	k++ )
+	{
+		m_TranslationKeys.Add( Packed[ KeptKeys[k] ] );
+		m_TranslationKeyFrames.Add( (u16)KeptKeys[k] );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	replace the anim's keyframes with our decoded keys
+//-------------------------------------------------------------------------
+Bool GAnimCompressed::Decompress(GSkeletonAnim& Anim)
+{
+	if ( m_Frames.Size() == 0 )
+	{
+		GDebug_Break("No compressed keys to decompress\n");
+		return FALSE;
+	}
+
+	Anim.SetBoneCount( m_BoneCount );
+	Anim.m_Keyframes.DeleteAll();
+
+	GetPose( m_Frames[0], Anim.m_FirstFrame );
+	Anim.m_FirstFrame.m_RootOffset = m_RootOffsets[0];
+	Anim.m_FirstFrame.UpdateValidRotMask();
+
+	for ( int k=1;	k<m_Frames.Size();	k++ )
+	{
+		GAnimKeyFrame* pKeyframe = Anim.AddKeyframe( m_Frames[k] );
+		if ( !pKeyframe )
+		{
+			GDebug_Break("Failed to add keyframe\n");
+			return FALSE;
+		}
+
+		GetPose( m_Frames[k], *pKeyframe );
+		pKeyframe->m_RootOffset = m_RootOffsets[k];
+		pKeyframe->UpdateValidRotMask();
+	}
+
+	return TRUE;
+}
+
+
+//-------------------------------------------------------------------------
+//	sample all bones at this frame
+//-------------------------------------------------------------------------
+void GAnimCompressed::GetPose(float Frame, GAnimPose& Pose)
+{
+	Pose.Resize( m_BoneCount );
+
+	GQuaternion* pRotations = Pose.m_Rotations.Data();
+	float3* pTranslations = Pose.m_Translations.Data();
+
+	for ( int b=0;	b<m_BoneCount;	b++ )
+	{
+		GetRotation( b, Frame, pRotations[b] );
+		GetTranslation( b, Frame, pTranslations[b] );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	binary search for the last of a track's keys at or before this frame
+//-------------------------------------------------------------------------
+int GAnimCompressed::FindTrackKey(const u16* pKeyFrames, int KeyCount, float Frame)
+{
+	const float* pFrames = m_Frames.DataConst();
+
+	int Low = 0;
+	int High = KeyCount;
+	while ( Low < High )
+	{
+		int Mid = ( Low + High ) >> 1;
+		if ( pFrames[ pKeyFrames[Mid] ] <= Frame )
+			Low = Mid+1;
+		else
+			High = Mid;
+	}
+
+	return ( Low > 0 ) ? Low-1 : 0;
+}
+
+
+void GAnimCompressed::GetRotation(int Bone, float Frame, GQuaternion& Rotation)
+{
+	const GAnimRotationTrack& Track = m_RotationTracks[Bone];
+	const GPackedQuaternion* pKeys = &m_RotationKeys[Track.FirstKey];
+	const u16* pKeyFrames = &m_RotationKeyFrames[Track.FirstKey];
+
+	int Key = ( Track.KeyCount > 1 ) ? FindTrackKey( pKeyFrames, Track.KeyCount, Frame ) : 0;
+	if ( Key >= (int)Track.KeyCount-1 )
+	{
+		UnpackQuaternion( pKeys[Key], Rotation );
+		return;
+	}
+
+	float From = m_Frames[ pKeyFrames[Key] ];
+	float To = m_Frames[ pKeyFrames[Key+1] ];
+	float t = ( Frame - From ) / ( To - From );
+	if ( t <= 0.f )
+	{
+		UnpackQuaternion( pKeys[Key], Rotation );
+		return;
+	}
+
+	GQuaternion FromRotation, ToRotation;
+	UnpackQuaternion( pKeys[Key], FromRotation );
+	UnpackQuaternion( pKeys[Key+1], ToRotation );
+	Rotation = InterpQ( FromRotation, ToRotation, t );
+}
+
+
+void GAnimCompressed::GetTranslation(int Bone, float Frame, float3& Translation)
+{
+	const GAnimTranslationTrack& Track = m_TranslationTracks[Bone];
+	const GPackedTranslation* pKeys = &m_TranslationKeys[Track.FirstKey];
+	const u16* pKeyFrames = &m_TranslationKeyFrames[Track.FirstKey];
+
+	int Key = ( Track.KeyCount > 1 ) ? FindTrackKey( pKeyFrames, Track.KeyCount, Frame ) : 0;
+	const GPackedTranslation& FromKey = pKeys[Key];
+	float3 From( Track.Min.x + (float)FromKey.Data[0] * Track.Scale.x,
+				 Track.Min.y + (float)FromKey.Data[1] * Track.Scale.y,
+				 Track.Min.z + (float)FromKey.Data[2] * Track.Scale.z );
+
+	if ( Key >= (int)Track.KeyCount-1 )
+	{
+		Translation = From;
+		return;
+	}
+
+	float FromFrame = m_Frames[ pKeyFrames[Key] ];
+	float ToFrame = m_Frames[ pKeyFrames[Key+1] ];
+	float t = ( Frame - FromFrame ) / ( ToFrame - FromFrame );
+	if ( t <= 0.f )
+	{
+		Translation = From;
+		return;
+	}
+
+	const GPackedTranslation& ToKey = pKeys[Key+1];
+	float3 To( Track.Min.x + (float)ToKey.Data[0] * Track.Scale.x,
+			   Track.Min.y + (float)ToKey.Data[1] * Track.Scale.y,
+			   Track.Min.z + (float)ToKey.Data[2] * Track.Scale.z );
+
+	Translation = From + ( To - From ) * t;
+}
+
+
+//-------------------------------------------------------------------------
+//	read the data after the anim's header. lists view the data if it's mapped
+//-------------------------------------------------------------------------
+Bool GAnimCompressed::Load(GBinaryData& Data, int BoneCount, int KeyframeCount)
+{
+	int b, k;
+
+	GAnimCompressedHeader Header;
+	if ( !Data.Read( &Header, GDataSizeOf(GAnimCompressedHeader), "Compressed anim header" ) )
+		return FALSE;
+
+	m_BoneCount				= BoneCount;
+	m_RotationTolerance		= Header.RotationTolerance;
+	m_TranslationTolerance	= Header.TranslationTolerance;
+
+	int Keys = KeyframeCount + 1;
+	if ( !Data.ReadList( m_Frames, Keys, "Compressed anim frames" ) )						return FALSE;
+	if ( !Data.ReadList( m_RootOffsets, Keys, "Compressed anim root offsets" ) )			return FALSE;
+	if ( !Data.ReadList( m_RotationTracks, BoneCount, "Compressed anim rotation tracks" ) )			return FALSE;
+	if ( !Data.ReadList( m_TranslationTracks, BoneCount, "Compressed anim translation tracks" ) )	return FALSE;
+	if ( !Data.ReadList( m_RotationKeys, Header.RotationKeys, "Compressed anim rotation keys" ) )	return FALSE;
+	if ( !Data.ReadList( m_RotationKeyFrames, Header.RotationKeys, "Compressed anim rotation key frames" ) )	return FALSE;
+	if ( !Data.ReadList( m_TranslationKeys, Header.TranslationKeys, "Compressed anim translation keys" ) )	return FALSE;
+	if ( !Data.ReadList( m_TranslationKeyFrames, Header.TranslationKeys, "Compressed anim translation key frames" ) )	return FALSE;
+
+	//	check the tracks are inside the key lists
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		const GAnimRotationTrack& RotationTrack = m_RotationTracks[b];
+		const GAnimTranslationTrack& TranslationTrack = m_TranslationTracks[b];
+
+		if ( RotationTrack.KeyCount == 0 || RotationTrack.FirstKey + RotationTrack.KeyCount > Header.RotationKeys ||
+			 TranslationTrack.KeyCount == 0 || TranslationTrack.FirstKey + TranslationTrack.KeyCount > Header.TranslationKeys )
+		{
+			GDebug_Break("Compressed anim bone %d's tracks are out of range\n", b );
+			return FALSE;
+		}
+	}
+
+	for ( k=0;	k<m_RotationKeyFrames.Size();	k++ )
+	{
+		if ( m_RotationKeyFrames[k] >= Keys )
+		{
+			GDebug_Break("Compressed anim rotation key %d has invalid keyframe %d\n", k, m_RotationKeyFrames[k] );
+			return FALSE;
+		}
+	}
+
+	for ( k=0;	k<m_TranslationKeyFrames.Size();	k++ )
+	{
+		if ( m_TranslationKeyFrames[k] >= Keys )
+		{
+			GDebug_Break("Compressed anim translation key %d has invalid keyframe %d\n", k, m_TranslationKeyFrames[k] );
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
+void GAnimCompressed::Save(GBinaryData& SaveData)
+{
+	GAnimCompressedHeader Header;
+	Header.RotationKeys			= m_RotationKeys.Size();
+	Header.TranslationKeys		= m_TranslationKeys.Size();
+	Header.RotationTolerance	= m_RotationTolerance;
+	Header.TranslationTolerance	= m_TranslationTolerance;
+	SaveData.Write( &Header, GDataSizeOf(GAnimCompressedHeader) );
+
+	//	4 byte aligned data first so mapped lists stay aligned
+	SaveData.Write( m_Frames.Data(), m_Frames.DataSize() );
+	SaveData.Write( m_RootOffsets.Data(), m_RootOffsets.DataSize() );
+	SaveData.Write( m_RotationTracks.Data(), m_RotationTracks.DataSize() );
+	SaveData.Write( m_TranslationTracks.Data(), m_TranslationTracks.DataSize() );
+	SaveData.Write( m_RotationKeys.Data(), m_RotationKeys.DataSize() );
+	SaveData.Write( m_RotationKeyFrames.Data(), m_RotationKeyFrames.DataSize() );
+	SaveData.Write( m_TranslationKeys.Data(), m_TranslationKeys.DataSize() );
+	SaveData.Write( m_TranslationKeyFrames.Data(), m_TranslationKeyFrames.DataSize() );
+}
+
+
+int GAnimCompressed::CompressedSize()
+{
+	return GDataSizeOf(GAnimCompressedHeader) +
+			m_Frames.DataSize() + m_RootOffsets.DataSize() +
+			m_RotationTracks.DataSize() + m_TranslationTracks.DataSize() +
+			m_RotationKeys.DataSize() + m_RotationKeyFrames.DataSize() +
+			m_TranslationKeys.DataSize() + m_TranslationKeyFrames.DataSize();
+}
+
+
+//-------------------------------------------------------------------------
+//	compare our keys with the anim's and print the error for each bone
+//	and how much smaller the compressed data is
+//-------------------------------------------------------------------------
+void GAnimCompressed::ReportError(GSkeletonAnim& Anim)
+{
+	int b, k;
+
+	if ( Anim.m_BoneCount != m_BoneCount || Anim.KeyframeCount()+1 != m_Frames.Size() )
+	{
+		GDebug_Break("Compressed keys don't match the anim being compared with\n");
+		return;
+	}
+
+	GList<float> MaxRotationError;
+	GList<float> MaxTranslationError;
+	MaxRotationError.Resize( m_BoneCount );
+	MaxTranslationError.Resize( m_BoneCount );
+	MaxRotationError.SetAll( 0.f );
+	MaxTranslationError.SetAll( 0.f );
+
+	float TotalRotationError = 0.f;
+	float TotalTranslationError = 0.f;
+
+	GAnimPose Pose;
+	for ( k=0;	k<m_Frames.Size();	k++ )
+	{
+		GAnimKeyFrame* pKeyframe = Anim.GetKeyframeIndex( k );
+		GetPose( m_Frames[k], Pose );
+
+		for ( b=0;	b<m_BoneCount;	b++ )
+		{
+			GQuaternion Original = pKeyframe->m_Rotations[b];
+			Original.Normalise();
+
+			float RotationError = QuaternionAngle( Original, Pose.m_Rotations[b] );
+			float TranslationError = ( pKeyframe->m_Translations[b] - Pose.m_Translations[b] ).Length();
+
+			TotalRotationError += RotationError;
+			TotalTranslationError += TranslationError;
+
+			if ( RotationError > MaxRotationError[b] )
+				MaxRotationError[b] = RotationError;
+			if ( TranslationError > MaxTranslationError[b] )
+				MaxTranslationError[b] = TranslationError;
+		}
+	}
+
+	GDebug::Print("Compressed anim %s: %d bones, %d keyframes\n", GAsset::RefToName( Anim.AssetRef() ), m_BoneCount, m_Frames.Size() );
+
+	int WorstRotationBone = 0;
+	int WorstTranslationBone = 0;
+	for ( b=0;	b<m_BoneCount;	b++ )
+	{
+		const GAnimRotationTrack& RotationTrack = m_RotationTracks[b];
+		const GAnimTranslationTrack& TranslationTrack = m_TranslationTracks[b];
+
+		GDebug::Print("  bone %3d: rotation %4d/%d keys, max error %.4f degrees. translation %4d/%d keys, max error %.5f\n",
+			b,
+			RotationTrack.KeyCount, m_Frames.Size(), RadToDeg( MaxRotationError[b] ),
+			TranslationTrack.KeyCount, m_Frames.Size(), MaxTranslationError[b] );
+
+		if ( MaxRotationError[b] > MaxRotationError[WorstRotationBone] )
+			WorstRotationBone = b;
+		if ( MaxTranslationError[b] > MaxTranslationError[WorstTranslationBone] )
+			WorstTranslationBone = b;
+	}
+
+	int Samples = m_Frames.Size() * m_BoneCount;
+	if ( Samples > 0 )
+	{
+		GDebug::Print("  rotation error: max %.4f degrees (bone %d), average %.4f degrees, tolerance %.4f degrees\n",
+			RadToDeg( MaxRotationError[WorstRotationBone] ), WorstRotationBone, RadToDeg( TotalRotationError / (float)Samples ), RadToDeg( m_RotationTolerance ) );
+		GDebug::Print("  translation error: max %.5f (bone %d), average %.5f, tolerance %.5f\n",
+			MaxTranslationError[WorstTranslationBone], WorstTranslationBone, TotalTranslationError / (float)Samples, m_TranslationTolerance );
+	}
+
+	//	size of the uncompressed keyframes as saved
+	int KeySize = m_BoneCount * ( sizeof(GQuaternion) + sizeof(float3) );
+	int UncompressedSize = KeySize + Anim.KeyframeCount() * ( KeySize + GDataSizeOf(GSkeletonAnimKeyframeHeader) );
+	int CompressedBytes = CompressedSize();
+
+	GDebug::Print("  %d rotation keys, %d translation keys. %d bytes, %d uncompressed (%.1f%%)\n",
+		m_RotationKeys.Size(), m_TranslationKeys.Size(), CompressedBytes, UncompressedSize,
+		UncompressedSize ? ( 100.f * (float)CompressedBytes / (float)UncompressedSize ) : 0.f );
+}
+
+
+
@@ -0,0 +1,148 @@
+/*------------------------------------------------
+
+  GAnimCompressed Header file
+
+	compressed skeleton anim data. each bone has a rotation and
+	translation track, keys that can be interpolated from their
+	neighbours (within a tolerance) are removed and the rest are
+	quantized to 16 bits per component
+
+-------------------------------------------------*/
+
+#ifndef __GANIMCOMPRESSED__H_
+#define __GANIMCOMPRESSED__H_
+
+
+
+//	Includes
+//------------------------------------------------
+#include "GMain.h"
+#include "GList.h"
+#include "GSkeleton.h"
+
+
+//	Macros
+//------------------------------------------------
+#define ANIMCOMPRESSED_DEFAULT_ROTATION_TOLERANCE		0.001f		//	radians
+#define ANIMCOMPRESSED_DEFAULT_TRANSLATION_TOLERANCE	0.001f
+
+
+
+//	Types
+//------------------------------------------------
+class GBinaryData;
+
+//-------------------------------------------------------------------------
+//	"smallest three" quaternion. the largest component is dropped (and
+//	rebuilt from the others as the quaternion is unit length) and the
+//	other three are stored in 15 bits each. the top bits of the first two
+//	hold the index of the dropped component
+//-------------------------------------------------------------------------
+typedef struct
+{
+	u16			Data[3];
+
+} GPackedQuaternion;
+
+
+//-------------------------------------------------------------------------
+//	translation quantized to 16 bits per axis in the range of its track
+//-------------------------------------------------------------------------
+typedef struct
+{
+	u16			Data[3];
+
+} GPackedTranslation;
+
+
+typedef struct
+{
+	u32			FirstKey;		//	index of the track's first key in the key lists
+	u32			KeyCount;		//	1 for a constant track
+
+} GAnimRotationTrack;
+
+
+typedef struct
+{
+	u32			FirstKey;		//	index of the track's first key in the key lists
+	u32			KeyCount;		//	1 for a constant track
+	float3		Min;			//	translation is Min + Key * Scale
+	float3		Scale;
+
+} GAnimTranslationTrack;
+
+
+typedef struct
+{
+	u32			RotationKeys;
+	u32			TranslationKeys;
+	float		RotationTolerance;
+	float		TranslationTolerance;
+
+} GAnimCompressedHeader;
+
+
+//-------------------------------------------------------------------------
+//	compressed keys for a skeleton anim. keys are indexes into the anim's
+//	keyframes (0 is the first frame) and tracks are interpolated between
+//	the keys they have left, so decoding is cheap enough to sample from
+//-------------------------------------------------------------------------
+class GAnimCompressed
+{
+protected:
+	int							m_BoneCount;
+	float						m_RotationTolerance;	//	max angle (radians) a removed rotation key can be from the interpolated rotation
+	float						m_TranslationTolerance;	//	max distance a removed translation key can be from the interpolated translation
+	GList<float>				m_Frames;				//	frame number of each of the anim's keyframes, including the first frame
+	GList<float3>				m_RootOffsets;			//	root offset of each keyframe
+	GList<GAnimRotationTrack>	m_RotationTracks;		//	track for each bone
+	GList<GAnimTranslationTrack>	m_TranslationTracks;	//	track for each bone
+	GList<GPackedQuaternion>	m_RotationKeys;
+	GList<u16>					m_RotationKeyFrames;	//	keyframe index of each rotation key
+	GList<GPackedTranslation>	m_TranslationKeys;
+	GList<u16>					m_TranslationKeyFrames;	//	keyframe index of each translation key
+
+public:
+	GAnimCompressed();
+
+	void						Compress(GSkeletonAnim& Anim, float RotationTolerance=ANIMCOMPRESSED_DEFAULT_ROTATION_TOLERANCE, float TranslationTolerance=ANIMCOMPRESSED_DEFAULT_TRANSLATION_TOLERANCE);
+	Bool						Decompress(GSkeletonAnim& Anim);		//	replace the anim's keyframes with our decoded keys
+	void						GetPose(float Frame, GAnimPose& Pose);	//	sample all bones at this frame
+
+	Bool						Load(GBinaryData& Data, int BoneCount, int KeyframeCount);	//	KeyframeCount doesn't include the first frame
+	void						Save(GBinaryData& Data);
+	int							CompressedSize();						//	bytes of saved data
+
+	void						ReportError(GSkeletonAnim& Anim);		//	print how far our keys are from the anim's and how much smaller they are
+
+	inline int					KeyCount()								{	return m_Frames.Size();	};
+	inline float				RotationTolerance()						{	return m_RotationTolerance;	};
+	inline float				TranslationTolerance()					{	return m_TranslationTolerance;	};
+
+protected:
+	void						CompressRotationTrack(int Bone, GList<GAnimKeyFrame*>& Keyframes);
+	void						CompressTranslationTrack(int Bone, GList<GAnimKeyFrame*>& Keyframes);
+	int							FindTrackKey(const u16* pKeyFrames, int KeyCount, float Frame);	//	last key at or before this frame
+	void						GetRotation(int Bone, float Frame, GQuaternion& Rotation);
+	void						GetTranslation(int Bone, float Frame, float3& Translation);
+};
+
+
+
+//	Declarations
+//------------------------------------------------
+void		PackQuaternion(const GQuaternion& Quaternion, GPackedQuaternion& Packed);
+void		UnpackQuaternion(const GPackedQuaternion& Packed, GQuaternion& Quaternion);
+float		QuaternionAngle(const GQuaternion& a, const GQuaternion& b);		//	angle (radians) between two unit quaternions
+
+
+
+//	Inline Definitions
+//-------------------------------------------------
+
+
+
+
+#endif
+
@@ -49,6 +49,7 @@ const char	g_AssetRefCharTableAlt[AssetRefCharTableSize+1] = {	"?ABCDEFGHIJKLMNO
 GAsset::GAsset()
 {
 	m_AssetRef = GAssetRef_Invalid;
+	m_LoadVersion = 0;
 }
 
 
@@ -63,7 +64,7 @@ GAsset::~GAsset()
 Bool GAsset::LoadAsset(GAssetHeader* pAssetHeader,GBinaryData& Data)
 {
 	//	check version
-	if ( pAssetHeader->AssetVersion != Version() )
+	if ( !SupportsVersion( pAssetHeader->AssetVersion ) )
 	{
 		GDebug::Print("%s version mismatch: 0x%08x should be 0x%08x\n", AssetTypeName(), pAssetHeader->AssetVersion, Version() );
 		return FALSE;
@@ -72,7 +73,12 @@ Bool GAsset::LoadAsset(GAssetHeader* pAssetHeader,GBinaryData& Data)
 	//	copy generic asset data from asset header
 	m_AssetRef = pAssetHeader->AssetRef;
 
-	return Load( Data );
+	//	let the asset know what version it's loading
+	m_LoadVersion = pAssetHeader->AssetVersion;
+	Bool Loaded = Load( Data );
+	m_LoadVersion = 0;
+
+	return Loaded;
 }
 
 
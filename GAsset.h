@@ -90,6 +90,9 @@ class GAsset
 public:
 	GAssetRef	m_AssetRef;				//	unique reference per asset
 
+protected:
+	u32			m_LoadVersion;			//	version of the data being loaded by LoadAsset. 0 when Load is called directly with current data
+
 
 public:
 	GAsset();
@@ -104,6 +107,7 @@ public:
 	const char*			AssetTypeName()									{	return g_AssetTypeNames[AssetType()];	};
 	virtual GAssetType	AssetType()										{	return GAssetUnknown;	};
 	virtual u32			Version()										{	return 0xffffffff;	};
+	virtual Bool		SupportsVersion(u32 AssetVersion)				{	return AssetVersion == Version();	};	//	can we load data saved with this version. overload to keep loading older data
 
 	//	file io
 	Bool				LoadAsset(GAssetHeader* pAssetHeader,GBinaryData& Data);		//	loads in generic asset stuff, do not overload
@@ -2,8 +2,8 @@
 
   GAssetList.cpp
 
-	List of Assets loaded. Provides quick access via AssetRef's (looking up a sorted
-	table) and manages Assetes. (no duplicate references, inserting Assetes in order etc)
+	List of Assets loaded. Provides quick access via AssetRef's (looking up a hash
+	table) and manages Assetes. (no duplicate references, stable slots etc)
 
 	templated for additional asset specific functions
 
@@ -14,6 +14,7 @@
 //	Includes
 //------------------------------------------------
 #include "GAssetList.h"
+#include "GFile.h"
 
 
 //	globals
@@ -40,6 +41,9 @@ void GAssets::ClearAssets()
 	GAssets::g_Skins.Empty();
 	GAssets::g_Skeletons.Empty();
 	GAssets::g_SkeletonAnims.Empty();
+
+	//	no assets left to be viewing mapped files
+	GFile::ReleaseKeptMappings();
 }
 	
 
@@ -47,40 +51,48 @@ void GAssets::AddToList(GList<GAsset*>& AssetList)
 {
 	int i;
 
-	for ( i=0;	i<GAssets::g_Meshes.Size();	i++ )
-		AssetList.Add( GAssets::g_Meshes[i] );
+	for ( i=0;	i<GAssets::g_Meshes.SlotCount();	i++ )
+		if ( GAssets::g_Meshes[i] )
+			AssetList.Add( GAssets::g_Meshes[i] );
 
-	for ( i=0;	i<GAssets::g_Textures.Size();	i++ )
-		AssetList.Add( GAssets::g_Textures[i] );
+	for ( i=0;	i<GAssets::g_Textures.SlotCount();	i++ )
+		if ( GAssets::g_Textures[i] )
+			AssetList.Add( GAssets::g_Textures[i] );
 
-	for ( i=0;	i<GAssets::g_Maps.Size();	i++ )
-		AssetList.Add( GAssets::g_Maps[i] );
+	for ( i=0;	i<GAssets::g_Maps.SlotCount();	i++ )
+		if ( GAssets::g_Maps[i] )
+			AssetList.Add( GAssets::g_Maps[i] );
 
-	for ( i=0;	i<GAssets::g_MapObjects.Size();	i++ )
-		AssetList.Add( GAssets::g_MapObjects[i] );
+	for ( i=0;	i<GAssets::g_MapObjects.SlotCount();	i++ )
+		if ( GAssets::g_MapObjects[i] )
+			AssetList.Add( GAssets::g_MapObjects[i] );
 
-	for ( i=0;	i<GAssets::g_Skins.Size();	i++ )
-		AssetList.Add( GAssets::g_Skins[i] );
+	for ( i=0;	i<GAssets::g_Skins.SlotCount();	i++ )
+		if ( GAssets::g_Skins[i] )
+			AssetList.Add( GAssets::g_Skins[i] );
 
-	for ( i=0;	i<GAssets::g_Skeletons.Size();	i++ )
-		AssetList.Add( GAssets::g_Skeletons[i] );
+	for ( i=0;	i<GAssets::g_Skeletons.SlotCount();	i++ )
+		if ( GAssets::g_Skeletons[i] )
+			AssetList.Add( GAssets::g_Skeletons[i] );
 
-	for ( i=0;	i<GAssets::g_SkeletonAnims.Size();	i++ )
-		AssetList.Add( GAssets::g_SkeletonAnims[i] );
+	for ( i=0;	i<GAssets::g_SkeletonAnims.SlotCount();	i++ )
+		if ( GAssets::g_SkeletonAnims[i] )
+			AssetList.Add( GAssets::g_SkeletonAnims[i] );
 
 }
 
 
 
-int GAssets::AddFromList(GList<GAsset*>& AssetList)
+int GAssets::AddFromList(GList<GAsset*>& AssetList,GList<GAsset*>* pNotAdded)
 {
 	int Loaded = 0;
 	for ( int i=0;	i<AssetList.Size();	i++ )
 	{
 			//	add in all the assets from the file into the world
 		GAsset* pAsset = AssetList[i];
+		Bool Added = FALSE;
 
-		#define ADD_ASSET_TO_LIST(ASSETTYPE,TYPE,LIST)	case ASSETTYPE:	if ( GAssets::LIST.Add( (TYPE*)pAsset ) )	Loaded++;	break
+		#define ADD_ASSET_TO_LIST(ASSETTYPE,TYPE,LIST)	case ASSETTYPE:	Added = GAssets::LIST.Add( (TYPE*)pAsset );	break
 
 		switch ( pAsset->AssetType() )
 		{
@@ -96,6 +108,11 @@ int GAssets::AddFromList(GList<GAsset*>& AssetList)
 				GDebug::Break("Unhandled asset type %d (%s)\n", pAsset->AssetType(), pAsset->AssetTypeName() );
 				break;
 		}
+
+		if ( Added )
+			Loaded++;
+		else if ( pNotAdded )
+			pNotAdded->Add( pAsset );
 	}
 
 	return Loaded;
@@ -103,3 +120,26 @@ int GAssets::AddFromList(GList<GAsset*>& AssetList)
 
 
 
+Bool GAssets::AddLazy(GAssetType Type, GAssetRef Ref, u8* pBlock, u32 BlockSize)
+{
+	#define ADD_LAZY_ASSET_TO_LIST(ASSETTYPE,LIST)	case ASSETTYPE:	return GAssets::LIST.AddLazy( Ref, pBlock, BlockSize )
+
+	switch ( Type )
+	{
+		ADD_LAZY_ASSET_TO_LIST( GAssetMesh,			g_Meshes	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetTexture,		g_Textures	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetMap,			g_Maps	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetMapObject,	g_MapObjects	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetSkeleton,		g_Skeletons	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetSkin,			g_Skins	);
+		ADD_LAZY_ASSET_TO_LIST( GAssetSkeletonAnim,	g_SkeletonAnims );
+		default:
+			GDebug::Print("Unhandled lazy asset type %d\n", Type );
+			break;
+	}
+
+	return FALSE;
+}
+
+
+
@@ -17,6 +17,7 @@
 #include "GList.h"
 #include "GAsset.h"
 #include "GDebug.h"
+#include "GBinaryData.h"
 #include "GMesh.h"
 #include "GTexture.h"
 #include "GMap.h"
@@ -27,7 +28,7 @@
 
 //	Macros
 //------------------------------------------------
-
+#define GASSETLIST_MIN_TABLE_SIZE	16		//	smallest hash table size (must be power of 2)
 
 
 
@@ -39,37 +40,64 @@ class GAssetRefIndex
 {
 public:
 	GAssetRef	Ref;	//	the asset's ref
-	int			Index;	//	index in m_Meshes
+	int			Index;	//	slot in m_Assets, -1 if this hash table entry is empty
 	
 public:
 	inline Bool		operator == (GAssetRefIndex& ri)		{	return (Ref==ri.Ref) && (Index==ri.Index);	};
 };
 
 
+//-------------------------------------------------------------------------
+//	asset that hasn't been loaded yet. its block (asset header and data)
+//	is in a mapped file that stays open (see GFile::KeepMapping)
+//-------------------------------------------------------------------------
+typedef struct
+{
+	GAssetRef	Ref;		//	ref from the file's table of contents
+	u8*			pBlock;		//	GAssetHeader followed by asset data. NULL if the slot isn't lazy
+	u32			BlockSize;	//	size including the GAssetHeader
+
+} GAssetLazyBlock;
 
+
+
+//-------------------------------------------------------------------------
+//	assets are stored in slots which stay the same until the asset is
+//	removed. refs are looked up with an open addressing (linear probing)
+//	hash table of ref->slot, so add, find and remove are all O(1).
+//	removed slots are NULL until reused, so iterate with SlotCount().
+//	assets can also be added lazily, they're loaded on first access
+//-------------------------------------------------------------------------
 template <class TYPE>
 class GAssetList
 {
 private:
-	GList<TYPE*>			m_Assets;		//	list of all the asset data in the list
-	GList<GAssetRefIndex>	m_AssetRefs;	//	list of meshreferences and their index in our mesh's list, sorted by references
+	GList<TYPE*>			m_Assets;		//	asset in each slot, NULL if the slot is free
+	GList<GAssetLazyBlock>	m_LazyBlocks;	//	data to load each slot's asset from on first access
+	GList<int>				m_FreeSlots;	//	free slots in m_Assets to reuse
+	GList<GAssetRefIndex>	m_HashTable;	//	ref->slot table, size is a power of 2 and kept at most half full
+	int						m_Count;		//	number of assets in the list
 
 public:
 	GAssetList();
 	~GAssetList();
 
 	void			Empty();						//	delete all meshes
-	inline int		Size()							{	return m_Assets.Size();	};
+	inline int		Size()							{	return m_Count;	};			//	number of assets
+	inline int		SlotCount()						{	return m_Assets.Size();	};	//	number of slots (some may be empty)
 	Bool			Add(TYPE* pAsset);				//	add a mesh will fail if there are any duplicate references
+	Bool			AddLazy(GAssetRef Ref, u8* pBlock, u32 BlockSize);	//	add an asset that's loaded from this block on first access. block must stay valid
 	Bool			Delete(GAssetRef Ref);			//	deletes the mesh matching the reference
 	Bool			Remove(GAssetRef Ref);			//	removes the asset matching this poitner from the list
 	Bool			Remove(TYPE* pAsset)			{	int Index;	return ( ( Index = FindIndex(pAsset) ) != -1 ) ? RemoveIndex( Index ) : FALSE;	};
 	
 	inline TYPE*	Find(const char* pRefName)		{	return Find( GAsset::NameToRef(pRefName) );	};		//	find the mesh matching the reference
 	TYPE*			Find(GAssetRef Ref);			//	find the mesh matching the reference
-	int				FindIndex(GAssetRef Ref);		//	find the reference index for this reference
-	int				FindIndex(TYPE* pAsset);		//	find the index for this asset
-	inline TYPE*	GetAsset(int Index)				{	GDebug_CheckIndex(Index,0,Size() );	return (Index<0||Index>=Size()) ? NULL : m_Assets[Index];	};
+	int				FindIndex(GAssetRef Ref);		//	find the slot for this reference
+	int				FindIndex(TYPE* pAsset);		//	find the slot for this asset
+	inline TYPE*	GetAsset(int Index)				{	GDebug_CheckIndex(Index,0,SlotCount() );	return (Index<0||Index>=SlotCount()) ? NULL : ( m_Assets[Index] ? m_Assets[Index] : LoadLazy(Index) );	};	//	asset in slot (loaded if lazy), NULL if slot is empty
+	inline Bool		IsLoaded(int Index)				{	return GetAssetLoaded(Index) != NULL;	};
+	inline TYPE*	GetAssetLoaded(int Index)		{	return (Index<0||Index>=SlotCount()) ? NULL : m_Assets[Index];	};	//	asset in slot, NULL if slot is empty or not loaded yet
 	void			ChangeAssetRef(GAssetRef OldRef, GAssetRef NewRef);	//	change asset and asset indexes to change the ref
 
 	GAssetRef		GetNextFreeRef();				//	get the next availible asset ref. not for use in realtime
@@ -77,11 +105,15 @@ public:
 	inline TYPE*	operator[](int Index)			{	return GetAsset(Index);	};
 
 private:
-	Bool			DeleteIndex(int Index);			//	deletes the mesh matching the reference
-	Bool			RemoveIndex(int Index);			//	removes the mesh matching the reference
-	int				FindAssetIndex(GAssetRef Ref);	//	find the mesh index for this reference
-	void			ReIndexRefs();					//	update the mesh indexes in the meshrefs
-	void			ReSortRefs();					//	resort the asset index list. needs to be called if any asset refs are changed
+	Bool			DeleteIndex(int Index);			//	deletes the asset in this slot
+	Bool			RemoveIndex(int Index);			//	removes the asset in this slot from the list
+	int				AllocSlot();					//	get a free slot
+	TYPE*			LoadLazy(int Index);			//	load a lazy asset, removes it from the list if it fails
+	int				FindTableIndex(GAssetRef Ref);	//	find the hash table entry for this ref, -1 if not found
+	void			AddToTable(GAssetRef Ref, int Slot);	//	add a ref->slot entry, grows the table if needed
+	void			RemoveFromTable(int TableIndex);		//	remove a hash table entry, moves back entries after it
+	void			ResizeTable(int TableSize);			//	rehash all the refs into a new table size
+	static inline u32	HashRef(GAssetRef Ref);			//	scatter bits of a ref
 };
 
 
@@ -127,7 +159,8 @@ namespace GAssets
 	
 	void					ClearAssets();
 	void					AddToList(GList<GAsset*>& AssetList);	//	adds all our global assets into this asset list
-	int						AddFromList(GList<GAsset*>& AssetList);	//	adds all elements from a list into the global assets
+	int						AddFromList(GList<GAsset*>& AssetList,GList<GAsset*>* pNotAdded=NULL);	//	adds all elements from a list into the global assets. assets that can't be added (eg. duplicates) are put in pNotAdded
+	Bool					AddLazy(GAssetType Type, GAssetRef Ref, u8* pBlock, u32 BlockSize);	//	add an asset to be loaded from this block when it's first accessed
 };	
 
 
@@ -148,6 +181,7 @@ namespace GAssets
 template <class TYPE>
 GAssetList<TYPE>::GAssetList()
 {
+	m_Count = 0;
 }
 
 
@@ -164,11 +198,17 @@ GAssetList<TYPE>::~GAssetList()
 template <class TYPE>
 void GAssetList<TYPE>::Empty()
 {
-	//	remove the first Asset until theyre all gone
-	while ( m_Assets.Size() > 0 )
+	//	delete all the assets
+	for ( int i=0;	i<m_Assets.Size();	i++ )
 	{
-		DeleteIndex(0);
+		DeleteIndex(i);
 	}
+
+	m_Assets.Empty();
+	m_LazyBlocks.Empty();
+	m_FreeSlots.Empty();
+	m_HashTable.Empty();
+	m_Count = 0;
 }
 
 
@@ -176,59 +216,129 @@ void GAssetList<TYPE>::Empty()
 template <class TYPE>
 Bool GAssetList<TYPE>::Add(TYPE* pAsset)
 {
-	int i;
 	GAssetRef& ref = pAsset->m_AssetRef;
 	
 	//	find duplicate Asset ref
-	if ( FindIndex( ref ) != -1 )
+	if ( FindTableIndex( ref ) != -1 )
 	{
 		GDebug::Print("Error inserting Asset into Asset list, duplicate Asset ref: 0x%08x\n", ref );
 		return FALSE;
 	}
 
-	//	setup new index
-	GAssetRefIndex RefIndex;
-	RefIndex.Ref = ref;
-	RefIndex.Index = -1;
-	
-	//	add Asset into list
-	RefIndex.Index = m_Assets.Add( pAsset );
-	if ( RefIndex.Index == -1 )
+	int Slot = AllocSlot();
+	if ( Slot == -1 )
 	{
 		GDebug_Break("Error inserting Asset into Asset list");
 		return FALSE;
 	}
-	
-	//	find index to insert refindex into (sorted)
-	int RefIndexIndex = -1;
-	for ( i=0;	i<m_AssetRefs.Size();	i++ )
+
+	m_Assets[Slot] = pAsset;
+	AddToTable( ref, Slot );
+	m_Count++;
+
+	return TRUE;
+}
+
+
+
+template <class TYPE>
+Bool GAssetList<TYPE>::AddLazy(GAssetRef Ref, u8* pBlock, u32 BlockSize)
+{
+	//	find duplicate Asset ref
+	if ( FindTableIndex( Ref ) != -1 )
 	{
-		if ( ref < m_AssetRefs[i].Ref )
-		{
-			RefIndexIndex = i;
-			break;
-		}
+		GDebug::Print("Error inserting lazy Asset into Asset list, duplicate Asset ref: 0x%08x\n", Ref );
+		return FALSE;
 	}
 
-	//	if we havent got an index, add onto the end of the list
-	if ( RefIndexIndex == -1 )
+	int Slot = AllocSlot();
+	if ( Slot == -1 )
+	{
+		GDebug_Break("Error inserting Asset into Asset list");
+		return FALSE;
+	}
+
+	GAssetLazyBlock& Lazy = m_LazyBlocks[Slot];
+	Lazy.Ref		= Ref;
+	Lazy.pBlock		= pBlock;
+	Lazy.BlockSize	= BlockSize;
+
+	AddToTable( Ref, Slot );
+	m_Count++;
+
+	return TRUE;
+}
+
+
+
+//-------------------------------------------------------------------------
+//	reuse a free slot or add a new one. new slot is empty and not lazy
+//-------------------------------------------------------------------------
+template <class TYPE>
+int GAssetList<TYPE>::AllocSlot()
+{
+	int Slot = -1;
+	if ( m_FreeSlots.Size() )
 	{
-		RefIndexIndex = m_AssetRefs.Add( RefIndex );
+		Slot = m_FreeSlots.ElementLast();
+		m_FreeSlots.RemoveLast();
 	}
 	else
 	{
-		m_AssetRefs.Insert( RefIndexIndex, RefIndex );
+		Slot = m_Assets.Size();
+		m_Assets.Resize( Slot+1 );
+		m_LazyBlocks.Resize( Slot+1 );
 	}
 
-/*
-	GDebug::Print("New list of refs:\n");
-	for ( i=0;	i<m_AssetRefs.Size();	i++ )
+	if ( Slot != -1 )
 	{
-		GDebug::Print("%d: %08x \"%s\" (%d)\n", i, m_AssetRefs[i].Ref, GAsset::RefToName(m_AssetRefs[i].Ref), m_AssetRefs[i].Index );
+		m_Assets[Slot] = NULL;
+		m_LazyBlocks[Slot].pBlock = NULL;
 	}
-*/
 
-	return TRUE;
+	return Slot;
+}
+
+
+
+//-------------------------------------------------------------------------
+//	load a lazy asset from its block
+//-------------------------------------------------------------------------
+template <class TYPE>
+TYPE* GAssetList<TYPE>::LoadLazy(int Index)
+{
+	//	copy the block, loading can add assets to this list and realloc it
+	GAssetLazyBlock Lazy = m_LazyBlocks[Index];
+	if ( !Lazy.pBlock )
+		return NULL;
+
+	//	view the block without copying it
+	GBinaryData Data;
+	Data.SetView( Lazy.pBlock, Lazy.BlockSize );
+
+	TYPE* pAsset = NULL;
+	GAssetHeader AssetHeader;
+	if ( Data.Read( &AssetHeader, sizeof(GAssetHeader), "Asset header" ) )
+	{
+		pAsset = new TYPE;
+		if ( !pAsset->LoadAsset( &AssetHeader, Data ) || pAsset->m_AssetRef != Lazy.Ref )
+		{
+			GDelete( pAsset );
+		}
+	}
+
+	//	failed, remove from the list so we dont try again
+	if ( !pAsset )
+	{
+		GDebug::Print("Failed to load asset 0x%08x (\"%s\") on demand\n", Lazy.Ref, GAsset::RefToName( Lazy.Ref ) );
+		RemoveIndex( Index );
+		return NULL;
+	}
+
+	m_LazyBlocks[Index].pBlock = NULL;
+	m_Assets[Index] = pAsset;
+
+	return pAsset;
 }
 
 
@@ -263,10 +373,14 @@ template <class TYPE>
 TYPE* GAssetList<TYPE>::Find(GAssetRef Ref)
 {
 	//	find the index
-	int Index = FindAssetIndex( Ref );
+	int Index = FindIndex( Ref );
 	if ( Index == -1 )
 		return NULL;
 
+	//	load it if it's lazy
+	if ( !m_Assets[Index] )
+		return LoadLazy( Index );
+
 	return m_Assets[Index];
 }
 
@@ -282,21 +396,13 @@ Bool GAssetList<TYPE>::DeleteIndex(int Index)
 		return FALSE;
 	}
 
-	//	grab the Asset's index
-	int AssetIndex = m_AssetRefs[Index].Index;
-
-	//	remove the Asset reference
-	m_AssetRefs.RemoveAt( Index );
+	//	remove from the list first, assets can try to remove themselves when deleted
+	TYPE* pAsset = m_Assets[Index];
+	if ( !RemoveIndex( Index ) )
+		return FALSE;
 
-	GDebug_CheckIndex( AssetIndex, 0, m_Assets.Size() );
-	
 	//	delete the Asset
-	GDelete( m_Assets[AssetIndex] );
-	m_Assets.RemoveAt( AssetIndex );
-
-	//	we've removed an index from somewhere in the list, the list needs re-indexing!
-	ReIndexRefs();
-
+	GDelete( pAsset );
 
 	return TRUE;
 }
@@ -313,110 +419,191 @@ Bool GAssetList<TYPE>::RemoveIndex(int Index)
 		return FALSE;
 	}
 
-	//	grab the Asset's index
-	int AssetIndex = m_AssetRefs[Index].Index;
+	//	get the ref from the asset, or from the lazy block if it's not loaded yet
+	TYPE* pAsset = m_Assets[Index];
+	GAssetLazyBlock& Lazy = m_LazyBlocks[Index];
+	GAssetRef Ref;
+	if ( pAsset )
+		Ref = pAsset->m_AssetRef;
+	else if ( Lazy.pBlock )
+		Ref = Lazy.Ref;
+	else
+		return FALSE;	//	slot already empty
 
 	//	remove the Asset reference
-	m_AssetRefs.RemoveAt( Index );
-
-	GDebug_CheckIndex( AssetIndex, 0, m_Assets.Size() );
-	
-	m_Assets.RemoveAt( AssetIndex );
-
-	//	we've removed an index from somewhere in the list, the list needs re-indexing!
-	ReIndexRefs();
+	int TableIndex = FindTableIndex( Ref );
+	if ( TableIndex == -1 || m_HashTable[TableIndex].Index != Index )
+	{
+		GDebug_Break("Asset list hash table is out of sync with asset's ref\n");
+		return FALSE;
+	}
+	RemoveFromTable( TableIndex );
 
+	//	free the slot. other slots are unaffected
+	m_Assets[Index] = NULL;
+	Lazy.pBlock = NULL;
+	m_FreeSlots.Add( Index );
+	m_Count--;
 
 	return TRUE;
 }
 
 
 //-------------------------------------------------------------------------
-//	returns the AssetRef index
+//	returns the slot for this ref
 //-------------------------------------------------------------------------
 template <class TYPE>
 int GAssetList<TYPE>::FindIndex(GAssetRef Ref)
 {
-	//	change this to use the GList sorting functions
-
-	for ( int i=0;	i<m_AssetRefs.Size();	i++ )
-	{
-		if ( m_AssetRefs[i].Ref == Ref )
-			return i;
-	}
+	int TableIndex = FindTableIndex( Ref );
+	if ( TableIndex == -1 )
+		return -1;
 
-	//	not found
-	return -1;
+	return m_HashTable[TableIndex].Index;
 }
 
 //-------------------------------------------------------------------------
-//	returns the AssetRef index
+//	returns the slot for this asset
 //-------------------------------------------------------------------------
 template <class TYPE>
 int GAssetList<TYPE>::FindIndex(TYPE* pAsset)
 {
-	//	find the asset index
-	for ( int i=0;	i<m_AssetRefs.Size();	i++ )
-	{
-		if ( m_Assets[ m_AssetRefs[i].Index ] == pAsset )
-		{
-			return i;
-		}
-	}
+	if ( !pAsset )
+		return -1;
+
+	//	look up by the asset's ref and make sure it's the same asset
+	int Index = FindIndex( pAsset->m_AssetRef );
+	if ( Index != -1 && m_Assets[Index] == pAsset )
+		return Index;
 
 	return -1;
 }
 
 
 
+//-------------------------------------------------------------------------
+//	scatter the bits of a ref so sequential and name refs spread evenly
+//	over the table
+//-------------------------------------------------------------------------
+template <class TYPE>
+inline u32 GAssetList<TYPE>::HashRef(GAssetRef Ref)
+{
+	u32 Hash = (u32)Ref;
+	Hash ^= Hash >> 16;
+	Hash *= 0x7feb352d;
+	Hash ^= Hash >> 15;
+	Hash *= 0x846ca68b;
+	Hash ^= Hash >> 16;
+	return Hash;
+}
+
+
 
 template <class TYPE>
-int GAssetList<TYPE>::FindAssetIndex(GAssetRef Ref)
+int GAssetList<TYPE>::FindTableIndex(GAssetRef Ref)
 {
-	//	get the reference's index
-	int RefIndex = FindIndex( Ref );
-	if ( RefIndex == -1 )
+	if ( !m_HashTable.Size() )
 		return -1;
 
-	//	return the Asset's index
-	return m_AssetRefs[RefIndex].Index;
+	u32 TableMask = m_HashTable.Size() - 1;
+	u32 t = HashRef( Ref ) & TableMask;
+
+	//	table is never full so there's always an empty entry to stop at
+	while ( m_HashTable[t].Index != -1 )
+	{
+		if ( m_HashTable[t].Ref == Ref )
+			return (int)t;
+
+		t = ( t + 1 ) & TableMask;
+	}
+
+	//	not found
+	return -1;
 }
-	
 
 
 
+template <class TYPE>
+void GAssetList<TYPE>::AddToTable(GAssetRef Ref, int Slot)
+{
+	//	keep table at most half full
+	if ( ( m_Count + 1 ) * 2 > m_HashTable.Size() )
+		ResizeTable( GMax( m_HashTable.Size() * 2, GASSETLIST_MIN_TABLE_SIZE ) );
+
+	u32 TableMask = m_HashTable.Size() - 1;
+	u32 t = HashRef( Ref ) & TableMask;
+
+	while ( m_HashTable[t].Index != -1 )
+		t = ( t + 1 ) & TableMask;
+
+	m_HashTable[t].Ref = Ref;
+	m_HashTable[t].Index = Slot;
+}
 
 
 
+//-------------------------------------------------------------------------
+//	empty an entry and move back any following entries that were pushed
+//	past it, so lookups never need tombstones
+//-------------------------------------------------------------------------
 template <class TYPE>
-void GAssetList<TYPE>::ReIndexRefs()
+void GAssetList<TYPE>::RemoveFromTable(int TableIndex)
 {
-	//	todo: speed this up if neccessary
-	for ( int r=0;	r<m_AssetRefs.Size();	r++ )
+	u32 TableMask = m_HashTable.Size() - 1;
+	u32 Hole = (u32)TableIndex;
+	u32 t = Hole;
+
+	while ( TRUE )
 	{
-		//	reset index
-		m_AssetRefs[r].Index = -1;
+		m_HashTable[Hole].Index = -1;
 
-		//	find Asset that matches the Assetref
-		for ( int m=0;	m<m_Assets.Size();	m++ )
+		//	find the next entry that could fill the hole
+		while ( TRUE )
 		{
-			if ( m_AssetRefs[r].Ref == m_Assets[m]->m_AssetRef )
-			{
-				m_AssetRefs[r].Index = m;
+			t = ( t + 1 ) & TableMask;
+			if ( m_HashTable[t].Index == -1 )
+				return;
+
+			//	entry's distance from its home has to reach past the hole to move back into it
+			u32 Home = HashRef( m_HashTable[t].Ref ) & TableMask;
+			if ( ( ( t - Home ) & TableMask ) >= ( ( t - Hole ) & TableMask ) )
 				break;
-			}
 		}
-	}
 
+		m_HashTable[Hole] = m_HashTable[t];
+		Hole = t;
+	}
 }
 
 
 
 template <class TYPE>
-void GAssetList<TYPE>::ReSortRefs()
+void GAssetList<TYPE>::ResizeTable(int TableSize)
 {
-	//	*TODO*
-	//	shouldnt be called too often, shouldnt really ever need to be called in realtime
+	GAssetRefIndex EmptyEntry;
+	EmptyEntry.Ref = GAssetRef_Invalid;
+	EmptyEntry.Index = -1;
+
+	//	take the old entries (lazy assets aren't loaded so their refs only exist in the table)
+	GList<GAssetRefIndex> OldTable;
+	OldTable.TakeData( m_HashTable );
+
+	m_HashTable.Resize( TableSize );
+	m_HashTable.SetAll( EmptyEntry );
+
+	//	re-add all the entries
+	u32 TableMask = TableSize - 1;
+	for ( int i=0;	i<OldTable.Size();	i++ )
+	{
+		if ( OldTable[i].Index == -1 )
+			continue;
+
+		u32 t = HashRef( OldTable[i].Ref ) & TableMask;
+		while ( m_HashTable[t].Index != -1 )
+			t = ( t + 1 ) & TableMask;
+
+		m_HashTable[t] = OldTable[i];
+	}
 }
 
 
@@ -424,18 +611,34 @@ void GAssetList<TYPE>::ReSortRefs()
 template <class TYPE>
 void GAssetList<TYPE>::ChangeAssetRef(GAssetRef OldRef, GAssetRef NewRef)
 {
-	int Index = FindIndex( OldRef );
-	GAssetRefIndex& AssetIndex = m_AssetRefs[Index];
+	int TableIndex = FindTableIndex( OldRef );
+	if ( TableIndex == -1 )
+	{
+		GDebug::Print("Cannot change asset ref 0x%08x, not in list\n", OldRef );
+		return;
+	}
+
+	if ( OldRef != NewRef && FindTableIndex( NewRef ) != -1 )
+	{
+		GDebug::Print("Cannot change asset ref 0x%08x, new ref 0x%08x already in list\n", OldRef, NewRef );
+		return;
+	}
 
-	//	change index's ref
-	AssetIndex.Ref = NewRef;
+	//	asset needs to be loaded to change its ref
+	int Slot = m_HashTable[TableIndex].Index;
+	if ( !GetAsset( Slot ) )
+		return;
+
+	//	re-add the slot under the new ref (table may have changed if loading failed)
+	TableIndex = FindTableIndex( OldRef );
+	RemoveFromTable( TableIndex );
+	m_Count--;
+	AddToTable( NewRef, Slot );
+	m_Count++;
 
 	//	change assets ref
-	GAsset* pAsset = m_Assets[ AssetIndex.Index ];
+	TYPE* pAsset = m_Assets[ Slot ];
 	pAsset->m_AssetRef = NewRef;
-
-	//	asset indexes need resorting
-	ReSortRefs();
 }
 
 
@@ -446,14 +649,8 @@ GAssetRef GAssetList<TYPE>::GetNextFreeRef()
 {
 	GAssetRef NewRef = 0x0;
 
-	for ( int i=0;	i<Size();	i++ )
-	{
-		if ( m_Assets[i]->m_AssetRef == NewRef )
-		{
-			NewRef++;
-			i=0;
-		}
-	}
+	while ( FindTableIndex( NewRef ) != -1 )
+		NewRef++;
 
 	return NewRef;
 }
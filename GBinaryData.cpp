@@ -23,6 +23,7 @@
 GBinaryData::GBinaryData()
 {
 	m_ReadPos = 0;
+	m_ListsView = TRUE;
 }
 
 GBinaryData::~GBinaryData()
@@ -49,19 +50,8 @@ Bool GBinaryData::Read(void* pData,int DataSize,const char* pErrTypeString)
 	}
 
 	//	check if we've run out of data
-	if ( DataSize > DataUnread() )
-	{
-		GString ErrorString;
-		ErrorString += "Error reading binary data ";
-		if ( pErrTypeString != NULL )
-		{
-			ErrorString.Appendf("\"%s\"; ", pErrTypeString );
-		}
-		ErrorString.Appendf("%d bytes, only %d bytes remaining", DataSize, DataUnread() );
-		GDebug_Break( ErrorString );
-		
+	if ( !CheckUnread( DataSize, pErrTypeString ) )
 		return FALSE;
-	}
 
 	//	copy data
 	memcpy( pData, &m_Data[m_ReadPos], DataSize );
@@ -73,6 +63,38 @@ Bool GBinaryData::Read(void* pData,int DataSize,const char* pErrTypeString)
 }
 
 
+//--------------------------------------------------------------------------------------------------------
+//	check there's enough data left to read DataSize bytes
+//--------------------------------------------------------------------------------------------------------
+Bool GBinaryData::CheckUnread(int DataSize,const char* pErrTypeString)
+{
+	if ( DataSize <= DataUnread() )
+		return TRUE;
+
+	GString ErrorString;
+	ErrorString += "Error reading binary data ";
+	if ( pErrTypeString != NULL )
+	{
+		ErrorString.Appendf("\"%s\"; ", pErrTypeString );
+	}
+	ErrorString.Appendf("%d bytes, only %d bytes remaining", DataSize, DataUnread() );
+	GDebug_Break( ErrorString );
+	
+	return FALSE;
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+//	view memory we dont own rather than copying it
+//--------------------------------------------------------------------------------------------------------
+void GBinaryData::SetView(u8* pData,int DataSize,Bool ListsView)
+{
+	m_Data.SetExternal( pData, DataSize );
+	m_ReadPos = 0;
+	m_ListsView = ListsView;
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 //	read an amount of data from our binary data starting from readpos and then moves the readpos foward
 //--------------------------------------------------------------------------------------------------------
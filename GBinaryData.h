@@ -29,7 +29,8 @@
 
 //--------------------------------------------------------------------------------------------------------
 //	simple-interface class for reading/writing data, mainly used for parsing like a file
-//	could be adapted for streaming data in/out
+//	could be adapted for streaming data in/out. can also view memory it doesn't own (eg. a
+//	mapped file) in which case ReadList() gives lists that view the data too, rather than copying
 //--------------------------------------------------------------------------------------------------------
 class GBinaryData
 {
@@ -38,6 +39,7 @@ public:
 	
 private:
 	int			m_ReadPos;	//	current read pos (bytes)
+	Bool		m_ListsView;	//	ReadList() gives lists that view our (external) data instead of copying it
 
 public:
 	GBinaryData();
@@ -47,7 +49,9 @@ public:
 	Bool			Skip(int DataSize);											//	skip over data (as if we'd read it)
 	int				Write(void* pData,int DataSize);							//	append unspecified type of data to current data. returns new length
 	int				Write(GBinaryData& Data);									//	append binary data to this binary data. returns new length
-	inline void		Empty()			{	m_Data.Empty();	};						//	empty out our stored data
+	inline void		Empty()			{	if ( m_Data.IsExternal() )	m_Data.Realloc(0);	else	m_Data.Empty();	};	//	empty out our stored data (stop viewing external data)
+	void			SetView(u8* pData,int DataSize,Bool ListsView=TRUE);		//	view this memory instead of our own copy. memory must stay valid while we, or lists read from us, use it. if ListsView is FALSE lists read from us get their own copy
+	inline Bool		IsView()		{	return m_Data.IsExternal();	};			//	are we viewing memory we dont own?
 	inline void		ResetRead()		{	m_ReadPos = 0;	};						//	move read pos back to start of data
 
 	GList<u8>&		Data()			{	return m_Data;	};
@@ -56,6 +60,35 @@ public:
 	inline int		Size()			{	return m_Data.DataSize();	};				//	total amount of data
 	inline int		GetReadPos()	{	return m_ReadPos;	};
 	Bool			SetReadPos(int NewReadPos);
+
+	//	read a number of elements into a list. if we're viewing external data the list just views it too
+	template<class TYPE>
+	Bool			ReadList(GList<TYPE>& List,int Elements,const char* pErrTypeString=NULL)
+	{
+		if ( Elements <= 0 )
+		{
+			List.Empty();
+			return TRUE;
+		}
+
+		int DataSize = Elements * sizeof(TYPE);
+		if ( !IsView() || !m_ListsView )
+		{
+			List.Resize( Elements );
+			return Read( List.Data(), DataSize, pErrTypeString );
+		}
+
+		if ( !CheckUnread( DataSize, pErrTypeString ) )
+			return FALSE;
+
+		List.SetExternal( (TYPE*)&m_Data[m_ReadPos], Elements );
+		m_ReadPos += DataSize;
+
+		return TRUE;
+	}
+
+private:
+	Bool			CheckUnread(int DataSize,const char* pErrTypeString);		//	check there's enough data left to read, breaks if not
 };
 
 
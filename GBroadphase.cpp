@@ -0,0 +1,422 @@
+/*------------------------------------------------
+
+  GBroadphase.cpp
+
+	finds pairs of objects whose bounding boxes overlap
+
+-------------------------------------------------*/
+
+
+//	Includes
+//------------------------------------------------
+#include "GBroadphase.h"
+#include "GDebug.h"
+#include "GApp.h"
+
+
+//	globals
+//------------------------------------------------
+GDeclareCounter(BroadphasePairs);
+
+
+//	Definitions
+//------------------------------------------------
+
+
+//-------------------------------------------------------------------------
+//	hash a grid cell into a bucket index. TableMask must be (power of 2)-1
+//-------------------------------------------------------------------------
+inline int HashGridCell(int x, int y, int z, u32 TableMask)
+{
+	u32 Hash = ( (u32)x * 73856093 ) ^ ( (u32)y * 19349663 ) ^ ( (u32)z * 83492791 );
+	return (int)( Hash & TableMask );
+}
+
+
+//-------------------------------------------------------------------------
+//	grid cell a position is in. very large positions are clamped
+//-------------------------------------------------------------------------
+inline int GridCellCoord(float Pos, float InvCellSize)
+{
+	float Coord = floorf( Pos * InvCellSize );
+	if ( Coord < -GBROADPHASE_GRID_MAX_COORD )	Coord = -GBROADPHASE_GRID_MAX_COORD;
+	if ( Coord > GBROADPHASE_GRID_MAX_COORD )	Coord = GBROADPHASE_GRID_MAX_COORD;
+	return (int)Coord;
+}
+
+inline int3 GridCell(const float3& Pos, float InvCellSize)
+{
+	return int3( GridCellCoord( Pos.x, InvCellSize ), GridCellCoord( Pos.y, InvCellSize ), GridCellCoord( Pos.z, InvCellSize ) );
+}
+
+
+//-------------------------------------------------------------------------
+//	sort pairs into a list of other ids for each id. the others for each
+//	id are in ascending order. ListStart has MaxID+1 entries
+//-------------------------------------------------------------------------
+void GBroadphase::GetPairLists(int MaxID, GList<int>& ListStart, GList<int>& PairList)
+{
+	int i;
+
+	ListStart.Resize( MaxID+1 );
+	ListStart.SetAll( 0 );
+	PairList.Resize( m_Pairs.Size() * 2 );
+
+	//	count how many pairs each id is in
+	for ( i=0;	i<m_Pairs.Size();	i++ )
+	{
+		ListStart[ m_Pairs[i].x ]++;
+		ListStart[ m_Pairs[i].y ]++;
+	}
+
+	//	turn counts into start indexes
+	int Total = 0;
+	for ( i=0;	i<=MaxID;	i++ )
+	{
+		int Count = ListStart[i];
+		ListStart[i] = Total;
+		Total += Count;
+	}
+
+	//	pairs have the lowest id first, so going through the "other" ids in
+	//	ascending order means each id's list is filled in ascending order.
+	//	first count sort the pairs by their higher id...
+	GList<int> ByHigh;
+	GList<int> HighStart;
+	ByHigh.Resize( m_Pairs.Size() );
+	HighStart.Resize( MaxID+1 );
+	HighStart.SetAll( 0 );
+	for ( i=0;	i<m_Pairs.Size();	i++ )
+		HighStart[ m_Pairs[i].y ]++;
+
+	Total = 0;
+	for ( i=0;	i<=MaxID;	i++ )
+	{
+		int Count = HighStart[i];
+		HighStart[i] = Total;
+		Total += Count;
+	}
+
+	for ( i=0;	i<m_Pairs.Size();	i++ )
+		ByHigh[ HighStart[ m_Pairs[i].y ]++ ] = i;
+
+	//	...then for each id, add lower ids first (from pairs in low order), then higher ids
+	GList<int> Fill;
+	Fill.Copy( ListStart );
+
+	GList<int> ByLow;
+	GList<int> LowStart;
+	ByLow.Resize( m_Pairs.Size() );
+	LowStart.Resize( MaxID+1 );
+	LowStart.SetAll( 0 );
+	for ( i=0;	i<m_Pairs.Size();	i++ )
+		LowStart[ m_Pairs[i].x ]++;
+
+	Total = 0;
+	for ( i=0;	i<=MaxID;	i++ )
+	{
+		int Count = LowStart[i];
+		LowStart[i] = Total;
+		Total += Count;
+	}
+
+	for ( i=0;	i<m_Pairs.Size();	i++ )
+		ByLow[ LowStart[ m_Pairs[i].x ]++ ] = i;
+
+	//	pairs in order of their low id give every high id its lower ids ascending
+	for ( i=0;	i<ByLow.Size();	i++ )
+	{
+		int2& Pair = m_Pairs[ ByLow[i] ];
+		PairList[ Fill[Pair.y]++ ] = Pair.x;
+	}
+
+	//	pairs in order of their high id give every low id its higher ids ascending
+	for ( i=0;	i<ByHigh.Size();	i++ )
+	{
+		int2& Pair = m_Pairs[ ByHigh[i] ];
+		PairList[ Fill[Pair.x]++ ] = Pair.y;
+	}
+
+	ListStart[MaxID] = PairList.Size();
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+void GBroadphaseSAP::Reset()
+{
+	GBroadphase::Reset();
+	m_Endpoints.Empty();
+	m_Objects.Empty();
+	m_Active.Empty();
+}
+
+
+//-------------------------------------------------------------------------
+//	update our object table and add/remove endpoints for objects that
+//	have been added or removed since the last update
+//-------------------------------------------------------------------------
+void GBroadphaseSAP::SyncEndpoints(GList<GBroadphaseObject>& Objects)
+{
+	int i;
+
+	//	objects no longer in the broadphase will be left with an id of -1
+	GList<Bool> WasPresent;
+	WasPresent.Resize( m_Objects.Size() );
+	for ( i=0;	i<m_Objects.Size();	i++ )
+	{
+		WasPresent[i] = ( m_Objects[i].ID != -1 );
+		m_Objects[i].ID = -1;
+	}
+
+	for ( i=0;	i<Objects.Size();	i++ )
+	{
+		GBroadphaseObject& Object = Objects[i];
+
+		//	grow table
+		if ( Object.ID >= m_Objects.Size() )
+		{
+			int OldSize = m_Objects.Size();
+			m_Objects.Resize( Object.ID+1 );
+			for ( int n=OldSize;	n<m_Objects.Size();	n++ )
+				m_Objects[n].ID = -1;
+		}
+
+		//	new object, add endpoints
+		if ( Object.ID >= WasPresent.Size() || !WasPresent[Object.ID] )
+		{
+			GEndpoint Endpoint;
+			Endpoint.ID = Object.ID;
+			Endpoint.Value = Object.Min.x;
+			Endpoint.IsMax = FALSE;
+			m_Endpoints.Add( Endpoint );
+			Endpoint.Value = Object.Max.x;
+			Endpoint.IsMax = TRUE;
+			m_Endpoints.Add( Endpoint );
+		}
+
+		m_Objects[Object.ID] = Object;
+	}
+
+	//	remove endpoints of objects that have gone and update positions of the rest
+	int Kept = 0;
+	for ( i=0;	i<m_Endpoints.Size();	i++ )
+	{
+		GEndpoint& Endpoint = m_Endpoints[i];
+		GBroadphaseObject& Object = m_Objects[Endpoint.ID];
+		if ( Object.ID == -1 )
+			continue;
+
+		Endpoint.Value = Endpoint.IsMax ? Object.Max.x : Object.Min.x;
+		m_Endpoints[Kept++] = Endpoint;
+	}
+	m_Endpoints.Resize( Kept );
+}
+
+
+//-------------------------------------------------------------------------
+//	insertion sort. endpoints are mostly in order from the last update so
+//	this is close to linear. mins go before maxes at the same value so
+//	touching boxes count as overlapping
+//-------------------------------------------------------------------------
+void GBroadphaseSAP::SortEndpoints()
+{
+	for ( int i=1;	i<m_Endpoints.Size();	i++ )
+	{
+		GEndpoint Endpoint = m_Endpoints[i];
+		int j = i-1;
+
+		while ( j >= 0 )
+		{
+			GEndpoint& Prev = m_Endpoints[j];
+			Bool PrevAfter = ( Prev.Value > Endpoint.Value ) || ( Prev.Value == Endpoint.Value && Prev.IsMax && !Endpoint.IsMax );
+			if ( !PrevAfter )
+				break;
+
+			m_Endpoints[j+1] = Prev;
+			j--;
+		}
+
+		m_Endpoints[j+1] = Endpoint;
+	}
+}
+
+
+void GBroadphaseSAP::Update(GList<GBroadphaseObject>& Objects)
+{
+	m_Pairs.Empty();
+
+	SyncEndpoints( Objects );
+	SortEndpoints();
+
+	//	sweep along the axis keeping a list of the boxes we're inside
+	m_Active.Empty();
+	for ( int i=0;	i<m_Endpoints.Size();	i++ )
+	{
+		GEndpoint& Endpoint = m_Endpoints[i];
+
+		//	leaving a box
+		if ( Endpoint.IsMax )
+		{
+			for ( int a=0;	a<m_Active.Size();	a++ )
+			{
+				if ( m_Active[a] == Endpoint.ID )
+				{
+					m_Active[a] = m_Active.ElementLast();
+					m_Active.RemoveLast();
+					break;
+				}
+			}
+			continue;
+		}
+
+		//	entering a box, check the other axes of everything we're inside
+		GBroadphaseObject& Object = m_Objects[Endpoint.ID];
+		for ( int a=0;	a<m_Active.Size();	a++ )
+		{
+			GBroadphaseObject& Other = m_Objects[ m_Active[a] ];
+			if ( !Overlaps( Object, Other ) )
+				continue;
+
+			m_Pairs.Add( int2( GMin( Object.ID, Other.ID ), GMax( Object.ID, Other.ID ) ) );
+		}
+
+		m_Active.Add( Endpoint.ID );
+	}
+
+	GIncCounter(BroadphasePairs,m_Pairs.Size());
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+GBroadphaseGrid::GBroadphaseGrid(float CellSize)
+{
+	SetCellSize( CellSize );
+}
+
+
+void GBroadphaseGrid::Reset()
+{
+	GBroadphase::Reset();
+	m_BucketFirst.Empty();
+	m_Entries.Empty();
+	m_EntryCells.Empty();
+	m_Oversized.Empty();
+}
+
+
+//-------------------------------------------------------------------------
+//	add each object to the cells it touches and test against the objects
+//	already in those cells. a pair is only reported from the cell that
+//	holds the min corner of the overlap, so it's only reported once.
+//	objects covering too many cells (eg. very fast or large) are kept out
+//	of the grid and tested against every object instead
+//-------------------------------------------------------------------------
+void GBroadphaseGrid::Update(GList<GBroadphaseObject>& Objects)
+{
+	int o;
+
+	m_Pairs.Empty();
+	m_Entries.Empty();
+	m_EntryCells.Empty();
+	m_Oversized.Empty();
+
+	if ( !Objects.Size() )
+		return;
+
+	//	bucket table is a power of 2 at least twice the number of objects
+	u32 TableSize = 16;
+	while ( TableSize < (u32)Objects.Size()*2 )
+		TableSize <<= 1;
+	u32 TableMask = TableSize - 1;
+
+	m_BucketFirst.Resize( TableSize );
+	m_BucketFirst.SetAll( -1 );
+
+	float InvCellSize = 1.f / m_CellSize;
+
+	for ( o=0;	o<Objects.Size();	o++ )
+	{
+		GBroadphaseObject& Object = Objects[o];
+		int3 CellMin = GridCell( Object.Min, InvCellSize );
+		int3 CellMax = GridCell( Object.Max, InvCellSize );
+
+		if ( CellMax.x - CellMin.x >= GBROADPHASE_GRID_MAX_CELLS ||
+			CellMax.y - CellMin.y >= GBROADPHASE_GRID_MAX_CELLS ||
+			CellMax.z - CellMin.z >= GBROADPHASE_GRID_MAX_CELLS )
+		{
+			m_Oversized.Add( o );
+			continue;
+		}
+
+		for ( int x=CellMin.x;	x<=CellMax.x;	x++ )
+		{
+			for ( int y=CellMin.y;	y<=CellMax.y;	y++ )
+			{
+				for ( int z=CellMin.z;	z<=CellMax.z;	z++ )
+				{
+					int3 Cell( x, y, z );
+					int Bucket = HashGridCell( x, y, z, TableMask );
+
+					//	test against objects already in this cell
+					for ( int e=m_BucketFirst[Bucket];	e!=-1;	e=m_Entries[e].Next )
+					{
+						if ( !( m_EntryCells[e] == Cell ) )
+							continue;
+
+						GBroadphaseObject& Other = Objects[ m_Entries[e].Object ];
+						if ( !Overlaps( Object, Other ) )
+							continue;
+
+						//	only report from the cell with the min corner of the overlap
+						float3 OverlapMin( GMax( Object.Min.x, Other.Min.x ), GMax( Object.Min.y, Other.Min.y ), GMax( Object.Min.z, Other.Min.z ) );
+						int3 OverlapCell = GridCell( OverlapMin, InvCellSize );
+						if ( !( OverlapCell == Cell ) )
+							continue;
+
+						m_Pairs.Add( int2( GMin( Object.ID, Other.ID ), GMax( Object.ID, Other.ID ) ) );
+					}
+
+					//	add to cell
+					GCellEntry Entry;
+					Entry.Object = o;
+					Entry.Next = m_BucketFirst[Bucket];
+					m_BucketFirst[Bucket] = m_Entries.Add( Entry );
+					m_EntryCells.Add( Cell );
+				}
+			}
+		}
+	}
+
+	//	test oversized objects against everything. pairs of oversized objects are only tested from the first one
+	GList<u8> IsOversized;
+	if ( m_Oversized.Size() )
+	{
+		IsOversized.Resize( Objects.Size() );
+		IsOversized.SetAll( 0 );
+		for ( int i=0;	i<m_Oversized.Size();	i++ )
+			IsOversized[ m_Oversized[i] ] = 1;
+	}
+
+	for ( int i=0;	i<m_Oversized.Size();	i++ )
+	{
+		GBroadphaseObject& Object = Objects[ m_Oversized[i] ];
+		for ( o=0;	o<Objects.Size();	o++ )
+		{
+			if ( IsOversized[o] && o <= m_Oversized[i] )
+				continue;
+
+			GBroadphaseObject& Other = Objects[o];
+			if ( !Overlaps( Object, Other ) )
+				continue;
+
+			m_Pairs.Add( int2( GMin( Object.ID, Other.ID ), GMax( Object.ID, Other.ID ) ) );
+		}
+	}
+
+	GIncCounter(BroadphasePairs,m_Pairs.Size());
+}
+
@@ -0,0 +1,152 @@
+/*------------------------------------------------
+
+  GBroadphase Header file
+
+	finds pairs of objects whose bounding boxes overlap
+	so only those pairs need a full collision test
+
+-------------------------------------------------*/
+
+#ifndef __GBROADPHASE__H_
+#define __GBROADPHASE__H_
+
+
+
+//	Includes
+//------------------------------------------------
+#include "GMain.h"
+#include "GList.h"
+
+
+//	Macros
+//------------------------------------------------
+#define GBROADPHASE_DEFAULT_CELLSIZE	10.f	//	default grid cell size for GBroadphaseGrid
+#define GBROADPHASE_GRID_MAX_CELLS		8		//	objects covering more cells than this along any axis aren't put in the grid
+#define GBROADPHASE_GRID_MAX_COORD		1.0e9f	//	cell coordinates are clamped to this so they fit in an int
+
+
+
+//	Types
+//------------------------------------------------
+
+//-------------------------------------------------------------------------
+//	object to add to the broadphase. ID must stay the same for an object
+//	between updates for the broadphase to reuse last update's state
+//-------------------------------------------------------------------------
+typedef struct
+{
+	int			ID;		//	user id, >= 0
+	float3		Min;	//	world space bounding box
+	float3		Max;
+
+} GBroadphaseObject;
+
+
+//-------------------------------------------------------------------------
+//	base broadphase type. after an update m_Pairs holds every pair of
+//	ID's whose boxes overlap, lowest ID first
+//-------------------------------------------------------------------------
+class GBroadphase
+{
+public:
+	GList<int2>			m_Pairs;		//	overlapping pairs from last update
+
+public:
+	GBroadphase()		{	};
+	virtual ~GBroadphase()	{	};
+
+	virtual void		Update(GList<GBroadphaseObject>& Objects)=0;	//	find overlapping pairs for this set of objects
+	virtual void		Reset()						{	m_Pairs.Empty();	};	//	forget all state
+	virtual const char*	Name()						{	return "None";	};
+
+	void				GetPairLists(int MaxID, GList<int>& ListStart, GList<int>& PairList);	//	sorts pairs into a list of others for each id. others for id are PairList[ListStart[id]..ListStart[id+1]]
+
+protected:
+	static inline Bool	Overlaps(const GBroadphaseObject& a, const GBroadphaseObject& b);
+};
+
+
+//-------------------------------------------------------------------------
+//	sweep and prune. box endpoints along the x axis are kept sorted
+//	between updates so if objects havent moved much re-sorting is cheap
+//-------------------------------------------------------------------------
+class GBroadphaseSAP : public GBroadphase
+{
+protected:
+	typedef struct
+	{
+		float	Value;		//	position along sorting axis
+		int		ID;			//	object id
+		Bool	IsMax;		//	max or min of the box
+
+	} GEndpoint;
+
+	GList<GEndpoint>			m_Endpoints;	//	sorted endpoints
+	GList<GBroadphaseObject>	m_Objects;		//	objects indexed by ID. ID of -1 if not in the broadphase
+	GList<int>					m_Active;		//	objects overlapping the current point in the sweep
+
+public:
+	virtual void		Update(GList<GBroadphaseObject>& Objects);
+	virtual void		Reset();
+	virtual const char*	Name()						{	return "Sweep and prune";	};
+
+protected:
+	void				SyncEndpoints(GList<GBroadphaseObject>& Objects);	//	add/remove endpoints for objects that appeared/disappeared
+	void				SortEndpoints();									//	insertion sort endpoints
+};
+
+
+//-------------------------------------------------------------------------
+//	uniform grid. objects are put into every cell their box touches and
+//	objects sharing a cell are tested. good for lots of evenly sized objects
+//-------------------------------------------------------------------------
+class GBroadphaseGrid : public GBroadphase
+{
+protected:
+	typedef struct
+	{
+		int		Object;		//	index into update's object list
+		int		Next;		//	next entry in the same bucket
+
+	} GCellEntry;
+
+	float					m_CellSize;
+	GList<int>				m_BucketFirst;	//	first entry for each hashed cell
+	GList<GCellEntry>		m_Entries;		//	entries for all objects in all cells
+	GList<int3>				m_EntryCells;	//	cell for each entry (to skip other cells in the same bucket)
+	GList<int>				m_Oversized;	//	index into update's object list of objects too big for the grid, tested against everything
+
+public:
+	GBroadphaseGrid(float CellSize=GBROADPHASE_DEFAULT_CELLSIZE);
+
+	virtual void		Update(GList<GBroadphaseObject>& Objects);
+	virtual void		Reset();
+	virtual const char*	Name()						{	return "Grid";	};
+
+	inline void			SetCellSize(float CellSize)	{	m_CellSize = GMax( CellSize, NEAR_ZERO );	};
+	inline float		CellSize() const			{	return m_CellSize;	};
+};
+
+
+
+//	Declarations
+//------------------------------------------------
+
+
+
+
+//	Inline Definitions
+//-------------------------------------------------
+
+inline Bool GBroadphase::Overlaps(const GBroadphaseObject& a, const GBroadphaseObject& b)
+{
+	return	( a.Min.x <= b.Max.x && b.Min.x <= a.Max.x ) &&
+			( a.Min.y <= b.Max.y && b.Min.y <= a.Max.y ) &&
+			( a.Min.z <= b.Max.z && b.Min.z <= a.Max.z );
+}
+
+
+
+
+#endif
+
@@ -27,6 +27,18 @@ GList<GDebugSphere>		g_DebugSpheres;
 GList<GDebugPosition>	g_DebugPositions;
 GList<GDebugLine>		g_DebugLines;
 
+//	debug items can be added from worker threads (eg. physics collisions)
+class GDebugItemLock
+{
+public:
+	CRITICAL_SECTION	m_Lock;
+
+public:
+	GDebugItemLock()	{	InitializeCriticalSection( &m_Lock );	};
+	~GDebugItemLock()	{	DeleteCriticalSection( &m_Lock );	};
+};
+GDebugItemLock			g_DebugItemLock;
+
 float4		GDisplay::g_DebugColour( 1.0f, 0.5f, 0.0f, 1.f );
 Bool		GDisplay::g_OpenglInitialised = FALSE;
 GDisplay*	GDisplay::g_pDisplay = NULL;					//	global display object
@@ -611,7 +623,9 @@ void GDisplay::DebugPoint(float3& Pos, float4& Colour)
 	GDebugPoint p;
 	p.Pos		= Pos;
 	p.Colour	= Colour;
+	EnterCriticalSection( &g_DebugItemLock.m_Lock );
 	g_DebugPoints.Add( p );
+	LeaveCriticalSection( &g_DebugItemLock.m_Lock );
 }
 
 
@@ -621,7 +635,9 @@ void GDisplay::DebugPosition(float3& Pos, float4& Colour, GQuaternion& Rot)
 	p.Pos		= Pos;
 	p.Colour	= Colour;
 	p.Rot		= Rot;
+	EnterCriticalSection( &g_DebugItemLock.m_Lock );
 	g_DebugPositions.Add( p );
+	LeaveCriticalSection( &g_DebugItemLock.m_Lock );
 }
 
 
@@ -631,7 +647,9 @@ void GDisplay::DebugSphere(float3& Pos, float4& Colour, float Radius)
 	p.Pos		= Pos;
 	p.Colour	= Colour;
 	p.Radius	= Radius;
+	EnterCriticalSection( &g_DebugItemLock.m_Lock );
 	g_DebugSpheres.Add( p );
+	LeaveCriticalSection( &g_DebugItemLock.m_Lock );
 }
 
 
@@ -641,7 +659,9 @@ void GDisplay::DebugLine(float3& Pos, float4& Colour, float3& PosTo)
 	p.Pos		= Pos;
 	p.Colour	= Colour;
 	p.PosTo		= PosTo;
+	EnterCriticalSection( &g_DebugItemLock.m_Lock );
 	g_DebugLines.Add( p );
+	LeaveCriticalSection( &g_DebugItemLock.m_Lock );
 }
 
 
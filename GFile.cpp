@@ -19,6 +19,7 @@
 
 //	globals
 //------------------------------------------------
+GList<GFileMapping>	GFile::g_KeptMappings;
 
 
 //	Definitions
@@ -28,6 +29,9 @@
 
 GFile::GFile()
 {
+	m_Mapping.hFile		= INVALID_HANDLE_VALUE;
+	m_Mapping.hMapping	= NULL;
+	m_Mapping.pData		= NULL;
 }
 
 
@@ -36,16 +40,14 @@ GFile::~GFile()
 {
 	//	delete all data
 	m_Data.Empty();
+	Unmap();
 }
 
 
 
-Bool GFile::Load(const GString& Filename)
+Bool GFile::GetLoadFilename(const GString& Filename, GString& LoadFilename)
 {
-	//	empty current data
-	m_Data.Empty();
-	
-	GString LoadFilename( Filename );
+	LoadFilename = Filename;
 
 	//	if filename doesnt have a path, insert our global path
 	if ( !ExtractFullFilePath( Filename, LoadFilename ) )
@@ -53,6 +55,20 @@ Bool GFile::Load(const GString& Filename)
 		LoadFilename.Insert( 0, GApp::g_AppPath );
 	}
 
+	return TRUE;
+}
+
+
+
+Bool GFile::Load(const GString& Filename)
+{
+	//	empty current data
+	m_Data.Empty();
+	Unmap();
+	
+	GString LoadFilename;
+	GetLoadFilename( Filename, LoadFilename );
+
 	//	open a file for read in binary
 	FILE* File = fopen( LoadFilename, "rb" );
 	if ( !File )
@@ -79,6 +95,119 @@ Bool GFile::Load(const GString& Filename)
 
 
 
+//-------------------------------------------------------------------------
+//	map the whole file into memory rather than reading it. nothing is
+//	read until it's accessed, and lists that view the data (see
+//	GBinaryData::ReadList) don't need their own copy. the view is copy
+//	on write so changing data never changes the file
+//-------------------------------------------------------------------------
+Bool GFile::LoadMapped(const GString& Filename)
+{
+	//	empty current data
+	m_Data.Empty();
+	Unmap();
+
+	GString LoadFilename;
+	GetLoadFilename( Filename, LoadFilename );
+
+	m_Mapping.hFile = CreateFile( LoadFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( m_Mapping.hFile == INVALID_HANDLE_VALUE )
+	{
+		GDebug_Print("Error opening file \"%s\"\n", (char*)LoadFilename );
+		return FALSE;
+	}
+
+	int FileSize = (int)GetFileSize( m_Mapping.hFile, NULL );
+	if ( FileSize <= 0 )
+	{
+		//	cant map an empty file, just leave data empty
+		Unmap();
+		return TRUE;
+	}
+
+	//	map the whole file
+	m_Mapping.hMapping = CreateFileMapping( m_Mapping.hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if ( m_Mapping.hMapping )
+		m_Mapping.pData = (u8*)MapViewOfFile( m_Mapping.hMapping, FILE_MAP_COPY, 0, 0, 0 );
+
+	if ( !m_Mapping.pData )
+	{
+		GDebug::CheckWin32Error();
+		GDebug_Print("Error mapping file \"%s\"\n", (char*)LoadFilename );
+		Unmap();
+		return FALSE;
+	}
+
+	m_Data.SetView( m_Mapping.pData, FileSize );
+
+	return TRUE;
+}
+
+
+
+void GFile::Unmap()
+{
+	//	stop viewing the mapping
+	if ( m_Data.IsView() )
+		m_Data.Empty();
+
+	if ( m_Mapping.pData )
+	{
+		UnmapViewOfFile( m_Mapping.pData );
+		m_Mapping.pData = NULL;
+	}
+
+	if ( m_Mapping.hMapping )
+	{
+		CloseHandle( m_Mapping.hMapping );
+		m_Mapping.hMapping = NULL;
+	}
+
+	if ( m_Mapping.hFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( m_Mapping.hFile );
+		m_Mapping.hFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+
+
+//-------------------------------------------------------------------------
+//	hand our mapping over to the global list so anything that was loaded
+//	from it (and is still viewing it) stays valid after we're deleted
+//-------------------------------------------------------------------------
+void GFile::KeepMapping()
+{
+	if ( !m_Mapping.pData )
+		return;
+
+	//	stop viewing the data ourselves
+	m_Data.Empty();
+
+	g_KeptMappings.Add( m_Mapping );
+
+	m_Mapping.hFile		= INVALID_HANDLE_VALUE;
+	m_Mapping.hMapping	= NULL;
+	m_Mapping.pData		= NULL;
+}
+
+
+
+void GFile::ReleaseKeptMappings()
+{
+	for ( int i=0;	i<g_KeptMappings.Size();	i++ )
+	{
+		GFileMapping& Mapping = g_KeptMappings[i];
+		UnmapViewOfFile( Mapping.pData );
+		CloseHandle( Mapping.hMapping );
+		CloseHandle( Mapping.hFile );
+	}
+
+	g_KeptMappings.Empty();
+}
+
+
+
 
 Bool GFile::Save(const GString& Filename)
 {
@@ -28,21 +28,46 @@
 //------------------------------------------------
 class GString;
 
+//--------------------------------------------------------------------------------------------------------
+//	handles for a file mapped into memory
+//--------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	HANDLE		hFile;		//	file handle
+	HANDLE		hMapping;	//	file mapping object
+	u8*			pData;		//	mapped view of the whole file
+
+} GFileMapping;
+
+
 //--------------------------------------------------------------------------------------------------------
 // simple file access
 //--------------------------------------------------------------------------------------------------------
 class GFile
 {
+public:
+	static GList<GFileMapping>	g_KeptMappings;	//	mappings that stay open after their GFile has gone, for data still viewing them
+
 public:
 	GBinaryData		m_Data;		//	raw data loaded, or to be saved
 
+private:
+	GFileMapping	m_Mapping;	//	mapping m_Data is viewing, if LoadMapped was used
+
 public:
 	GFile();
 	~GFile();
 
 	Bool	Load(const GString& Filename);	//	load all the data out of the specified filename and into this class
+	Bool	LoadMapped(const GString& Filename);	//	map the file into memory and view it with m_Data instead of reading it. pages are copy-on-write so the file is never modified
 	Bool	Save(const GString& Filename);	//	save all the data out of this and into a file
+	void	Unmap();						//	close the mapping. m_Data and anything viewing it become invalid
+	void	KeepMapping();					//	keep the mapping open after this GFile is deleted (until ReleaseKeptMappings)
 	
+	static void	ReleaseKeptMappings();		//	close all kept mappings. nothing can be viewing them any more
+
+private:
+	Bool	GetLoadFilename(const GString& Filename, GString& LoadFilename);	//	get full path for a file to load
 };
 
 
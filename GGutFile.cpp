@@ -14,6 +14,10 @@
 		<AssetHeader>
 		<AssetData>
 	}
+	GGutFileTOCEntry	Table of contents, one entry per asset block
+	GGutFileFooter		Offset and count of the table of contents
+
+	version 0x55550003 files have no table of contents or footer
 
 
 -------------------------------------------------*/
@@ -30,11 +34,36 @@
 #include "GFile.h"
 #include "GMap.h"
 #include "GAssetList.h"
+#include "GThreadPool.h"
+
+
+//	Types
+//------------------------------------------------
+
+//	asset found in the file waiting to be loaded
+typedef struct
+{
+	GAssetHeader	Header;
+	u8*				pData;		//	asset data (after the header)
+	GAsset*			pAsset;		//	new asset to load into
+	Bool			Loaded;		//	set by the load job
+
+} GGutFileAssetBlock;
+
+//	parameters for the load jobs
+typedef struct
+{
+	GList<GGutFileAssetBlock>*	pBlocks;
+	Bool						ListsView;	//	lists read from blocks view the data rather than copy it
+
+} GGutFileImportJobs;
+
 
 
 //	globals
 //------------------------------------------------
-const u32	GGutFile::g_Version		= 0x55550003;
+const u32	GGutFile::g_Version		= 0x55550004;
+const u32	GGutFile::g_VersionNoTOC	= 0x55550003;
 const char*	GGutFile::g_FileExt		= "gut";
 const char*	GGutFile::g_FileFilter	= "Gut file (*.gut)\0*.gut\0\0";
 
@@ -61,14 +90,28 @@ GGutFile::~GGutFile()
 
 
 
-Bool GGutFile::Load(const GString& Filename)
+Bool GGutFile::Load(const GString& Filename, Bool Mapped)
 {
 	GFile File;
-	if ( ! File.Load( Filename ) )
-		return FALSE;
+	if ( Mapped )
+	{
+		if ( ! File.LoadMapped( Filename ) )
+			return FALSE;
+	}
+	else
+	{
+		if ( ! File.Load( Filename ) )
+			return FALSE;
+	}
 
 	//	we've read in the data, now turn it into data
-	if ( ! ImportData( File.m_Data ) )
+	Bool Imported = ImportData( File.m_Data );
+
+	//	assets may be viewing the mapped file, keep it open after File has gone
+	if ( Mapped )
+		File.KeepMapping();
+
+	if ( ! Imported )
 		return FALSE;
 
 
@@ -79,6 +122,57 @@ Bool GGutFile::Load(const GString& Filename)
 
 
 
+//-------------------------------------------------------------------------
+//	map the file and add assets to the global lists without loading them.
+//	each asset's block is only read when the asset is first accessed
+//-------------------------------------------------------------------------
+int GGutFile::LoadLazy(const GString& Filename)
+{
+	GFile File;
+	if ( ! File.LoadMapped( Filename ) )
+		return 0;
+
+	if ( ! ReadTOC( File.m_Data ) )
+		return 0;
+
+	//	old file without a table of contents, load everything now
+	if ( m_Header.Version == GGutFile::g_VersionNoTOC )
+	{
+		Bool Imported = ImportData( File.m_Data );
+		File.KeepMapping();
+		if ( !Imported )
+			return 0;
+
+		//	the global lists own the assets that were added, delete the rest (eg. duplicates)
+		GList<GAsset*> NotAdded;
+		int Loaded = GAssets::AddFromList( m_Assets, &NotAdded );
+		RemoveAssets(FALSE);
+
+		for ( int a=0;	a<NotAdded.Size();	a++ )
+			delete NotAdded[a];
+
+		return Loaded;
+	}
+
+	u8* pFileData = File.m_Data.m_Data.Data();
+	int Added = 0;
+	for ( int i=0;	i<m_TOC.Size();	i++ )
+	{
+		GGutFileTOCEntry& Entry = m_TOC[i];
+		if ( GAssets::AddLazy( Entry.AssetType, Entry.AssetRef, pFileData + Entry.Offset, Entry.Size ) )
+			Added++;
+	}
+
+	//	lazy assets read from the mapped file whenever they're accessed
+	if ( Added )
+		File.KeepMapping();
+
+	return Added;
+}
+
+
+
+
 Bool GGutFile::Save(const GString& Filename)
 {
 	GFile File;
@@ -96,6 +190,23 @@ Bool GGutFile::Save(const GString& Filename)
 
 
 
+//-------------------------------------------------------------------------
+//	load one asset from its block. each job views its block with its own
+//	GBinaryData so jobs dont share a read pos
+//-------------------------------------------------------------------------
+void LoadAssetBlockJob(int JobIndex, void* pParam)
+{
+	GGutFileImportJobs* pJobs = (GGutFileImportJobs*)pParam;
+	GGutFileAssetBlock& Block = pJobs->pBlocks->ElementAt( JobIndex );
+
+	GBinaryData BlockData;
+	BlockData.SetView( Block.pData, Block.Header.BlockSize, pJobs->ListsView );
+
+	Block.Loaded = Block.pAsset->LoadAsset( &Block.Header, BlockData );
+}
+
+
+
 Bool GGutFile::ImportData(GBinaryData& Data)
 {
 	//	read a block of data, update sizes and data pointer
@@ -124,24 +235,23 @@ Bool GGutFile::ImportData(GBinaryData& Data)
 	m_Assets.Empty();
 
 
-	//	reset binary data read pos
-	Data.ResetRead();
-
-	//	read in file header
+	//	read in file header and table of contents
 	//READ_BLOCK( &m_Header, sizeof( GGutFileHeader ), "File is missing header\n" );
-	Data.Read( &m_Header, sizeof( GGutFileHeader ), "GutFile header" );
-
-	//	check header version
-	if ( m_Header.Version != GGutFile::g_Version )
-	{
-		GDebug_Print("Invalid Gutfile version 0x%08x should be 0x%08x\n", m_Header.Version, GGutFile::g_Version );
+	if ( !ReadTOC( Data ) )
 		return FALSE;
-	}
+
+	//	asset blocks end where the table of contents starts
+	int AssetDataEnd = Data.Size();
+	if ( m_Header.Version != GGutFile::g_VersionNoTOC )
+		AssetDataEnd -= sizeof(GGutFileFooter) + m_TOC.Size() * sizeof(GGutFileTOCEntry);
 
 	int AssetsRead = 0;
 
-	//	read in all the data
-	while ( Data.DataUnread() > 0 )
+	//	find all the asset blocks and create their assets. loading happens afterwards across threads
+	GList<GGutFileAssetBlock> Blocks;
+	Blocks.Reserve( m_Header.AssetCount );
+
+	while ( Data.GetReadPos() < AssetDataEnd )
 	{
 		//	seem to have too much data... break out of the loading loop
 		if ( AssetsRead >= m_Header.AssetCount )
@@ -152,15 +262,23 @@ Bool GGutFile::ImportData(GBinaryData& Data)
 
 		GAssetHeader AssetHeader;
 		//READ_BLOCK( &AssetHeader, sizeof(GAssetHeader), "Asset header missing\n" );
-		Data.Read( &AssetHeader, sizeof(GAssetHeader), "Asset header" );
+		if ( !Data.Read( &AssetHeader, sizeof(GAssetHeader), "Asset header" ) )
+			break;
 
 		AssetsRead++;
 
+		//	block data starts straight after its header
+		u8* pBlockData = Data.m_Data.Data() + Data.GetReadPos();
+		if ( !Data.Skip( AssetHeader.BlockSize ) )
+		{
+			GDebug_Print("Asset block (type %d) is bigger than remaining data\n", AssetHeader.AssetType );
+			break;
+		}
+
 		//	check we can load this asset type
 		if ( !ValidAssetType( AssetHeader.AssetType ) )
 		{
 			//	cant load this data, skip over it
-			Data.Skip(AssetHeader.BlockSize);
 			GDebug_Print("Unknown asset type (%d, version 0x%08x)\n",AssetHeader.AssetType, AssetHeader.AssetVersion);
 			continue;
 		}
@@ -216,32 +334,40 @@ Bool GGutFile::ImportData(GBinaryData& Data)
 			break;
 		};
 
-		//	load the new asset
-		if ( pNewAsset )
-		{
-			//	new mesh of the correct type has been created 
-			int PreLoadDataPos = Data.GetReadPos();
+		//	not reading this section, already skipped over it
+		if ( !pNewAsset )
+			continue;
 
-			if ( ! pNewAsset->LoadAsset( &AssetHeader, Data ) )
-			{
-				GDebug_Print("Asset Failed to load, skipping over\n");
+		GGutFileAssetBlock Block;
+		Block.Header	= AssetHeader;
+		Block.pData		= pBlockData;
+		Block.pAsset	= pNewAsset;
+		Block.Loaded	= FALSE;
+		Blocks.Add( Block );
+	}
 
-				//	delete useless data
-				delete pNewAsset;
+	//	load the new assets from their blocks. lists read from the blocks only view
+	//	the data if it's mapped, otherwise they copy it as Data may be freed after this
+	GGutFileImportJobs Jobs;
+	Jobs.pBlocks	= &Blocks;
+	Jobs.ListsView	= Data.IsView();
+	GThreadPool::g_ThreadPool.ParallelFor( Blocks.Size(), LoadAssetBlockJob, &Jobs );
 
-				//	skip over data
-				Data.SetReadPos( PreLoadDataPos + AssetHeader.BlockSize );
-			}
-			else
-			{
-				//	loaded okay, add to list of data
-				m_Assets.Add( pNewAsset );
-			}
+	//	add to list of data in file order so the result doesnt depend on thread timing
+	for ( int b=0;	b<Blocks.Size();	b++ )
+	{
+		GGutFileAssetBlock& Block = Blocks[b];
+		if ( Block.Loaded )
+		{
+			//	loaded okay, add to list of data
+			m_Assets.Add( Block.pAsset );
 		}
 		else
 		{
-			//	skip over to next bit of data as we're not reading this section
-			Data.Skip( AssetHeader.BlockSize );
+			GDebug_Print("Asset Failed to load, skipping over\n");
+
+			//	delete useless data
+			delete Block.pAsset;
 		}
 	}
 
@@ -253,6 +379,72 @@ Bool GGutFile::ImportData(GBinaryData& Data)
 
 
 
+//-------------------------------------------------------------------------
+//	read the file header, and the table of contents from the end of the file
+//-------------------------------------------------------------------------
+Bool GGutFile::ReadTOC(GBinaryData& Data)
+{
+	m_TOC.Empty();
+
+	//	reset binary data read pos
+	Data.ResetRead();
+
+	if ( !Data.Read( &m_Header, sizeof( GGutFileHeader ), "GutFile header" ) )
+		return FALSE;
+
+	//	old version has no table of contents
+	if ( m_Header.Version == GGutFile::g_VersionNoTOC )
+		return TRUE;
+
+	//	check header version
+	if ( m_Header.Version != GGutFile::g_Version )
+	{
+		GDebug_Print("Invalid Gutfile version 0x%08x should be 0x%08x\n", m_Header.Version, GGutFile::g_Version );
+		return FALSE;
+	}
+
+	//	footer is in the last bytes of the file
+	int HeaderEnd = Data.GetReadPos();
+	GGutFileFooter Footer;
+	if ( !Data.SetReadPos( Data.Size() - sizeof(GGutFileFooter) ) || !Data.Read( &Footer, sizeof(GGutFileFooter), "GutFile footer" ) )
+		return FALSE;
+
+	//	check the table fits between the header and the footer
+	u32 TOCEnd = Footer.TOCOffset + Footer.TOCCount * sizeof(GGutFileTOCEntry);
+	if ( Footer.TOCOffset < (u32)HeaderEnd || TOCEnd != Data.Size() - sizeof(GGutFileFooter) )
+	{
+		GDebug_Print("Invalid Gutfile table of contents\n");
+		return FALSE;
+	}
+
+	Data.SetReadPos( Footer.TOCOffset );
+	//	copy the table rather than viewing it, so it stays valid if the file is unmapped
+	m_TOC.Resize( Footer.TOCCount );
+	if ( Footer.TOCCount && !Data.Read( m_TOC.Data(), Footer.TOCCount * sizeof(GGutFileTOCEntry), "GutFile table of contents" ) )
+	{
+		m_TOC.Empty();
+		return FALSE;
+	}
+
+	//	check the blocks are all inside the asset data
+	for ( int i=0;	i<m_TOC.Size();	i++ )
+	{
+		GGutFileTOCEntry& Entry = m_TOC[i];
+		if ( Entry.Offset < (u32)HeaderEnd || Entry.Size < sizeof(GAssetHeader) || Entry.Offset + Entry.Size > Footer.TOCOffset )
+		{
+			GDebug_Print("Invalid Gutfile table of contents entry %d\n", i );
+			m_TOC.Empty();
+			return FALSE;
+		}
+	}
+
+	Data.SetReadPos( HeaderEnd );
+
+	return TRUE;
+}
+
+
+
 
 
 
@@ -267,6 +459,7 @@ Bool GGutFile::ExportData(GBinaryData& Data)
 
 	//	add header to file data
 	Data.Write( &m_Header, sizeof( GGutFileHeader ) );
+	m_TOC.Empty();
 	
 
 	//	save the assets into the FileData
@@ -292,6 +485,14 @@ Bool GGutFile::ExportData(GBinaryData& Data)
 		//	update data size
 		AssetHeader.BlockSize = AssetSaveData.Size();
 
+		//	add a table of contents entry for the block
+		GGutFileTOCEntry Entry;
+		Entry.AssetType	= AssetHeader.AssetType;
+		Entry.AssetRef	= AssetHeader.AssetRef;
+		Entry.Offset	= Data.Size();
+		Entry.Size		= sizeof(GAssetHeader) + AssetHeader.BlockSize;
+		m_TOC.Add( Entry );
+
 		//	add the asset block's header first
 		Data.Write( &AssetHeader, sizeof(GAssetHeader) );
 
@@ -302,6 +503,14 @@ Bool GGutFile::ExportData(GBinaryData& Data)
 		AssetSaveData.Empty();
 	}
 
+	//	table of contents and footer to find it
+	GGutFileFooter Footer;
+	Footer.TOCOffset	= Data.Size();
+	Footer.TOCCount		= m_TOC.Size();
+	if ( m_TOC.Size() )
+		Data.Write( m_TOC.Data(), m_TOC.Size() * sizeof(GGutFileTOCEntry) );
+	Data.Write( &Footer, sizeof(GGutFileFooter) );
+
 	//	now have new m_Data to save
 	return TRUE;
 }
@@ -337,9 +546,10 @@ void GGutFile::RemoveAssets(Bool Delete)
 
 void GGutFile::AddAssets(GMeshList* pList)
 {
-	for ( int i=0;	i<pList->Size();	i++ )
+	for ( int i=0;	i<pList->SlotCount();	i++ )
 	{
-		m_Assets.Add( pList->GetAsset( i ) );
+		if ( pList->GetAsset( i ) )
+			m_Assets.Add( pList->GetAsset( i ) );
 	}
 }
 
@@ -349,9 +559,10 @@ void GGutFile::AddAssets(GMeshList* pList)
 
 void GGutFile::AddAssets(GTextureList* pList)
 {
-	for ( int i=0;	i<pList->Size();	i++ )
+	for ( int i=0;	i<pList->SlotCount();	i++ )
 	{
-		m_Assets.Add( pList->GetAsset( i ) );
+		if ( pList->GetAsset( i ) )
+			m_Assets.Add( pList->GetAsset( i ) );
 	}
 }
 
@@ -359,9 +570,10 @@ void GGutFile::AddAssets(GTextureList* pList)
 
 void GGutFile::AddAssets(GMapList* pList)
 {
-	for ( int i=0;	i<pList->Size();	i++ )
+	for ( int i=0;	i<pList->SlotCount();	i++ )
 	{
-		m_Assets.Add( pList->GetAsset( i ) );
+		if ( pList->GetAsset( i ) )
+			m_Assets.Add( pList->GetAsset( i ) );
 	}
 }
 
@@ -369,9 +581,10 @@ void GGutFile::AddAssets(GMapList* pList)
 
 void GGutFile::AddAssets(GMapObjectList* pList)
 {
-	for ( int i=0;	i<pList->Size();	i++ )
+	for ( int i=0;	i<pList->SlotCount();	i++ )
 	{
-		m_Assets.Add( pList->GetAsset( i ) );
+		if ( pList->GetAsset( i ) )
+			m_Assets.Add( pList->GetAsset( i ) );
 	}
 }
 
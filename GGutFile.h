@@ -48,6 +48,31 @@ typedef struct
 } GGutFileHeader;
 
 
+//--------------------------------------------------------------------------------------------------------
+//	table of contents entry, one per asset block. lets assets be found (and loaded on demand)
+//	without reading through all the blocks before them
+//--------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	GAssetType	AssetType;	//	type of asset in the block
+	GAssetRef	AssetRef;	//	ref of asset in the block
+	u32			Offset;		//	offset of the block's GAssetHeader from the start of the file
+	u32			Size;		//	size of the block including the GAssetHeader
+
+} GGutFileTOCEntry;
+
+
+//--------------------------------------------------------------------------------------------------------
+//	last bytes of the file, locates the table of contents
+//--------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	u32		TOCOffset;		//	offset of the first GGutFileTOCEntry from the start of the file
+	u32		TOCCount;		//	number of entries
+
+} GGutFileFooter;
+
+
 
 
 //--------------------------------------------------------------------------------------------------------
@@ -57,6 +82,7 @@ class GGutFile
 {
 public:
 	const static u32	g_Version;		//	current file version
+	const static u32	g_VersionNoTOC;	//	previous file version without a table of contents, still loadable
 	const static char*	g_FileExt;		//	default file extension
 	const static char*	g_FileFilter;	//	file filter for dialogs
 
@@ -64,6 +90,7 @@ public:
 public:
 	GList<GAsset*>		m_Assets;	//	assets present in the file
 	GGutFileHeader		m_Header;	//	file header
+	GList<GGutFileTOCEntry>	m_TOC;	//	table of contents from last load/save
 	
 
 public:
@@ -78,11 +105,13 @@ public:
 	GAsset*	FindAsset(GAssetType Type, GAssetRef Ref);	//	find an asset matching the ref and type
 
 	int		LoadAssets();						//	load assets into global asset lists
-	Bool	Load(const GString& Filename);		//	load all the data out of the specified filename and into this class
+	Bool	Load(const GString& Filename, Bool Mapped=FALSE);	//	load all the data out of the specified filename and into this class. Mapped assets view the file's memory instead of copying it (kept mapped until GAssets::ClearAssets)
 	Bool	Save(const GString& Filename);		//	save all the data out of this and into a file
+	int		LoadLazy(const GString& Filename);	//	map the file and add its assets straight into the global asset lists, each is loaded when first accessed. returns number of assets added
 	
 private:
 	Bool	ImportData(GBinaryData& Data);		//	turn current data(private data) into assets etc
+	Bool	ReadTOC(GBinaryData& Data);			//	read the header and table of contents (empty for old versions). leaves read pos after the header
 	Bool	ExportData(GBinaryData& Data);		//	turn current assets(public data) into data to be saved
 };
 
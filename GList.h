@@ -19,7 +19,8 @@
 
 //	Macros
 //------------------------------------------------
-#define GLIST_DEFAULT_GROWBY	10	//	when we have to increase our array, alloc a block at once to save lots of creation and deletion
+#define GLIST_DEFAULT_GROWBY		10	//	when we have to increase our array, alloc at least this many extra elements at once
+#define GLIST_DEFAULT_GROWPERCENT	50	//	and grow by this % of the current allocation so adding is amortized O(1)
 
 
 
@@ -33,7 +34,9 @@ protected:
 	int					m_Alloc;	//	memory allocated
 	int					m_Size;		//	current amount used
 	TYPE*				m_pData;	//	pointer to actual data
-	int					m_GrowBy;	//	amount to growby at once
+	int					m_GrowBy;	//	minimum amount to growby at once
+	int					m_GrowPercent;	//	% of current allocation to growby at once (0 for linear growth)
+	Bool				m_External;	//	m_pData points at memory we dont own (eg. a mapped file)
 
 public:
 	GList();
@@ -43,11 +46,16 @@ public:
 	virtual int			Size() const								{	return m_Size;	};
 	virtual TYPE*		Data() const								{	return m_pData;	};
 	virtual const TYPE*	DataConst() const							{	return m_pData;	};
-	inline void			SetGrow(int Grow)							{	m_GrowBy = Grow;	};
+	inline int			Allocated() const							{	return m_Alloc;	};
+	inline void			SetGrow(int Grow,int GrowPercent=GLIST_DEFAULT_GROWPERCENT)	{	m_GrowBy = Grow;	m_GrowPercent = GrowPercent;	};
 
 	//	array
 	virtual void		Resize(int size);							//	set new size
 	virtual void		Realloc(int size);							//	set new amount of allocated data
+	void				Reserve(int size);							//	make sure there's room for this many elements without changing the size
+	void				TakeData(GList<TYPE>& List);				//	take the other list's data without copying it, leaving it empty
+	void				SetExternal(TYPE* pData, int size);			//	use memory we dont own as our data (no copy). it's copied into our own allocation if the list has to grow. plain data types only
+	inline Bool			IsExternal() const							{	return m_External;	};
 
 	virtual TYPE&		ElementAt(int Index)						{	GDebug_CheckIndex(Index,0,m_Size); return m_pData[Index];	};
 	virtual const TYPE&	ElementAtConst(int Index) const				{	GDebug_CheckIndex(Index,0,m_Size); return m_pData[Index];	};
@@ -61,6 +69,9 @@ public:
 	inline void			operator+=(const TYPE val)					{	Add(val);	};
 	inline void			operator+=(const TYPE& val)					{	Add(val);	};
 	inline void			operator+=(const TYPE* val)					{	Add(val);	};
+
+protected:
+	int					GrowAllocSize(int size) const;				//	new allocation size when growing to fit size elements
 };			
 
 
@@ -82,6 +93,8 @@ GList<TYPE>::GList()
 	m_Size		= 0;
 	m_pData		= NULL;
 	m_GrowBy	= GLIST_DEFAULT_GROWBY;
+	m_GrowPercent	= GLIST_DEFAULT_GROWPERCENT;
+	m_External	= FALSE;
 	m_Sorted	= FALSE;
 }
 
@@ -89,7 +102,14 @@ GList<TYPE>::GList()
 template <class TYPE>
 GList<TYPE>::GList(const GList<TYPE>& CopyList)
 {
-	GList();
+	m_Alloc		= 0;
+	m_Size		= 0;
+	m_pData		= NULL;
+	m_GrowBy	= CopyList.m_GrowBy;
+	m_GrowPercent	= CopyList.m_GrowPercent;
+	m_External	= FALSE;
+	m_Sorted	= FALSE;
+
 	Copy(CopyList);
 }
 
@@ -119,7 +139,9 @@ void GList<TYPE>::Resize(int size)
 	}
 	*/
 
-	if ( (int)size<=m_Alloc )
+	//	external data cant grow, even into the space it used to have, as that
+	//	memory may be used by something else (eg. the next list in a mapped file)
+	if ( (int)size<=m_Alloc && !( m_External && size > m_Size ) )
 	{
 		//	dont need to expand our array
 		m_Size = (int)size;
@@ -151,7 +173,7 @@ void GList<TYPE>::Resize(int size)
 	//	delete old data
 	DELETE_ARRAY(pOldData);
 	*/
-	Realloc( size );
+	Realloc( GrowAllocSize( size ) );
 	m_Size = size;
 
 	//	list must be sorted if there will be 1 or less elements, otherwise assume new elements will make it out of order
@@ -162,6 +184,29 @@ void GList<TYPE>::Resize(int size)
 
 
 
+//-------------------------------------------------------------------------
+//	grow geometrically so lots of adds only realloc O(log n) times
+//-------------------------------------------------------------------------
+template <class TYPE>
+int GList<TYPE>::GrowAllocSize(int size) const
+{
+	int Alloc = m_Alloc + ( m_Alloc / 100 ) * m_GrowPercent + ( ( m_Alloc % 100 ) * m_GrowPercent ) / 100;
+
+	if ( Alloc < size + m_GrowBy )
+		Alloc = size + m_GrowBy;
+
+	return Alloc;
+}
+
+
+template <class TYPE>
+void GList<TYPE>::Reserve(int size)
+{
+	if ( size > m_Alloc )
+		Realloc( size );
+}
+
+
 template <class TYPE>
 void GList<TYPE>::Realloc(int size)
 {
@@ -170,7 +215,13 @@ void GList<TYPE>::Realloc(int size)
 	{
 		m_Alloc = 0;
 		m_Size	= 0;
-		GDeleteArray( m_pData );
+
+		//	external data isn't ours to delete
+		if ( m_External )
+			m_pData = NULL;
+		else
+			GDeleteArray( m_pData );
+		m_External = FALSE;
 		return;
 	}
 
@@ -182,8 +233,6 @@ void GList<TYPE>::Realloc(int size)
 	if ( m_Alloc == 0 )
 	{
 		m_Alloc = size;
-		m_Alloc += m_GrowBy;
-		//m_Alloc %= m_GrowBy;
 		m_pData	= new TYPE[ m_Alloc ];
 		
 		#ifdef MEMSET_NEW_ALLOC
@@ -195,37 +244,94 @@ void GList<TYPE>::Realloc(int size)
 
 	//	resizing allocation
 	TYPE* pOldData = m_pData;
+	Bool OldExternal = m_External;
 
-	//	pad m_Alloc up to growby rate
-	if ( !m_GrowBy )
-		m_GrowBy = 1;
-
-	//	set size and align to growby
-	m_Alloc = size;
-	m_Alloc += m_GrowBy;
-	//m_Alloc %= m_GrowBy;
+	//	shrinking below the current size loses the elements on the end
+	if ( m_Size > size )
+		m_Size = size;
 
 	//	alloc new data
+	m_Alloc = size;
 	m_pData	= new TYPE[ m_Alloc ];
 	if ( !m_pData )
 	{
 		GDebug_Break("Failed to allocate %d elements for GList\n",m_Alloc);
+		m_pData = pOldData;
 		Realloc(0);
 		return;
 	}
 
-	//	copy old elements
+	//	move old elements, old elements are deleted straight after so anything they own can be taken
 	if ( pOldData )
 	{
-		GCopyData( m_pData, pOldData, m_Size );
+		GMoveData( m_pData, pOldData, m_Size );
 	}
 
-	//	delete old data
-	GDeleteArray( pOldData );
+	//	delete old data (external data is now copied into our own allocation)
+	m_External = FALSE;
+	if ( !OldExternal )
+		GDeleteArray( pOldData );
+}
+
+
+//-------------------------------------------------------------------------
+//	take the other list's allocation. used to move lists around without
+//	copying (and then deleting) all their elements
+//-------------------------------------------------------------------------
+template <class TYPE>
+void GList<TYPE>::TakeData(GList<TYPE>& List)
+{
+	if ( &List == this )
+		return;
+
+	Realloc(0);
+
+	m_pData		= List.m_pData;
+	m_Alloc		= List.m_Alloc;
+	m_Size		= List.m_Size;
+	m_Sorted	= List.m_Sorted;
+	m_External	= List.m_External;
+
+	List.m_pData	= NULL;
+	List.m_External	= FALSE;
+	List.m_Alloc	= 0;
+	List.m_Size		= 0;
+	List.m_Sorted	= TRUE;
 }
 
 
+//-------------------------------------------------------------------------
+//	view someone else's memory (eg. a mapped file) without copying it. the
+//	memory must stay valid for as long as the list is using it
+//-------------------------------------------------------------------------
+template <class TYPE>
+void GList<TYPE>::SetExternal(TYPE* pData, int size)
+{
+	Realloc(0);
+
+	if ( !pData || size <= 0 )
+		return;
+
+	m_pData		= pData;
+	m_Alloc		= size;
+	m_Size		= size;
+	m_External	= TRUE;
+	SetSorted( size < 2 );
+}
+
 
+//-------------------------------------------------------------------------
+//	lists of lists move each list's data rather than memcpy'ing it (which
+//	would leave the old list deleting the data we're now using)
+//-------------------------------------------------------------------------
+template<class TYPE>
+inline void GMoveData(GList<TYPE>* pNewData, GList<TYPE>* pOldData, int Elements)
+{
+	for ( int i=0;	i<Elements;	i++ )
+	{
+		pNewData[i].TakeData( pOldData[i] );
+	}
+}
 
 
 
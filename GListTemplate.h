@@ -455,10 +455,13 @@ void GListTemplate<TYPE>::QuickSort(int First, int Last, Bool RemoveDuplicates)
 		}
 	}
 
+	//	use the middle element as the pivot so already-sorted lists dont recurse for every element
+	Swap( First, First + ((Last-First)/2) );
+
 	int End = First;
 	for ( int Current=First+1;	Current<=Last;	Current++ )
 	{
-		if ( CompareIsLess( Current, First ) )
+		if ( CompareIsLess( ElementAt(Current), ElementAt(First) ) )
 		{
 			Swap( ++End, Current );
 		}
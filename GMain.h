@@ -190,6 +190,17 @@ inline void GCopyData(TYPE* pNewData, const TYPE* pOldData, int Elements)
 	memcpy( pNewData, pOldData, sizeof(TYPE) * Elements );
 }
 
+//-------------------------------------------------------------------------
+//	overloaded move for when a list reallocates. the old elements are deleted
+//	afterwards, so types that own memory should overload this to take it
+//	from the old element instead of copying it
+//-------------------------------------------------------------------------
+template<class TYPE>
+inline void GMoveData(TYPE* pNewData, TYPE* pOldData, int Elements)
+{
+	GCopyData( pNewData, pOldData, Elements );
+}
+
 //-------------------------------------------------------------------------
 //	limit a variable between a min and max
 //-------------------------------------------------------------------------
@@ -477,7 +477,8 @@ void GSubMap::PreDrawGameObjects(GCamera* pCamera, GWorld& World, GList<u32>& Vi
 		}
 
 		//	check culling
-		if ( pGameObject->GetBounds().IsCulled( pGameObject->m_Position, pCamera ) )
+		float3 Position = pGameObject->RenderPosition();
+		if ( pGameObject->GetBounds().IsCulled( Position, pCamera ) )
 		{
 			PreDrawResults[i] = GPreDrawResult_Culled;
 			continue;
@@ -141,6 +141,22 @@ void GMatrix::operator *= (const GMatrix &Matrix)
 	#endif
 }
 
+//---------------------------------------------------------------------------
+//  straight into this matrix, for when we don't need a*=b's copy
+//---------------------------------------------------------------------------
+void GMatrix::SetMultiply(const GMatrix& a, const GMatrix& b)
+{
+	const float* pA = &a.m_Matrix[0];
+	for ( int c = 0; c < 4; c++)
+	{
+		const float* pB = &b.m_Matrix[c*4];
+		float* pOut = &m_Matrix[c*4];
+
+		for ( int r = 0; r < 4; r++)
+			pOut[r] = pA[r] * pB[0] + pA[4+r] * pB[1] + pA[8+r] * pB[2] + pA[12+r] * pB[3];
+	}
+}
+
 //---------------------------------------------------------------------------
 //  
 //---------------------------------------------------------------------------
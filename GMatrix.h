@@ -90,6 +90,7 @@ public:
 	inline void			SetIdentity()					{	Copy( g_Identity );	};
 	inline Bool			IsIdentity()					{	return Compare( g_Identity );	};
 
+	void				SetMultiply(const GMatrix& a, const GMatrix& b);	//	this = a * b without a temporary. a and b must not be this matrix
 	void				Transpose();
 	void				Invert();
 	void				Rotate(const GQuaternion& q);			//	rotate by quaternion
@@ -45,11 +45,8 @@ Bool GTriStrip::Load(GBinaryData& Data)
 	if ( !Data.Read( &Header, GDataSizeOf(GTriStripHeader), "TriStrip Header" ) )
 		return FALSE;
 
-	//	check theres enough data for indicies
-	m_Indicies.Resize( Header.Indicies );
-	
-	//	copy data
-	if ( !Data.Read( m_Indicies.Data(), m_Indicies.DataSize(), "Tristrip indicies" ) )
+	//	read indicies (or view them if data is mapped)
+	if ( !Data.ReadList( m_Indicies, Header.Indicies, "Tristrip indicies" ) )
 		return FALSE;
 
 	return TRUE;
@@ -78,6 +75,7 @@ GMesh::GMesh()
 	m_VBOTexCoordID	= 0;
 
 	m_ShadowData.m_pOwner = this;
+	m_BVH.m_pOwner = this;
 }
 
 
@@ -104,6 +102,8 @@ void GMesh::Cleanup()
 
 	m_TriStrips.Empty();
 	m_TriStripColours.Empty();
+
+	m_BVH.Cleanup();
 }
 
 
@@ -162,6 +162,31 @@ void GMesh::AllocTriStrips(int t)
 
 
 //-------------------------------------------------------------------------
+//	grid cell a vertex falls into when welding. cells are at least the 
+//	size of the tolerance so any match is always in a neighbouring cell
+//-------------------------------------------------------------------------
+inline int3 GetWeldCell(const float3& Pos, float InvCellSize)
+{
+	return int3( (int)floorf( Pos.x * InvCellSize ), (int)floorf( Pos.y * InvCellSize ), (int)floorf( Pos.z * InvCellSize ) );
+}
+
+//-------------------------------------------------------------------------
+//	hash a weld cell into a bucket index. TableMask must be (power of 2)-1
+//-------------------------------------------------------------------------
+inline int HashWeldCell(int x, int y, int z, u32 TableMask)
+{
+	u32 Hash = ( (u32)x * 73856093 ) ^ ( (u32)y * 19349663 ) ^ ( (u32)z * 83492791 );
+	return (int)( Hash & TableMask );
+}
+
+
+//-------------------------------------------------------------------------
+//	works out which verts will be merged together without modifying the mesh.
+//	Remap is filled with the new index for every old vert, or -1 if the vert
+//	is removed because no triangles or tristrips use it. verts are bucketed
+//	into a hashed grid so this is O(n) rather than checking every vert pair.
+//	returns the new number of verts
+//
 //		//	any verts this far from each other will be merged
 //	const float DistanceTolerance = 0.001f;
 //
@@ -169,366 +194,362 @@ void GMesh::AllocTriStrips(int t)
 //	const float UVTolerance = 0.01f;
 //
 //-------------------------------------------------------------------------
-void GMesh::MergeVerts(float DistanceTolerance, Bool CheckUV, float UVTolerance)
+int GMesh::GenerateVertexWeldMap(GList<int>& Remap, float DistanceTolerance, Bool CheckUV, float UVTolerance)
 {
-	int va,vb,v,t,i;
+	int v,t,i;
 	float DistanceToleranceSq = DistanceTolerance * DistanceTolerance;
 	float UVToleranceSq = UVTolerance * UVTolerance;
+	Bool UseUV = CheckUV && ( m_TextureUV.Size() == VertCount() );
 
-	//	list of verts we've removed and kept for quick access later
-	GList<int2> VertsRemoved;	//	1st int is the vert removed, 2nd is the vert its replaced with
-	GList<int> VertsKept;
-	VertsKept.Realloc( VertCount() );
-	VertsRemoved.Realloc( VertCount() );
-
+	Remap.Resize( VertCount() );
+	if ( !VertCount() )
+		return 0;
 
-	//	merge any verts
-	for ( va=0;	va<VertCount();	va++ )
+	//	cells cant be smaller than the tolerance. they're also kept big enough that
+	//	the furthest vert's cell fits in an int, so a tiny or zero tolerance still
+	//	works (verts in the same place always share a cell)
+	float MaxCoord = 0.f;
+	for ( v=0;	v<VertCount();	v++ )
 	{
-		if ( va % 200 == 0 )
-		{
-			GDebug_Print("MergeVerts: Merging vertex %d/%d...\n", va, VertCount() );
-		}
+		float3& Vert = m_Verts[v];
+		MaxCoord = GMax( MaxCoord, GMax( fabsf( Vert.x ), GMax( fabsf( Vert.y ), fabsf( Vert.z ) ) ) );
+	}
 
-		//	skip this vert if we've removed it
-		Bool Skip = FALSE;
-		for ( i=0;	i<VertsRemoved.Size();	i++ )
-		{
-			if ( VertsRemoved[i][0] == va )
-			{
-				Skip = TRUE;
-				break;
-			}
-		}
+	const float MaxCells = (float)(1<<20);
+	float CellSize = GMax( DistanceTolerance, GMax( MaxCoord / MaxCells, NEAR_ZERO ) );
+	float InvCellSize = 1.f / CellSize;
 
-		if ( Skip )
-			continue;
+	//	bucket table is a power of 2 at least twice the number of verts
+	u32 TableSize = 2;
+	while ( TableSize < (u32)VertCount()*2 )
+		TableSize <<= 1;
+	u32 TableMask = TableSize - 1;
 
+	GList<int> BucketFirst;		//	first vert in each bucket
+	GList<int> BucketNext;		//	next vert in the same bucket
+	GList<int> WeldedTo;		//	old index of the vert each vert is merged into (or itself)
+	BucketFirst.Resize( TableSize );
+	BucketNext.Resize( VertCount() );
+	WeldedTo.Resize( VertCount() );
+	BucketFirst.SetAll( -1 );
 
-		//	this vert hasnt already been removed, so we keep it
-		VertsKept.Add( va );
+	//	find a match for each vert amongst the verts we're keeping in the neighbouring cells
+	for ( v=0;	v<VertCount();	v++ )
+	{
+		float3& Vert = m_Verts[v];
+		int3 Cell = GetWeldCell( Vert, InvCellSize );
+		int Match = -1;
 
-		//	find a match for va
-		for ( vb=va+1;	vb<VertCount();	vb++ )
+		for ( int dx=-1;	dx<=1 && Match==-1;	dx++ )
 		{
-			float3& verta = m_Verts[va];
-			float3& vertb = m_Verts[vb];
-			float vertdist = (verta - vertb).LengthSq();
-			
-			//	merge if vertexes are close
-			Bool Merge = (vertdist <= DistanceToleranceSq );
-
-			//	check UV close-ness before merging
-			if ( Merge && m_TextureUV.Data() && CheckUV )
-			{
-				float2 UVDist;
-				UVDist.x = fabsf( m_TextureUV[va].x - m_TextureUV[vb].x );
-				UVDist.y = fabsf( m_TextureUV[va].y - m_TextureUV[vb].y );
-				
-				if ( UVDist.LengthSq() > UVToleranceSq )
-					Merge = FALSE;
-			}
-
-
-			if ( Merge )
+			for ( int dy=-1;	dy<=1 && Match==-1;	dy++ )
 			{
-				//	we're merging vb into va, so we're gonna be removing vb
-				VertsRemoved.Add( int2( vb, va ) );
+				for ( int dz=-1;	dz<=1 && Match==-1;	dz++ )
+				{
+					int Bucket = HashWeldCell( Cell.x+dx, Cell.y+dy, Cell.z+dz, TableMask );
+					for ( int k=BucketFirst[Bucket];	k!=-1;	k=BucketNext[k] )
+					{
+						//	merge if vertexes are close
+						if ( (m_Verts[k] - Vert).LengthSq() > DistanceToleranceSq )
+							continue;
 
-				//	average vert pos
-				verta += vertb;
-				verta *= 0.5f;
+						//	check UV close-ness before merging
+						if ( UseUV )
+						{
+							float2 UVDist;
+							UVDist.x = fabsf( m_TextureUV[k].x - m_TextureUV[v].x );
+							UVDist.y = fabsf( m_TextureUV[k].y - m_TextureUV[v].y );
+							
+							if ( UVDist.LengthSq() > UVToleranceSq )
+								continue;
+						}
 
-				//	merge normals
-				if ( m_Normals.Size() )
-				{
-					float3& normala = m_Normals[ va ];
-					float3& normalb = m_Normals[ vb ];
-					normala += normalb;
-					normala *= 0.5f;
-					normala.Normalise();
+						Match = k;
+						break;
+					}
 				}
 			}
 		}
-	}
-
 
+		//	merged into an existing vert
+		if ( Match != -1 )
+		{
+			WeldedTo[v] = Match;
+			continue;
+		}
 
-	//	stats
-/*	GDebug_Print("Verts Merged: %d\n", VertsRemoved.Size() );
-	for ( i=0;	i<VertsRemoved.Size();	i++ )
-	{
-		GDebug_Print("%d\n", VertsRemoved[i][0] );
+		//	this vert is kept, add it to its cell's bucket
+		WeldedTo[v] = v;
+		int Bucket = HashWeldCell( Cell.x, Cell.y, Cell.z, TableMask );
+		BucketNext[v] = BucketFirst[Bucket];
+		BucketFirst[Bucket] = v;
 	}
-*/
 
-	//	remove any verts that arent referenced by any triangles
-	for ( v=0;	v<VertsKept.Size();	v++ )
+	//	mark which kept verts are referenced by any triangles or tristrips
+	GList<Bool> Referenced;
+	Referenced.Resize( VertCount() );
+	Referenced.SetAll( FALSE );
+
+	for ( t=0;	t<TriCount();	t++ )
 	{
-		if ( v % 20 == 0 )
+		for ( i=0;	i<3;	i++ )
 		{
-			GDebug_Print("MergeVerts: checking vertex references #%d...\n", v );
+			int Index = m_Triangles[t][i];
+			if ( Index >= 0 && Index < VertCount() )
+				Referenced[ WeldedTo[Index] ] = TRUE;
 		}
-	
-		int vindex = VertsKept[v];
-		Bool Unused = TRUE;
+	}
 
-		//	remove triangle references to vb
-		for ( t=0;	t<TriCount();	t++ )
+	for ( t=0;	t<TriStripCount();	t++ )
+	{
+		GTriStrip& TriStrip = m_TriStrips[t];
+		for ( i=0;	i<TriStrip.m_Indicies.Size();	i++ )
 		{
-			for ( i=0;	i<3;	i++ )
-			{
-				if ( m_Triangles[t][i] == vindex )
-				{
-					Unused = FALSE;
-					goto BreakTriCheck;
-				}
-			}
-
+			int Index = TriStrip.m_Indicies[i];
+			if ( Index >= 0 && Index < VertCount() )
+				Referenced[ WeldedTo[Index] ] = TRUE;
 		}
-		BreakTriCheck:;
-
-		//	remove triangle references to vb
-		for ( t=0;	t<TriStripCount();	t++ )
-		{
-			GTriStrip& TriStrip = m_TriStrips[t];
-			for ( i=0;	i<TriStrip.m_Indicies.Size();	i++ )
-			{
-				if ( TriStrip.m_Indicies[i] == vindex )
-				{
-					Unused = FALSE;
-					goto BreakTriStripCheck;
-				}
-			}
+	}
 
-		}
-		BreakTriStripCheck:;
+	//	kept verts keep their original order. merged verts always come after the vert they merge into
+	int NewVertCount = 0;
+	for ( v=0;	v<VertCount();	v++ )
+	{
+		int Kept = WeldedTo[v];
 
-		//	not referenced by any triangles, remove
-		if ( Unused )
-		{
-			//	add to removed list. we can't modify vertskept or it'll mess up our main for loop, so we'll remove entries in both lists later
-			VertsRemoved.Add( int2(vindex,-1) );
-		}
+		if ( !Referenced[Kept] )
+			Remap[v] = -1;
+		else if ( Kept == v )
+			Remap[v] = NewVertCount++;
+		else
+			Remap[v] = Remap[Kept];
 	}
 
+	return NewVertCount;
+}
 
 
-	//	update VertsKept list 
-	for ( v=0;	v<VertsRemoved.Size();	v++ )
-	{
-		//	find the index in the kept list for this removed vert
-		int KeptIndex = VertsKept.FindIndex( VertsRemoved[v][0] );
+//-------------------------------------------------------------------------
+//	rewrite all triangle and tristrip indexes in one pass from an old->new vert table
+//-------------------------------------------------------------------------
+void GMesh::RemapVertexIndexes(GList<int>& Remap)
+{
+	int t,i;
 
-		//	if this removed vert is in the kept list, remove it from the kept list
-		if ( KeptIndex != -1 )
-		{
-			VertsKept.RemoveAt( KeptIndex );
-		}
+	for ( t=0;	t<TriCount();	t++ )
+	{
+		for ( i=0;	i<3;	i++ )
+			RemapVertexIndex( m_Triangles[t][i], Remap );
 	}
 
-/*	//	make sure we havent gone wrong somewhere
-	if ( VertsRemoved.Size() + VertsKept.Size() != m_Verts.Size() )
+	for ( t=0;	t<TriStripCount();	t++ )
 	{
-		GDebug_Break("Temporary vertex array sizes are wrong\n");
-		return;
+		GList<int>& Indicies = m_TriStrips[t].m_Indicies;
+		for ( i=0;	i<Indicies.Size();	i++ )
+			RemapVertexIndex( Indicies[i], Remap );
 	}
-*/
-	//	nothing changed
-	if ( VertsRemoved.Size() == 0 )
+}
+
+
+//-------------------------------------------------------------------------
+//	remap one index. invalid indexes (eg. from bad data) are left alone
+//-------------------------------------------------------------------------
+void GMesh::RemapVertexIndex(int& Index, GList<int>& Remap)
+{
+	if ( Index < 0 || Index >= Remap.Size() )
+		return;
+
+	int NewIndex = Remap[Index];
+	if ( NewIndex == -1 )
 	{
-		GDebug_Print("No verts removed, aborting merge\n");
+		GDebug_Break("Vertex %d is used but has been removed\n", Index );
 		return;
 	}
 
-	//	copy old arrays
-	int NewVertCount = VertsKept.Size();
-	GList<float3> OldVerts;
-	GList<float3> OldNormals;
-	GList<float2> OldTextureUV;
-	OldVerts.Copy( m_Verts );
-	OldNormals.Copy( m_Normals );
-	OldTextureUV.Copy( m_TextureUV );
+	Index = NewIndex;
+}
 
-	//	copy verts from old verts
-	for ( v=0;	v<VertsKept.Size();	v++ )
-	{
-		m_Verts[ v ] = OldVerts[ VertsKept[v] ];
-		
-		if ( m_Normals.Data() )
-			m_Normals[ v ] = OldNormals[ VertsKept[v] ];
 
-		if ( m_TextureUV.Data() )
-			m_TextureUV[ v ] = OldTextureUV[ VertsKept[v] ];
-	}
+//-------------------------------------------------------------------------
+//	merges verts within tolerance of each other and removes unused verts.
+//	merged verts are averaged. if pRemap is specified it's filled with the
+//	new index for every old vert (-1 for removed verts) so other data 
+//	(eg. skin vertex bones) can be updated to match
+//-------------------------------------------------------------------------
+void GMesh::MergeVerts(float DistanceTolerance, Bool CheckUV, float UVTolerance, GList<int>* pRemap)
+{
+	int v;
+	int OldVertCount = VertCount();
 
-	//	resize
-	GDebug_Print("MergeVerts: updating vertex indexes...\n" );
-	AllocVerts( VertsKept.Size() );
-		
-	//	replace vert indexes
-	for ( v=0;	v<VertsRemoved.Size();	v++ )
-	{
-		int VertRemoved = VertsRemoved[v][0];
-		int VertReplaced = VertsRemoved[v][1];
+	GDebug_Print("MergeVerts: Merging %d verts...\n", OldVertCount );
 
-		//	remove triangle references to vb
-		for ( t=0;	t<TriCount();	t++ )
-		{
-			for ( i=0;	i<3;	i++ )
-			{
-				//	replace index
-				if ( m_Triangles[t][i] == VertRemoved )
-				{
-					m_Triangles[t][i] = VertReplaced;
-				}
-			}
-		}
+	GList<int> Remap;
+	int NewVertCount = GenerateVertexWeldMap( Remap, DistanceTolerance, CheckUV, UVTolerance );
 
-		//	remove triangle strip references to vb
-		for ( t=0;	t<TriStripCount();	t++ )
-		{
-			GTriStrip& TriStrip = m_TriStrips[t];
-			for ( i=0;	i<TriStrip.m_Indicies.Size();	i++ )
-			{
-				if ( TriStrip.m_Indicies[i] == VertRemoved )
-				{
-					TriStrip.m_Indicies[i] = VertReplaced;
-				}
-			}
-		}
-	}
+	if ( pRemap )
+		pRemap->Copy( Remap );
 
-
-	//	re-index vert indexes
-	for ( t=0;	t<TriCount();	t++ )
+	//	nothing changed
+	if ( NewVertCount == OldVertCount )
 	{
-		for ( i=0;	i<3;	i++ )
-		{
-			for ( v=0;	v<VertsKept.Size();	v++ )
-			{
-				int OldVert = VertsKept[v];
-				int NewVert = v;
-
-				//	replace index
-				if ( m_Triangles[t][i] == OldVert )
-					m_Triangles[t][i] = NewVert;
-			}
-		}
+		GDebug_Print("No verts removed, aborting merge\n");
+		return;
 	}
 
-	for ( t=0;	t<TriStripCount();	t++ )
+	//	average merged verts and normals. texture coords are taken from the vert we keep
+	Bool HasNormals = ( m_Normals.Size() == OldVertCount );
+	Bool HasUV = ( m_TextureUV.Size() == OldVertCount );
+	GList<float3> NewVerts;
+	GList<float3> NewNormals;
+	GList<int> MergeCount;
+	NewVerts.Resize( NewVertCount );
+	NewVerts.SetAll( float3(0,0,0) );
+	MergeCount.Resize( NewVertCount );
+	MergeCount.SetAll( 0 );
+	if ( HasNormals )
 	{
-		GTriStrip& TriStrip = m_TriStrips[t];
-		for ( i=0;	i<TriStrip.m_Indicies.Size();	i++ )
-		{
-			for ( v=0;	v<VertsKept.Size();	v++ )
-			{
-				int OldVert = VertsKept[v];
-				int NewVert = v;
-
-				//	replace index
-				if ( TriStrip.m_Indicies[i] == OldVert )
-					TriStrip.m_Indicies[i] = NewVert;
-			}
-		}
+		NewNormals.Resize( NewVertCount );
+		NewNormals.SetAll( float3(0,0,0) );
 	}
 
+	for ( v=0;	v<OldVertCount;	v++ )
+	{
+		int NewIndex = Remap[v];
+		if ( NewIndex == -1 )
+			continue;
 
-	//	debug check
-	GDebug_Print("MergeVerts: debug checks...\n" );
+		//	first vert into this index is the one we keep, which is always at or before the old index
+		if ( MergeCount[NewIndex] == 0 && HasUV )
+			m_TextureUV[NewIndex] = m_TextureUV[v];
 
-	for ( t=0;	t<TriCount();	t++ )
-	{
-		for ( i=0;	i<3;	i++ )
-		{
-			if ( m_Triangles[t][i] >= VertCount() )
-			{
-				GDebug_Break("Invalid vert in triangle\n");
-			}
-		}
+		NewVerts[NewIndex] += m_Verts[v];
+		if ( HasNormals )
+			NewNormals[NewIndex] += m_Normals[v];
+		MergeCount[NewIndex]++;
 	}
 
-	for ( t=0;	t<TriStripCount();	t++ )
+	for ( v=0;	v<NewVertCount;	v++ )
 	{
-		GTriStrip& TriStrip = m_TriStrips[t];
-		for ( i=0;	i<TriStrip.m_Indicies.Size();	i++ )
+		m_Verts[v] = NewVerts[v] / (float)MergeCount[v];
+
+		if ( HasNormals )
 		{
-			if ( TriStrip.m_Indicies[i] >= VertCount() )
-			{
-				GDebug_Break("Invalid vert in tristrip\n");
-			}
+			m_Normals[v] = NewNormals[v];
+			if ( m_Normals[v].LengthSq() > NEAR_ZERO )
+				m_Normals[v].Normalise();
 		}
 	}
 
+	//	resize and replace vert indexes
+	GDebug_Print("MergeVerts: updating vertex indexes...\n" );
+	AllocVerts( NewVertCount );
+	RemapVertexIndexes( Remap );
+	UpdateBVH();
+
 	//	check incase something went funny
 	CheckFloats();
 
 	//	finished
-	GDebug_Print("Removed %d verts\n", VertsRemoved.Size() );
-
-	if ( VertsRemoved.Size() )
-		GDebug_Print("Warning: Skins will need re-skinning!\n" );
+	GDebug_Print("Removed %d verts\n", OldVertCount - NewVertCount );
+	GDebug_Print("Warning: Skins will need re-skinning!\n" );
 }
 
 
 
-void GMesh::GenerateTriangleNeighbours()
+//-------------------------------------------------------------------------
+//	hash an undirected edge (lowest vert index first) into a bucket index. TableMask must be (power of 2)-1
+//-------------------------------------------------------------------------
+inline int HashEdge(int VertLow, int VertHigh, u32 TableMask)
 {
-	//	update size
-	m_TriangleNeighbours.Resize(TriCount());
+	u32 Hash = ( (u32)VertLow * 73856093 ) ^ ( (u32)VertHigh * 19349663 );
+	return (int)( Hash & TableMask );
+}
 
-	//	reset neighbours
-	for ( int t=0;	t<TriCount();	t++ )
-	{
-		m_TriangleNeighbours[t] = int3(-1,-1,-1);
-	}
 
+//-------------------------------------------------------------------------
+//	works out which triangles share which edges. Neighbours[t][e] is set to 
+//	the triangle on the other side of edge e (verts e and e+1) of triangle t, 
+//	or -1 if it's an open edge. edges are matched through a hash of their 
+//	(min,max) vert indexes so this is linear in the number of triangles.
+//	if more than 2 triangles share an edge, they're paired in the order found
+//-------------------------------------------------------------------------
+void GMesh::GenerateTriangleAdjacency(GList<GTriangle>& Triangles, GList<int3>& Neighbours)
+{
+	int t,e;
+
+	Neighbours.Resize( Triangles.Size() );
+	Neighbours.SetAll( int3(-1,-1,-1) );
+
+	int EdgeCount = Triangles.Size() * 3;
+	if ( !EdgeCount )
+		return;
 
-	int p1i, p2i, p1j, p2j;
-	int P1i, P2i, P1j, P2j;
-	int i,j,ki,kj;
+	//	bucket table is a power of 2 at least the number of edges
+	u32 TableSize = 2;
+	while ( TableSize < (u32)EdgeCount )
+		TableSize <<= 1;
+	u32 TableMask = TableSize - 1;
 
-	//	do connections
-	for( i=0;	i<TriCount()-1;	i++ )
+	//	edges waiting for a neighbour, indexed by (triangle*3)+edge
+	GList<int> BucketFirst;
+	GList<int> BucketNext;
+	BucketFirst.Resize( TableSize );
+	BucketNext.Resize( EdgeCount );
+	BucketFirst.SetAll( -1 );
+
+	for ( t=0;	t<Triangles.Size();	t++ )
 	{
-		for( j=i+1;	j<TriCount();	j++ )
+		GTriangle& Triangle = Triangles[t];
+
+		for ( e=0;	e<3;	e++ )
 		{
-			for( ki=0;	ki<3;	ki++ )
-			{
-				if( m_TriangleNeighbours[i][ki] == -1 )
-				{
-					for(	kj=0;	kj<3;	kj++ )
-					{
-						p1i	= ki;
-						p1j	= kj;
-						p2i	= (ki+1)%3;
-						p2j	= (kj+1)%3;
+			int VertA = Triangle[e];
+			int VertB = Triangle[(e+1)%3];
+			int VertLow = GMin( VertA, VertB );
+			int VertHigh = GMax( VertA, VertB );
+			int Bucket = HashEdge( VertLow, VertHigh, TableMask );
 
-						p1i	= m_Triangles[i][p1i];
-						p2i	= m_Triangles[i][p2i];
-						p1j	= m_Triangles[j][p1j];
-						p2j	= m_Triangles[j][p2j];
+			//	look for an unmatched edge with the same verts
+			int Prev = -1;
+			int Match = BucketFirst[Bucket];
+			while ( Match != -1 )
+			{
+				GTriangle& MatchTriangle = Triangles[ Match / 3 ];
+				int MatchA = MatchTriangle[ Match % 3 ];
+				int MatchB = MatchTriangle[ (Match+1) % 3 ];
+				if ( GMin( MatchA, MatchB ) == VertLow && GMax( MatchA, MatchB ) == VertHigh )
+					break;
 
-						P1i=((p1i+p2i)-abs(p1i-p2i))/2;
-						P2i=((p1i+p2i)+abs(p1i-p2i))/2;
-						P1j=((p1j+p2j)-abs(p1j-p2j))/2;
-						P2j=((p1j+p2j)+abs(p1j-p2j))/2;
+				Prev = Match;
+				Match = BucketNext[Match];
+			}
 
-						//	they are neighbours
-						if((P1i==P1j) && (P2i==P2j))
-						{
-							m_TriangleNeighbours[i][ki]	= j;	  
-							m_TriangleNeighbours[j][kj]	= i;	  
-						}
-					}
-				}
+			//	no match yet, wait for another triangle to use this edge
+			if ( Match == -1 )
+			{
+				int Edge = (t*3) + e;
+				BucketNext[Edge] = BucketFirst[Bucket];
+				BucketFirst[Bucket] = Edge;
+				continue;
 			}
+
+			//	they are neighbours
+			Neighbours[t][e] = Match / 3;
+			Neighbours[ Match / 3 ][ Match % 3 ] = t;
+
+			//	edge is matched, take it out of the bucket
+			if ( Prev == -1 )
+				BucketFirst[Bucket] = BucketNext[Match];
+			else
+				BucketNext[Prev] = BucketNext[Match];
 		}
 	}
+}
 
 
-
+void GMesh::GenerateTriangleNeighbours()
+{
+	GenerateTriangleAdjacency( m_Triangles, m_TriangleNeighbours );
 }
 
 
@@ -812,13 +833,14 @@ Bool GMesh::Load(GBinaryData& Data)
 {
 	#define READ_BLOCK(addr,size,typestr)	{	if ( !Data.Read( addr, size, typestr ) )	return FALSE;	}
 
-	//	read a list from data (resize list then copy)
+	//	read a list from data (resize list then copy, or view the data if it's mapped)
+	#define READ_LIST( list, arraysize, typestr )	{	if ( !Data.ReadList( list, arraysize, typestr ) )	return FALSE;	}
+
 	#define READ_DATA_LIST( list, flag, arraysize, typestr )		\
 	{																\
 		if ( Header.MeshDataFlags & GMeshDataFlags::flag )			\
 		{															\
-			list.Resize( arraysize );								\
-			READ_BLOCK( list.Data(), list.DataSize(), typestr );	\
+			READ_LIST( list, arraysize, typestr );					\
 		}															\
 	}
 
@@ -838,17 +860,18 @@ Bool GMesh::Load(GBinaryData& Data)
 		return FALSE;
 
 	//	from the header, allocate data
-	AllocVerts( Header.VertexCount );
-	AllocTriangles( Header.TriangleCount );
 	AllocTriStrips( Header.TriStripCount );
 
-	//	now read in the blocks of data
-	READ_BLOCK( m_Verts.Data(),		VertCount() * GDataSizeOf(float3), "Mesh Verts" );
+	//	now read in the blocks of data. verts and triangles are read straight into their
+	//	lists, then Alloc* makes sure any other existing per-vert/triangle lists match
+	READ_LIST( m_Verts,		Header.VertexCount, "Mesh Verts" );
+	AllocVerts( Header.VertexCount );
 
 	READ_DATA_LIST( m_Normals,		VertNormals,	VertCount(), "Mesh Vert normals" );
 	READ_DATA_LIST( m_TextureUV,	VertTextureUV,	VertCount(), "Mesh Vert UV's" );
 
-	READ_BLOCK( m_Triangles.Data(),	TriCount() * GDataSizeOf(int3), "Mesh Triangles" );
+	READ_LIST( m_Triangles,	Header.TriangleCount, "Mesh Triangles" );
+	AllocTriangles( Header.TriangleCount );
 
 	SKIP_OVER_DATA_LIST( /*m_TriangleNormals, */TriangleNormals,	TriCount(), float3, "Mesh Triangle normals" );	//	no longer used
 	READ_DATA_LIST( m_TriangleColours,			TriangleColours,	TriCount(), "Mesh Triangle colours" );
@@ -927,12 +950,16 @@ Bool GMesh::Load(GBinaryData& Data)
 	}
 
 	#undef READ_BLOCK
+	#undef READ_LIST
 	#undef READ_DATA_LIST
 	#undef SKIP_OVER_DATA_LIST
 
 	//	check in case anything went wrong
 	CheckFloats();
 
+	//	build collision/raycast hierarchy
+	GenerateBVH();
+
 	return TRUE;
 }
 
@@ -2558,6 +2585,7 @@ void GMesh::SplitTriStrips()
 	GenerateTriangleNeighbours();
 	GenerateDebugColours();
 	GenerateTriangleCenters();
+	UpdateBVH();
 }
 
 
@@ -2577,6 +2605,9 @@ void GMesh::TriStrip()
 	//	merge verts then tri strip
 	GDebug_Print("Tristripping mesh: Merging verts...\n");
 	MergeVerts();
+
+	//	removing triangles throws away the hierarchy
+	Bool HadBVH = m_BVH.IsValid();
 	
 	u16	 NumOfStrips		= 0;
 	u16  NumOfStripIndicies	= 0;
@@ -2630,6 +2661,9 @@ void GMesh::TriStrip()
 	//	recreate colours
 	GenerateDebugColours();
 
+	if ( HadBVH )
+		GenerateBVH();
+
 	//	result
 	GDebug_Print("Created %d triangle strips\n", TriStripCount() );
 }
@@ -2933,6 +2967,8 @@ void GMesh::RemoveTriangle(int Triangle)
 	if ( m_TriangleCenters.Size() )
 		m_TriangleCenters.RemoveAt( Triangle );
 
+	//	hierarchy's triangle indexes are now wrong. callers removing lots of triangles rebuild it afterwards
+	m_BVH.Cleanup();
 }
 
 
@@ -3233,6 +3269,7 @@ void GMesh::MergeMesh(GMesh* pMesh)
 	//	add tristrip data
 	m_TriStripColours += pMesh->m_TriStripColours;
 
+	UpdateBVH();
 }
 
 
@@ -3260,7 +3297,7 @@ void GMesh::MultiplyVerts(float3& Translation, GQuaternion& Rotation)
 		m_Verts[i] += Translation;
 	}
 
-
+	UpdateBVH();
 }
 
 
@@ -3275,6 +3312,7 @@ void GMesh::Scale(float3 Mult)
 		m_Verts[i] *= Mult;
 	}
 
+	UpdateBVH();
 }
 
 
@@ -3287,6 +3325,8 @@ void GMesh::MoveVerts(float3& Change)
 	{
 		m_Verts[i] += Change;
 	}
+
+	UpdateBVH();
 }
 
 //-------------------------------------------------------------------------
@@ -3584,57 +3624,22 @@ Bool GMesh::Raycast(float3 From, float3 To)
 		GDebug::Break("Raycast length too small\n");
 		return FALSE;
 	}
-	
-	//	get raycast direction
-	float3 RayDir( To-From );
-	float3 RayDirNormal( RayDir.Normal() );
-	float RayLen = RayDir.Length();
-
-	//	todo: make better this!
-
-	//	check each triangle
-	GList<GTriangle> TriangleList;
-	GenerateTrianglesFromTriStrips(TriangleList);
-	TriangleList += m_Triangles;
-
-	GPlane Plane;
-
-	for ( int t=0;	t<TriangleList.Size();	t++ )
-	{
-		float3& v1 = m_Verts[TriangleList[t][0]];
-		float3& v2 = m_Verts[TriangleList[t][1]];
-		float3& v3 = m_Verts[TriangleList[t][2]];
-		
-		//	get the "triangle radius" (todo: store this permanantly)
-		float TriRadSq = 0.f;
-		float v12Len = (v1 - v2).LengthSq();
-		float v13Len = (v1 - v3).LengthSq();
-		float v23Len = (v2 - v3).LengthSq();
-
-		if ( v12Len > v13Len )
-			TriRadSq = ( v12Len > v23Len ? v12Len : v23Len ) * 0.5f;
-		else
-			TriRadSq = ( v13Len > v23Len ? v13Len : v23Len ) * 0.5f;
 
-		float3 TriCenter = ( v1 + v2 + v3 ) * 0.33333f;
-		float DistToPos = (From-TriCenter).LengthSq();
+	GMeshRay Ray;
+	Ray.From = From;
+	Ray.Dir = To - From;
 
-		//	distance from the triangle center to the test pos is greater than the "radius" of the triangle
-		//	means too far away to collide
-		if ( DistToPos > TriRadSq )
-			continue;
+	return Raycast( Ray );
+}
 
-		//	calc the plane and do first check if our test pos traverses through it
-		Plane.CalcEquation( v1, v2, v3 );
-		float3 TriNormal( Plane.Normal() );
-		TriNormal.Invert();
-		TriNormal.Normalise();
 
-		//if ( RaycastToTriangle( Collision, Plane, v1, v2, v3, TestPos, Direction ) )
-			//	return TRUE;
-	}
+Bool GMesh::Raycast(GMeshRay& Ray)
+{
+	//	build hierarchy if it hasn't been already
+	if ( !m_BVH.IsValid() )
+		GenerateBVH();
 
-	return FALSE;
+	return m_BVH.Raycast( Ray );
 }
 
 
@@ -3713,6 +3718,8 @@ void GMesh::GeneratePlanes(Bool ReverseOrder)
 		}
 	}
 
+	//	hierarchy keeps a copy of the planes
+	UpdateBVH();
 }
 
 
@@ -3721,6 +3728,8 @@ void GMesh::GeneratePlanes(Bool ReverseOrder)
 //-------------------------------------------------------------------------
 void GMesh::RemoveInvalidTriangles()
 {
+	Bool HadBVH = m_BVH.IsValid();
+
 	if ( TriCount() )
 	{
 		int OriginalTriCount = TriCount();
@@ -3761,6 +3770,9 @@ void GMesh::RemoveInvalidTriangles()
 	{
 	//	for ( int ts=0;	ts
 	}
+
+	if ( HadBVH && !m_BVH.IsValid() )
+		GenerateBVH();
 }
 		
 //-------------------------------------------------------------------------
@@ -3775,6 +3787,8 @@ void GMesh::CopyTriStrips(GList<GTriStrip>& TriStripList)
 	{
 		m_TriStrips[ts].m_Indicies.Copy( TriStripList[ts].m_Indicies );
 	}
+
+	UpdateBVH();
 }
 
 //-------------------------------------------------------------------------
@@ -4015,6 +4029,26 @@ void GMeshShadow::Generate()
 		return;
 	}
 
-	//
+	//	generate comprehensive list of triangles
+	GList<GTriangle> Triangles;
+	Triangles.Add( m_pOwner->m_Triangles );
+	m_pOwner->GenerateTrianglesFromTriStrips( Triangles );
+
+	GList<int3> Neighbours;
+	GMesh::GenerateTriangleAdjacency( Triangles, Neighbours );
+
+	//	add a quad for every edge. shared edges are only added once, from the lower triangle
+	m_Quads.Realloc( Triangles.Size() * 3 );
+	for ( int t=0;	t<Triangles.Size();	t++ )
+	{
+		for ( int e=0;	e<3;	e++ )
+		{
+			int Neighbour = Neighbours[t][e];
+			if ( Neighbour != -1 && Neighbour < t )
+				continue;
+
+			m_Quads.Add( int4( Triangles[t][e], Triangles[t][(e+1)%3], t, Neighbour ) );
+		}
+	}
 }
 
@@ -20,6 +20,7 @@
 #include "GTexture.h"
 #include "GDisplay.h"
 #include "GCollisionObject.h"
+#include "GMeshBVH.h"
 
 
 //	Macros
@@ -114,7 +115,7 @@ typedef struct
 class GMeshShadow
 {
 public:
-	GList<int4>		m_Quads;	//	quad along each triangle edge
+	GList<int4>		m_Quads;	//	quad along each triangle edge. (vert, vert, triangle, neighbour triangle or -1). triangles index m_Triangles followed by triangles from tristrips
 	GMesh*			m_pOwner;	//	owner mesh
 
 public:
@@ -171,6 +172,7 @@ public:
 	GList<GPlaneList>		m_TriStripPlanes;		//	plane[list] for each triangle strip
 
 	GMeshShadow				m_ShadowData;			//	shadow data
+	GMeshBVH				m_BVH;					//	triangle hierarchy for raycasts and collision
 
 	GList<GCollisionObj>	m_CollisionObjects;		//	collision objects/markers
 	
@@ -203,7 +205,10 @@ public:
 	void				AllocTriStrips(int t);
 	void				Cleanup();
 						
-	void				MergeVerts(float DistanceTolerance=0.001f, Bool CheckUV=TRUE, float UVTolerance=0.01f);	//	reduces re-used verts
+	void				MergeVerts(float DistanceTolerance=0.001f, Bool CheckUV=TRUE, float UVTolerance=0.01f, GList<int>* pRemap=NULL);	//	reduces re-used verts
+	int					GenerateVertexWeldMap(GList<int>& Remap, float DistanceTolerance=0.001f, Bool CheckUV=TRUE, float UVTolerance=0.01f);	//	works out old->new vert indexes for merging. returns new vert count
+	void				RemapVertexIndexes(GList<int>& Remap);	//	replace all triangle/tristrip vert indexes with Remap[index]
+	void				RemapVertexIndex(int& Index, GList<int>& Remap);	//	replace one vert index with Remap[index], if it is valid
 	void				MergeMesh(GMesh* pMesh);		//	add in all the geometry from this mesh
 
 	void				CopyVert(int From, int To);		//	copy details in vert From into vert To
@@ -230,11 +235,14 @@ public:
 	void				InvertPlaneNormals();			//	invert all normals
 						
 	void				GenerateTriangleNeighbours();	//	works out which triangles are connected to which other triangles
+	static void			GenerateTriangleAdjacency(GList<GTriangle>& Triangles, GList<int3>& Neighbours);	//	works out the neighbour triangle on each edge of these triangles
 	void				GenerateDebugColours();			//	generates a (debug)colour for every triangle
 	void				GenerateTriangleCenters();		//	generates a colour for every triangle
 	void				GenerateNormals(Bool ReverseOrder=FALSE);		//	generates our own vertex normals from triangles
 	void				GenerateBounds(Bool Force=FALSE);	//	recalculate bounding parameters
 	void				GenerateShadowData()			{	m_ShadowData.Generate();	};
+	void				GenerateBVH()					{	m_BVH.Generate();	};
+	void				UpdateBVH()						{	if ( m_BVH.IsValid() )	m_BVH.Generate();	};	//	rebuild the hierarchy (if we have one) after changing verts or triangles
 	void				GenerateTrianglesFromTriStrips(GList<GTriangle>& TriangleList);	//	create triangles for each tristrip and add to this list
 	void				GenerateTriangleNormals(GList<GTriangle>& Triangles, GList<float3>& TriangleNormals);	//	generates triangle normals for the given triangles
 	void				GenerateSphere(int SectionsX, int SectionsY);				//	generate sphere
@@ -263,6 +271,7 @@ public:
 
 	//	raycasts
 	Bool				Raycast(float3 From,float3 To);	//	check this line going through geometry (from/to relative to mesh's 0,0,0)
+	Bool				Raycast(GMeshRay& Ray);			//	find the nearest triangle along this ray (relative to mesh's 0,0,0)
 
 	inline void			BindAttribArray(GList<float>& Buffer, int AttribIndex)				{	BindAttribArray( Buffer.Data(), GL_FLOAT, 1, AttribIndex );	};
 	inline void			BindAttribArray(GList<float2>& Buffer, int AttribIndex)				{	BindAttribArray( Buffer.Data(), GL_FLOAT, 2, AttribIndex );	};
@@ -311,6 +320,17 @@ private:
 //	Inline Definitions
 //-------------------------------------------------
 
+//-------------------------------------------------------------------------
+//	move tristrips' index lists when a list of them reallocates
+//-------------------------------------------------------------------------
+inline void GMoveData(GTriStrip* pNewData, GTriStrip* pOldData, int Elements)
+{
+	for ( int i=0;	i<Elements;	i++ )
+	{
+		pNewData[i].m_Indicies.TakeData( pOldData[i].m_Indicies );
+	}
+}
+
 
 
 
@@ -0,0 +1,578 @@
+/*------------------------------------------------
+
+  GMeshBVH.cpp
+
+	bounding volume hierarchy over a mesh's triangles. built
+	with a binned surface area heuristic and flattened into a
+	single node list
+
+-------------------------------------------------*/
+
+
+//	Includes
+//------------------------------------------------
+#include "GMeshBVH.h"
+#include "GMesh.h"
+#include "GDebug.h"
+#include "GApp.h"
+
+
+//	globals
+//------------------------------------------------
+#define BVH_BOUNDS_INFINITY		1e30f		//	initial min/max when growing bounds
+#define BVH_RAY_EPSILON			1e-8f		//	smallest determinant for a ray/triangle hit
+
+GDeclareCounter(MeshBVHNodeTests);
+GDeclareCounter(MeshBVHTriangleTests);
+
+
+//	Definitions
+//------------------------------------------------
+
+
+//-------------------------------------------------------------------------
+//	expand bounds to include a position
+//-------------------------------------------------------------------------
+inline void GrowBounds(float3& Min, float3& Max, const float3& Pos)
+{
+	Min.x = GMin( Min.x, Pos.x );	Max.x = GMax( Max.x, Pos.x );
+	Min.y = GMin( Min.y, Pos.y );	Max.y = GMax( Max.y, Pos.y );
+	Min.z = GMin( Min.z, Pos.z );	Max.z = GMax( Max.z, Pos.z );
+}
+
+//-------------------------------------------------------------------------
+//	surface area of a box, used for the split cost
+//-------------------------------------------------------------------------
+inline float BoundsArea(const float3& Min, const float3& Max)
+{
+	float3 Size( Max.x-Min.x, Max.y-Min.y, Max.z-Min.z );
+	if ( Size.x < 0.f || Size.y < 0.f || Size.z < 0.f )
+		return 0.f;
+
+	return 2.f * ( (Size.x * Size.y) + (Size.y * Size.z) + (Size.z * Size.x) );
+}
+
+//-------------------------------------------------------------------------
+//	does the line From->From+(Dir*MaxLength) pass through this box
+//-------------------------------------------------------------------------
+inline Bool SegmentHitsBox(const float3& From, const float3& Dir, const float3& Min, const float3& Max, float MaxLength)
+{
+	float Near = 0.f;
+	float Far = MaxLength;
+
+	for ( int a=0;	a<3;	a++ )
+	{
+		//	not moving along this axis, must already be inside the slab
+		if ( Dir._t[a] == 0.f )
+		{
+			if ( From._t[a] < Min._t[a] || From._t[a] > Max._t[a] )
+				return FALSE;
+			continue;
+		}
+
+		float InvDir = 1.f / Dir._t[a];
+		float SlabNear = ( Min._t[a] - From._t[a] ) * InvDir;
+		float SlabFar = ( Max._t[a] - From._t[a] ) * InvDir;
+		if ( SlabNear > SlabFar )
+		{
+			float Tmp = SlabNear;
+			SlabNear = SlabFar;
+			SlabFar = Tmp;
+		}
+
+		Near = GMax( Near, SlabNear );
+		Far = GMin( Far, SlabFar );
+		if ( Near > Far )
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+
+GMeshBVH::GMeshBVH()
+{
+	m_pOwner = NULL;
+}
+
+GMeshBVH::~GMeshBVH()
+{
+	Cleanup();
+}
+
+//-------------------------------------------------------------------------
+//	cleanup current data
+//-------------------------------------------------------------------------
+void GMeshBVH::Cleanup()
+{
+	m_Nodes.Empty();
+	m_Triangles.Empty();
+	m_Planes.Empty();
+	m_TriangleOrder.Empty();
+}
+
+
+//-------------------------------------------------------------------------
+//	build the tree from our owner's triangles and tristrips
+//-------------------------------------------------------------------------
+void GMeshBVH::Generate()
+{
+	int t,i;
+
+	Cleanup();
+
+	if ( !m_pOwner )
+	{
+		GDebug_Break("Cannot generate BVH without owner\n");
+		return;
+	}
+
+	GMesh& Mesh = *m_pOwner;
+
+	//	generate comprehensive list of triangles
+	m_Triangles.Add( Mesh.m_Triangles );
+	Mesh.GenerateTrianglesFromTriStrips( m_Triangles );
+
+	if ( !TriCount() )
+		return;
+
+	//	copy planes in the same order if the mesh has them all
+	Bool HasAllPlanes = ( Mesh.m_TrianglePlanes.Size() == Mesh.TriCount() ) && ( Mesh.m_TriStripPlanes.Size() == Mesh.TriStripCount() );
+	for ( t=0;	t<Mesh.TriStripCount() && HasAllPlanes;	t++ )
+	{
+		if ( Mesh.m_TriStripPlanes[t].Size() < Mesh.m_TriStrips[t].m_Indicies.Size()-2 )
+			HasAllPlanes = FALSE;
+	}
+
+	if ( HasAllPlanes )
+	{
+		m_Planes.Realloc( TriCount() );
+		m_Planes.Add( Mesh.m_TrianglePlanes );
+		for ( t=0;	t<Mesh.TriStripCount();	t++ )
+		{
+			int StripTriangles = Mesh.m_TriStrips[t].m_Indicies.Size()-2;
+			if ( StripTriangles > 0 )
+				m_Planes.Add( Mesh.m_TriStripPlanes[t].Data(), StripTriangles );
+		}
+	}
+
+	//	get bounds and center of every triangle
+	GList<float3> TriMin;
+	GList<float3> TriMax;
+	GList<float3> TriCenter;
+	TriMin.Resize( TriCount() );
+	TriMax.Resize( TriCount() );
+	TriCenter.Resize( TriCount() );
+	m_TriangleOrder.Resize( TriCount() );
+
+	for ( t=0;	t<TriCount();	t++ )
+	{
+		float3& v0 = Mesh.m_Verts[ m_Triangles[t].x ];
+		TriMin[t] = v0;
+		TriMax[t] = v0;
+		for ( i=1;	i<3;	i++ )
+			GrowBounds( TriMin[t], TriMax[t], Mesh.m_Verts[ m_Triangles[t][i] ] );
+
+		TriCenter[t] = ( TriMin[t] + TriMax[t] ) * 0.5f;
+		m_TriangleOrder[t] = t;
+	}
+
+	//	build tree from the root
+	m_Nodes.Realloc( ( TriCount() * 2 ) / GMESHBVH_MAX_LEAF_TRIANGLES + 1 );
+	BuildNode( TriMin, TriMax, TriCenter, 0, TriCount(), 0 );
+}
+
+
+//-------------------------------------------------------------------------
+//	create a node for m_TriangleOrder[First..First+Count] and split it
+//	into children where the surface area heuristic says it's worth it
+//-------------------------------------------------------------------------
+int GMeshBVH::BuildNode(GList<float3>& TriMin, GList<float3>& TriMax, GList<float3>& TriCenter, int First, int Count, int Depth)
+{
+	int i,b;
+
+	GMeshBVHNode NewNode;
+	NewNode.Min = float3( BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY );
+	NewNode.Max = float3( -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY );
+	NewNode.Index = First;
+	NewNode.Count = Count;
+
+	//	get bounds of the triangles and their centers
+	float3 CenterMin = NewNode.Min;
+	float3 CenterMax = NewNode.Max;
+	for ( i=First;	i<First+Count;	i++ )
+	{
+		int t = m_TriangleOrder[i];
+		GrowBounds( NewNode.Min, NewNode.Max, TriMin[t] );
+		GrowBounds( NewNode.Min, NewNode.Max, TriMax[t] );
+		GrowBounds( CenterMin, CenterMax, TriCenter[t] );
+	}
+
+	int NodeIndex = m_Nodes.Add( NewNode );
+
+	//	small enough to be a leaf
+	if ( Count <= GMESHBVH_MAX_LEAF_TRIANGLES || Depth >= GMESHBVH_MAX_DEPTH-2 )
+		return NodeIndex;
+
+	//	split along the axis the centers are most spread out on
+	int Axis = 0;
+	float3 CenterSize = CenterMax - CenterMin;
+	if ( CenterSize.y > CenterSize._t[Axis] )	Axis = 1;
+	if ( CenterSize.z > CenterSize._t[Axis] )	Axis = 2;
+
+	//	all the centers are in the same place, cant split
+	if ( CenterSize._t[Axis] <= 0.f )
+		return NodeIndex;
+
+	//	put triangles into bins along the axis
+	int BinCount[GMESHBVH_SAH_BINS];
+	float3 BinMin[GMESHBVH_SAH_BINS];
+	float3 BinMax[GMESHBVH_SAH_BINS];
+	for ( b=0;	b<GMESHBVH_SAH_BINS;	b++ )
+	{
+		BinCount[b] = 0;
+		BinMin[b] = float3( BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY );
+		BinMax[b] = float3( -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY );
+	}
+
+	float BinScale = (float)GMESHBVH_SAH_BINS / CenterSize._t[Axis];
+	#define GET_BIN(t)	GMin( (int)( ( TriCenter[t]._t[Axis] - CenterMin._t[Axis] ) * BinScale ), GMESHBVH_SAH_BINS-1 )
+
+	for ( i=First;	i<First+Count;	i++ )
+	{
+		int t = m_TriangleOrder[i];
+		b = GET_BIN(t);
+		BinCount[b]++;
+		GrowBounds( BinMin[b], BinMax[b], TriMin[t] );
+		GrowBounds( BinMin[b], BinMax[b], TriMax[t] );
+	}
+
+	//	sweep from the right to get the cost of everything after each split
+	float RightCost[GMESHBVH_SAH_BINS];
+	float3 SweepMin( BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY );
+	float3 SweepMax( -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY );
+	int SweepCount = 0;
+	for ( b=GMESHBVH_SAH_BINS-1;	b>0;	b-- )
+	{
+		SweepCount += BinCount[b];
+		if ( BinCount[b] )
+		{
+			GrowBounds( SweepMin, SweepMax, BinMin[b] );
+			GrowBounds( SweepMin, SweepMax, BinMax[b] );
+		}
+		RightCost[b-1] = BoundsArea( SweepMin, SweepMax ) * (float)SweepCount;
+	}
+
+	//	sweep from the left to find the cheapest split
+	int BestSplit = -1;
+	float BestCost = BoundsArea( NewNode.Min, NewNode.Max ) * (float)Count;	//	cost of not splitting
+	SweepMin = float3( BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY, BVH_BOUNDS_INFINITY );
+	SweepMax = float3( -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY, -BVH_BOUNDS_INFINITY );
+	SweepCount = 0;
+	for ( b=0;	b<GMESHBVH_SAH_BINS-1;	b++ )
+	{
+		SweepCount += BinCount[b];
+		if ( BinCount[b] )
+		{
+			GrowBounds( SweepMin, SweepMax, BinMin[b] );
+			GrowBounds( SweepMin, SweepMax, BinMax[b] );
+		}
+
+		if ( SweepCount == 0 || SweepCount == Count )
+			continue;
+
+		float Cost = ( BoundsArea( SweepMin, SweepMax ) * (float)SweepCount ) + RightCost[b];
+		if ( Cost < BestCost )
+		{
+			BestCost = Cost;
+			BestSplit = b;
+		}
+	}
+
+	//	not worth splitting a small node
+	if ( BestSplit == -1 && Count <= GMESHBVH_MAX_LEAF_TRIANGLES*4 )
+		return NodeIndex;
+
+	//	partition the triangles either side of the split
+	int LeftCount = 0;
+	if ( BestSplit != -1 )
+	{
+		int Left = First;
+		int Right = First + Count - 1;
+		while ( Left <= Right )
+		{
+			if ( GET_BIN( m_TriangleOrder[Left] ) <= BestSplit )
+			{
+				Left++;
+			}
+			else
+			{
+				m_TriangleOrder.Swap( Left, Right );
+				Right--;
+			}
+		}
+		LeftCount = Left - First;
+	}
+	#undef GET_BIN
+
+	//	no good split found for a big node, just cut it in half
+	if ( LeftCount == 0 || LeftCount == Count )
+		LeftCount = Count / 2;
+
+	//	first child always directly follows its parent
+	BuildNode( TriMin, TriMax, TriCenter, First, LeftCount, Depth+1 );
+	int SecondChild = BuildNode( TriMin, TriMax, TriCenter, First+LeftCount, Count-LeftCount, Depth+1 );
+
+	//	now an inner node
+	m_Nodes[NodeIndex].Index = SecondChild;
+	m_Nodes[NodeIndex].Count = 0;
+
+	return NodeIndex;
+}
+
+
+//-------------------------------------------------------------------------
+//	test ray against triangle (both sides). if it hits nearer than the
+//	ray's current hit, the hit is updated
+//-------------------------------------------------------------------------
+Bool GMeshBVH::RayTriangle(GMeshRay& Ray, int Triangle)
+{
+	int3& Tri = m_Triangles[Triangle];
+	float3& v0 = m_pOwner->m_Verts[ Tri.x ];
+	float3& v1 = m_pOwner->m_Verts[ Tri.y ];
+	float3& v2 = m_pOwner->m_Verts[ Tri.z ];
+
+	float3 Edge1( v1 - v0 );
+	float3 Edge2( v2 - v0 );
+	float3 P( Ray.Dir.CrossProduct( Edge2 ) );
+	float Det = Edge1.DotProduct( P );
+
+	//	ray is parallel to the triangle
+	if ( fabsf( Det ) < BVH_RAY_EPSILON )
+		return FALSE;
+
+	float InvDet = 1.f / Det;
+	float3 T( Ray.From - v0 );
+	float u = T.DotProduct( P ) * InvDet;
+	if ( u < 0.f || u > 1.f )
+		return FALSE;
+
+	float3 Q( T.CrossProduct( Edge1 ) );
+	float v = Ray.Dir.DotProduct( Q ) * InvDet;
+	if ( v < 0.f || u + v > 1.f )
+		return FALSE;
+
+	//	hit is behind the ray or further than our nearest hit
+	float Length = Edge2.DotProduct( Q ) * InvDet;
+	if ( Length < 0.f || Length > Ray.HitLength )
+		return FALSE;
+
+	Ray.HitLength = Length;
+	Ray.HitTriangle = Triangle;
+	return TRUE;
+}
+
+
+//-------------------------------------------------------------------------
+//	find the nearest triangle along the ray
+//-------------------------------------------------------------------------
+Bool GMeshBVH::Raycast(GMeshRay& Ray)
+{
+	Ray.HitLength = 1.f;
+	Ray.HitTriangle = -1;
+
+	if ( !IsValid() )
+		return FALSE;
+
+	int Stack[GMESHBVH_MAX_DEPTH];
+	int StackSize = 0;
+	int NodeTests = 0;
+	Stack[StackSize++] = 0;
+
+	while ( StackSize > 0 )
+	{
+		int NodeIndex = Stack[--StackSize];
+		GMeshBVHNode& Node = m_Nodes[NodeIndex];
+
+		NodeTests++;
+		if ( !SegmentHitsBox( Ray.From, Ray.Dir, Node.Min, Node.Max, Ray.HitLength ) )
+			continue;
+
+		//	leaf, test triangles
+		if ( Node.Count > 0 )
+		{
+			for ( int i=0;	i<Node.Count;	i++ )
+				RayTriangle( Ray, m_TriangleOrder[ Node.Index + i ] );
+			continue;
+		}
+
+		Stack[StackSize++] = Node.Index;
+		Stack[StackSize++] = NodeIndex + 1;
+	}
+
+	GIncCounter(MeshBVHNodeTests,NodeTests);
+
+	return ( Ray.HitTriangle != -1 );
+}
+
+
+//-------------------------------------------------------------------------
+//	raycast a group of rays. rays are processed in packets which walk the
+//	tree together, a node is only skipped when no ray in the packet hits it
+//-------------------------------------------------------------------------
+int GMeshBVH::RaycastPacket(GList<GMeshRay>& Rays)
+{
+	int r,i;
+
+	for ( r=0;	r<Rays.Size();	r++ )
+	{
+		Rays[r].HitLength = 1.f;
+		Rays[r].HitTriangle = -1;
+	}
+
+	if ( !IsValid() )
+		return 0;
+
+	int StackNode[GMESHBVH_MAX_DEPTH];
+	u32 StackMask[GMESHBVH_MAX_DEPTH];
+	int NodeTests = 0;
+
+	for ( int First=0;	First<Rays.Size();	First+=GMESHBVH_MAX_PACKET_RAYS )
+	{
+		GMeshRay* pRays = &Rays[First];
+		int PacketSize = GMin( Rays.Size() - First, GMESHBVH_MAX_PACKET_RAYS );
+		u32 PacketMask = ( PacketSize == 32 ) ? 0xffffffff : ( (1<<PacketSize) - 1 );
+
+		int StackSize = 0;
+		StackNode[StackSize] = 0;
+		StackMask[StackSize] = PacketMask;
+		StackSize++;
+
+		while ( StackSize > 0 )
+		{
+			StackSize--;
+			int NodeIndex = StackNode[StackSize];
+			u32 ParentMask = StackMask[StackSize];
+			GMeshBVHNode& Node = m_Nodes[NodeIndex];
+
+			//	work out which rays are still interested in this node
+			NodeTests++;
+			u32 Mask = 0x0;
+			for ( r=0;	r<PacketSize;	r++ )
+			{
+				if ( !( ParentMask & (1<<r) ) )
+					continue;
+
+				GMeshRay& Ray = pRays[r];
+				if ( SegmentHitsBox( Ray.From, Ray.Dir, Node.Min, Node.Max, Ray.HitLength ) )
+					Mask |= 1<<r;
+			}
+
+			if ( !Mask )
+				continue;
+
+			//	leaf, test triangles against the rays that reached it
+			if ( Node.Count > 0 )
+			{
+				for ( i=0;	i<Node.Count;	i++ )
+				{
+					int t = m_TriangleOrder[ Node.Index + i ];
+					for ( r=0;	r<PacketSize;	r++ )
+					{
+						if ( Mask & (1<<r) )
+							RayTriangle( pRays[r], t );
+					}
+				}
+				continue;
+			}
+
+			StackNode[StackSize] = Node.Index;
+			StackMask[StackSize] = Mask;
+			StackSize++;
+			StackNode[StackSize] = NodeIndex + 1;
+			StackMask[StackSize] = Mask;
+			StackSize++;
+		}
+	}
+
+	GIncCounter(MeshBVHNodeTests,NodeTests);
+
+	int Hits = 0;
+	for ( r=0;	r<Rays.Size();	r++ )
+	{
+		if ( Rays[r].HitTriangle != -1 )
+			Hits++;
+	}
+
+	return Hits;
+}
+
+
+//-------------------------------------------------------------------------
+//	list the triangles whose bounds a sphere of Radius touches when moving
+//	from From to From+Dir. triangles are sorted so they're processed in the
+//	same order as the mesh's triangles then tristrips
+//-------------------------------------------------------------------------
+void GMeshBVH::GetTrianglesInSweptSphere(const float3& From, const float3& Dir, float Radius, GList<int>& Triangles, int2* pTests)
+{
+	Triangles.Empty();
+
+	if ( !IsValid() )
+		return;
+
+	float3 Expand( Radius, Radius, Radius );
+
+	int Stack[GMESHBVH_MAX_DEPTH];
+	int StackSize = 0;
+	int NodeTests = 0;
+	int TriangleTests = 0;
+	Stack[StackSize++] = 0;
+
+	while ( StackSize > 0 )
+	{
+		int NodeIndex = Stack[--StackSize];
+		GMeshBVHNode& Node = m_Nodes[NodeIndex];
+
+		NodeTests++;
+		if ( !SegmentHitsBox( From, Dir, Node.Min - Expand, Node.Max + Expand, 1.f ) )
+			continue;
+
+		//	inner node, check children
+		if ( Node.Count == 0 )
+		{
+			Stack[StackSize++] = Node.Index;
+			Stack[StackSize++] = NodeIndex + 1;
+			continue;
+		}
+
+		//	check the bounds of each triangle in the leaf
+		for ( int i=0;	i<Node.Count;	i++ )
+		{
+			int t = m_TriangleOrder[ Node.Index + i ];
+			int3& Tri = m_Triangles[t];
+			float3 TriMin = m_pOwner->m_Verts[ Tri.x ];
+			float3 TriMax = TriMin;
+			GrowBounds( TriMin, TriMax, m_pOwner->m_Verts[ Tri.y ] );
+			GrowBounds( TriMin, TriMax, m_pOwner->m_Verts[ Tri.z ] );
+
+			TriangleTests++;
+			if ( SegmentHitsBox( From, Dir, TriMin - Expand, TriMax + Expand, 1.f ) )
+				Triangles.Add( t );
+		}
+	}
+
+	if ( pTests )
+	{
+		pTests->x += NodeTests;
+		pTests->y += TriangleTests;
+	}
+	else
+	{
+		GIncCounter(MeshBVHNodeTests,NodeTests);
+		GIncCounter(MeshBVHTriangleTests,TriangleTests);
+	}
+
+	Triangles.Sort();
+}
+
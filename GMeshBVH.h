@@ -0,0 +1,111 @@
+/*------------------------------------------------
+
+  GMeshBVH Header file
+
+	bounding volume hierarchy over a mesh's triangles
+	(including triangles from tristrips) for fast
+	raycasts and collision queries
+
+-------------------------------------------------*/
+
+#ifndef __GMESHBVH__H_
+#define __GMESHBVH__H_
+
+
+
+//	Includes
+//------------------------------------------------
+#include "GMain.h"
+#include "GList.h"
+#include "GDisplay.h"
+
+
+//	Macros
+//------------------------------------------------
+#define GMESHBVH_MAX_LEAF_TRIANGLES		4	//	stop splitting nodes with this many triangles or less
+#define GMESHBVH_SAH_BINS				12	//	number of buckets to evaluate splits with when building
+#define GMESHBVH_MAX_DEPTH				64	//	size of traversal stack
+#define GMESHBVH_MAX_PACKET_RAYS		32	//	rays per packet (one bit each in a u32 mask)
+
+
+
+//	Types
+//------------------------------------------------
+class GMesh;
+
+
+//-------------------------------------------------------------------------
+//	node in the flattened hierarchy. nodes are stored depth first so the
+//	first child of an inner node is always the next node in the list
+//-------------------------------------------------------------------------
+typedef struct
+{
+	float3		Min;			//	bounds of all the triangles under this node
+	float3		Max;
+	int			Index;			//	leaf: first entry in m_TriangleOrder. inner: index of second child node
+	int			Count;			//	leaf: number of triangles. inner: 0
+
+} GMeshBVHNode;
+
+
+//-------------------------------------------------------------------------
+//	ray for raycasts. the ray covers From to From+Dir
+//-------------------------------------------------------------------------
+typedef struct
+{
+	float3		From;			//	start of ray (mesh space)
+	float3		Dir;			//	direction and length of ray
+	float		HitLength;		//	result: 0..1 along Dir of the nearest hit
+	int			HitTriangle;	//	result: triangle hit (GMeshBVH triangle index) or -1
+
+} GMeshRay;
+
+
+//-------------------------------------------------------------------------
+//	BVH for a mesh. triangles are indexed in the order m_Triangles, then
+//	triangles generated from tristrips (same order as GenerateTrianglesFromTriStrips)
+//-------------------------------------------------------------------------
+class GMeshBVH
+{
+public:
+	GList<GMeshBVHNode>	m_Nodes;			//	flattened tree, m_Nodes[0] is the root
+	GList<int3>			m_Triangles;		//	every triangle in the mesh
+	GList<GPlane>		m_Planes;			//	plane for each triangle (copied from the mesh's triangle/tristrip planes)
+	GList<int>			m_TriangleOrder;	//	triangle indexes in leaf order
+	GMesh*				m_pOwner;			//	owner mesh
+
+public:
+	GMeshBVH();
+	~GMeshBVH();
+
+	void			Generate();											//	build tree from owner mesh
+	void			Cleanup();											//	delete existing data
+	inline Bool		IsValid() const										{	return m_Nodes.Size() > 0;	};
+	inline int		TriCount() const									{	return m_Triangles.Size();	};
+	inline Bool		HasPlanes() const									{	return m_Planes.Size() == m_Triangles.Size();	};
+
+	Bool			Raycast(GMeshRay& Ray);								//	find nearest triangle hit along ray. returns if anything was hit
+	int				RaycastPacket(GList<GMeshRay>& Rays);				//	raycast lots of rays at once, sharing traversal. returns number of rays that hit
+	void			GetTrianglesInSweptSphere(const float3& From, const float3& Dir, float Radius, GList<int>& Triangles, int2* pTests=NULL);	//	list triangles whose bounds are touched by a sphere moving along From->From+Dir. list is sorted. node and triangle tests are added to pTests instead of the stats (which aren't thread safe) if it's specified
+
+protected:
+	int				BuildNode(GList<float3>& TriMin, GList<float3>& TriMax, GList<float3>& TriCenter, int First, int Count, int Depth);	//	returns node index
+	Bool			RayTriangle(GMeshRay& Ray, int Triangle);			//	test ray against a triangle, updates ray hit if nearer
+};
+
+
+
+//	Declarations
+//------------------------------------------------
+
+
+
+
+//	Inline Definitions
+//-------------------------------------------------
+
+
+
+
+#endif
+
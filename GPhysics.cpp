@@ -26,6 +26,11 @@
 GDeclareCounter(PhysicsCollisionTest);
 GDeclareCounter(PhysicsCollisionSuccess);
 
+float GPhysicsObject::g_StepDelta = 1.f / FIXED_FRAME_RATEF;
+Bool GPhysicsObject::g_AllowSleep = TRUE;
+float GPhysicsObject::g_SleepSpeed = 1.f;
+int GPhysicsObject::g_SleepSteps = 30;
+
 
 //	Definitions
 //------------------------------------------------
@@ -43,6 +48,10 @@ GPhysicsObject::GPhysicsObject()
 	m_LastFloorFriction	= 0.f;
 	m_pOwner		= NULL;
 	m_PhysicsFlags	= 0x0;
+	m_BroadphaseID	= -1;
+	m_Sleeping		= FALSE;
+	m_SettleSteps	= 0;
+	m_SleepPosition	= float3(0,0,0);
 
 }
 
@@ -64,7 +73,7 @@ void GPhysicsObject::PreUpdate(GWorld* pWorld)
 		m_GravityForce *= -g_WorldToMetres;
 
 		m_GravityForce /= 1.f / FIXED_FRAME_RATEF;
-		m_GravityForce *= g_App->FrameDelta();
+		m_GravityForce *= g_StepDelta;
 		m_Force += m_GravityForce;// * m_Mass;
 	}
 
@@ -86,7 +95,7 @@ void GPhysicsObject::PostUpdate(GWorld* pWorld)
 	m_Force.Set( 0.f, 0.f, 0.f );
 	
 	//	move pos
-	m_pOwner->m_Position += (m_Velocity * g_App->FrameDelta());
+	m_pOwner->m_Position += (m_Velocity * g_StepDelta);
 
 	//	stick object to its floor
 	if ( m_PhysicsFlags & GPhysicsFlags::StickToFloor )
@@ -95,7 +104,7 @@ void GPhysicsObject::PostUpdate(GWorld* pWorld)
 	}
 
 	//	reduce velocity
-	m_Velocity *= 1.f - ( m_Friction * g_App->FrameDelta() * (1.f-m_LastFloorFriction) );
+	m_Velocity *= 1.f - ( m_Friction * g_StepDelta * (1.f-m_LastFloorFriction) );
 	m_Force = float3(0,0,0);
 
 	//	reset delta movement
@@ -107,16 +116,18 @@ void GPhysicsObject::PostUpdate(GWorld* pWorld)
 }
 
 
-/*static*/void GPhysicsObject::ProcessCollision(GPhysicsObject* pObjA, GPhysicsObject* pObjB)
+//-------------------------------------------------------------------------
+//	bounce two touching objects off each other. can be called on worker
+//	threads (for objects no other thread is using) so doesnt count stats
+//-------------------------------------------------------------------------
+/*static*/Bool GPhysicsObject::ProcessCollision(GPhysicsObject* pObjA, GPhysicsObject* pObjB)
 {
-	GIncCounter(PhysicsCollisionTest,1);
-
 	float3 Dist = (pObjB->m_pOwner->m_Position - pObjA->m_pOwner->m_Position); 
 	float DistDot2 = Dist.DotProduct(Dist);  
 
 	// balls are too embedded to be of any use    
 	if ( DistDot2 < NEAR_ZERO )     
-		return;   
+		return FALSE;   
 	
 	Dist /= sqrtf(DistDot2);  
 	
@@ -129,13 +140,62 @@ void GPhysicsObject::PostUpdate(GWorld* pWorld)
 	// there is a small threshold value in case they are moving 
     // very very slowly towards each other.    
 	if ( VdotN >= -NEAR_ZERO ) 
-		return;
-
-	GIncCounter(PhysicsCollisionSuccess,1);
+		return FALSE;
 
 	pObjA->DoCollision( pObjB, Dist, VdotN );
 	pObjB->DoCollision( pObjA, Dist, -VdotN );
 
+	return TRUE;
+}
+
+
+void GPhysicsObject::ApplyImpulse(const float3& Impulse)
+{
+	m_Velocity += Impulse * ( 1.f / m_Mass );
+	Wake();
+}
+
+
+void GPhysicsObject::Sleep()
+{
+	m_Sleeping		= TRUE;
+	m_Velocity		= float3(0,0,0);
+	m_Force			= float3(0,0,0);
+	m_DeltaMovement	= float3(0,0,0);
+	m_SleepPosition	= GetPosition();
+}
+
+
+Bool GPhysicsObject::CheckWake()
+{
+	if ( !m_Sleeping )
+		return TRUE;
+
+	if ( !g_AllowSleep || ( m_PhysicsFlags & GPhysicsFlags::NeverSleep ) ||
+		m_Force.LengthSq() > 0.f || m_DeltaMovement.LengthSq() > 0.f || m_Velocity.LengthSq() > 0.f ||
+		!( GetPosition() == m_SleepPosition ) )
+	{
+		Wake();
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+//-------------------------------------------------------------------------
+//	we're settling if we've moved slower than the sleep speed this step,
+//	measured by our velocity and by how far we actually moved
+//-------------------------------------------------------------------------
+void GPhysicsObject::UpdateSettle(float3& StepFromPosition)
+{
+	float SleepSpeedSq = g_SleepSpeed * g_SleepSpeed;
+	float3 Moved = ( m_pOwner->m_Position - StepFromPosition ) * ( 1.f / g_StepDelta );
+
+	if ( m_Velocity.LengthSq() < SleepSpeedSq && Moved.LengthSq() < SleepSpeedSq )
+		m_SettleSteps++;
+	else
+		m_SettleSteps = 0;
 }
 
 
@@ -168,7 +228,7 @@ void GPhysicsObject::ProcessCollision(GWorld& World)
 		return;
 
 	//	get current movement
-	float3 Movement = AccumulatedMovement() * g_App->FrameDelta();
+	float3 Movement = AccumulatedMovement() * g_StepDelta;
 
 	//	check each mapobject
 	for ( int mo=0;	mo<pSubMap->m_MapObjects.Size();	mo++)
@@ -195,7 +255,12 @@ void GPhysicsObject::ProcessCollision(GWorld& World)
 }
 
 
-void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& From, float3& Dir)
+//-------------------------------------------------------------------------
+//	collide with the mesh's triangles near our movement. with pSweptHit we
+//	just find the first triangle the movement hits (if it's earlier than
+//	the hit already in pSweptHit) without colliding with anything
+//-------------------------------------------------------------------------
+void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& From, float3& Dir, int2* pBVHTests, GSweptHit* pSweptHit)
 {
 	/*
 	//	paramter check
@@ -206,19 +271,39 @@ void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& F
 	}
 	*/
 
-	//	todo: make better this!
-
-	//	check each triangle
-	GList<GTriangle>& TriangleList = pMesh->m_Triangles;
 	int t,i;
+	float3 LocalFrom = From - MeshPos;
 
-	//	debug check pre-calculcated planes
-	if ( pMesh->m_TrianglePlanes.Size() < TriangleList.Size() )
+	//	only check the triangles near us in the mesh's hierarchy
+	GMeshBVH& BVH = pMesh->m_BVH;
+	if ( BVH.IsValid() && BVH.HasPlanes() )
 	{
-		GDebug_Print("Mesh is missing triangle planes\n");
+		BVH.GetTrianglesInSweptSphere( LocalFrom, Dir, CollisionRadius(), m_MeshTestTriangles, pBVHTests );
+
+		for ( i=0;	i<m_MeshTestTriangles.Size();	i++ )
+		{
+			t = m_MeshTestTriangles[i];
+			int3& Triangle = BVH.m_Triangles[t];
+
+			float3& v1 = pMesh->m_Verts[Triangle[0]];
+			float3& v2 = pMesh->m_Verts[Triangle[1]];
+			float3& v3 = pMesh->m_Verts[Triangle[2]];
+
+			if ( pSweptHit )
+				SweepTriangle( LocalFrom, Dir, CollisionRadius(), BVH.m_Planes[t], v1, v2, v3, *pSweptHit );
+			else
+				CheckTriangleCollision( MeshPos, BVH.m_Planes[t], v1, v2, v3, From, Dir );
+		}
 		return;
 	}
 
+	//	no hierarchy, check each triangle
+	GList<GTriangle>& TriangleList = pMesh->m_Triangles;
+
+	//	check pre-calculcated planes. missing planes are reported when gathering test cases, this can run on worker threads
+	if ( pMesh->m_TrianglePlanes.Size() < TriangleList.Size() )
+		return;
+
 	for ( t=0;	t<TriangleList.Size();	t++ )
 	{
 		float3& v1 = pMesh->m_Verts[TriangleList[t][0]];
@@ -227,15 +312,15 @@ void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& F
 
 		GPlane& Plane = pMesh->m_TrianglePlanes[t];
 
-		CheckTriangleCollision( MeshPos, Plane, v1, v2, v3, From, Dir );
+		if ( pSweptHit )
+			SweepTriangle( LocalFrom, Dir, CollisionRadius(), Plane, v1, v2, v3, *pSweptHit );
+		else
+			CheckTriangleCollision( MeshPos, Plane, v1, v2, v3, From, Dir );
 	}
 
-	//	debug check pre-calculcated planes
+	//	check pre-calculcated planes
 	if ( pMesh->m_TriStripPlanes.Size() < pMesh->m_TriStrips.Size() )
-	{
-		GDebug_Print("Mesh is missing tristrip planes\n");
 		return;
-	}
 	
 	//	check tristrips
 	for ( t=0;	t<pMesh->m_TriStrips.Size();	t++ )
@@ -250,10 +335,7 @@ void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& F
 		Triangle[1] = TriStrip.m_Indicies[1];
 	
 		if ( PlaneList.Size() < TriStrip.m_Indicies.Size()-2 )
-		{
-			GDebug_Print("Mesh is missing tristrip planes\n");
 			continue;
-		}
 
 		//	replace the next triangle element in sequence along the tristrip
 		for ( i=2;	i<TriStrip.m_Indicies.Size();	i++ )
@@ -267,11 +349,30 @@ void GPhysicsObject::CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& F
 			
 			GPlane& Plane = PlaneList[i-2];
 
-			CheckTriangleCollision( MeshPos, Plane, v1, v2, v3, From, Dir );
+			if ( pSweptHit )
+				SweepTriangle( LocalFrom, Dir, CollisionRadius(), Plane, v1, v2, v3, *pSweptHit );
+			else
+				CheckTriangleCollision( MeshPos, Plane, v1, v2, v3, From, Dir );
 		}
 	}
+}
 
 
+//-------------------------------------------------------------------------
+//	keep the earliest hit of a swept sphere
+//-------------------------------------------------------------------------
+void GPhysicsObject::SweepTriangle(float3& From, float3& Dir, float Radius, GPlane& Plane, float3& v1, float3& v2, float3& v3, GSweptHit& FirstHit)
+{
+	float HitTime;
+	float3 HitNormal;
+	if ( !SweptSphereTriangle( From, Dir, Radius, v1, v2, v3, Plane, HitTime, HitNormal ) )
+		return;
+
+	if ( HitTime < FirstHit.Time )
+	{
+		FirstHit.Time	= HitTime;
+		FirstHit.Normal	= HitNormal;
+	}
 }
 
 
@@ -324,6 +425,126 @@ void GPhysicsObject::DoIntersection(float3& From, float3& Dir, float3& MeshPos,
 }
 
 
+//-------------------------------------------------------------------------
+//	time of impact of a sphere moving from From to From+Dir with the front
+//	of a triangle. it touches the face first if it can, otherwise an edge
+//	(a cylinder around it) or a corner (a sphere around it)
+//-------------------------------------------------------------------------
+Bool SweptSphereTriangle(float3& From, float3& Dir, float Radius, float3& v0, float3& v1, float3& v2, GPlane& Plane, float& HitTime, float3& HitNormal)
+{
+	float3 Normal( Plane.Normal() );
+	Normal.Normalise();
+
+	//	moving away from or along the triangle
+	float DirDotN = Dir.DotProduct( Normal );
+	if ( DirDotN > -NEAR_ZERO )
+		return FALSE;
+
+	//	behind the triangle, or not getting close enough to its plane
+	float StartDist = ( From - v0 ).DotProduct( Normal );
+	if ( StartDist < 0.f || StartDist + DirDotN > Radius )
+		return FALSE;
+
+	//	touch the plane inside the triangle
+	float PlaneTime = ( StartDist - Radius ) / -DirDotN;
+	float3 PlanePoint = From + Dir * ( PlaneTime > 0.f ? PlaneTime : 0.f ) - Normal * ( PlaneTime > 0.f ? Radius : StartDist );
+	if ( PointInsideTriangle( PlanePoint, v0, v1, v2, Plane ) )
+	{
+		//	already touching the face
+		if ( PlaneTime <= 0.f )
+			return FALSE;
+
+		HitTime		= PlaneTime;
+		HitNormal	= Normal;
+		return TRUE;
+	}
+
+	float3* pVerts[3] = { &v0, &v1, &v2 };
+	float DirLenSq = Dir.LengthSq();
+	float RadiusSq = Radius * Radius;
+	float FirstTime = 1.f;
+	float3 FirstPoint;
+	Bool Hit = FALSE;
+
+	for ( int i=0;	i<3;	i++ )
+	{
+		float3& a = *pVerts[i];
+		float3& b = *pVerts[(i+1)%3];
+		float3 ToFrom = From - a;
+		float ToFromLenSq = ToFrom.LengthSq();
+		float DirDotToFrom = Dir.DotProduct( ToFrom );
+
+		//	already touching the corner
+		if ( ToFromLenSq <= RadiusSq )
+			return FALSE;
+
+		//	corner
+		float Disc = DirDotToFrom * DirDotToFrom - DirLenSq * ( ToFromLenSq - RadiusSq );
+		if ( Disc >= 0.f )
+		{
+			float Time = ( -DirDotToFrom - sqrtf( Disc ) ) / DirLenSq;
+			if ( Time >= 0.f && Time <= FirstTime )
+			{
+				FirstTime	= Time;
+				FirstPoint	= a;
+				Hit			= TRUE;
+			}
+		}
+
+		//	edge, ignoring movement along it
+		float3 Edge = b - a;
+		float EdgeLenSq = Edge.LengthSq();
+		if ( EdgeLenSq < NEAR_ZERO )
+			continue;
+
+		float EdgeDotDir = Edge.DotProduct( Dir );
+		float EdgeDotToFrom = Edge.DotProduct( ToFrom );
+		float A = EdgeLenSq * DirLenSq - EdgeDotDir * EdgeDotDir;
+		float B = EdgeLenSq * DirDotToFrom - EdgeDotDir * EdgeDotToFrom;
+		float C = EdgeLenSq * ( ToFromLenSq - RadiusSq ) - EdgeDotToFrom * EdgeDotToFrom;
+
+		//	already touching the edge
+		float EdgeStart = EdgeDotToFrom / EdgeLenSq;
+		if ( C <= 0.f && EdgeStart >= 0.f && EdgeStart <= 1.f )
+			return FALSE;
+
+		//	moving parallel to the edge, we'll touch a corner first
+		if ( A <= NEAR_ZERO * EdgeLenSq * DirLenSq )
+			continue;
+
+		Disc = B * B - A * C;
+		if ( Disc < 0.f )
+			continue;
+
+		float Time = ( -B - sqrtf( Disc ) ) / A;
+		if ( Time < 0.f || Time > FirstTime )
+			continue;
+
+		float EdgeTime = ( EdgeDotToFrom + Time * EdgeDotDir ) / EdgeLenSq;
+		if ( EdgeTime < 0.f || EdgeTime > 1.f )
+			continue;
+
+		FirstTime	= Time;
+		FirstPoint	= a + Edge * EdgeTime;
+		Hit			= TRUE;
+	}
+
+	if ( !Hit )
+		return FALSE;
+
+	//	must hit it from the front, not after passing the plane beside it
+	float3 HitPos = From + Dir * FirstTime;
+	if ( ( HitPos - v0 ).DotProduct( Normal ) < 0.f )
+		return FALSE;
+
+	HitNormal = HitPos - FirstPoint;
+	HitNormal.Normalise();
+	HitTime = FirstTime;
+
+	return TRUE;
+}
+
+
 
 
 
@@ -336,6 +557,7 @@ GPhysicsSphere::GPhysicsSphere()
 	m_LastRollAxis	= float3(0,1,0);
 	m_LastRoll		= 0.f;
 	m_SphereOffset	= float3(0,0,0);
+	m_ContinuousCollision	= TRUE;
 }
 
 GPhysicsSphere::~GPhysicsSphere()
@@ -348,7 +570,7 @@ void GPhysicsSphere::PostUpdate(GWorld* pWorld)
 	GPhysicsObject::PostUpdate(pWorld);
 
 	//	roll sphere
-	float3 Movement( m_Velocity * g_App->FrameDelta() );
+	float3 Movement( m_Velocity * g_StepDelta );
 	float MovementLenSq = Movement.LengthSq();
 
 	Bool DoRotation = (MovementLenSq > NEAR_ZERO);
@@ -506,10 +728,55 @@ void GPhysicsSphere::DoIntersection(float3& From, float3& Dir, float3& MeshPos,
 	float n = sqrtf(DistDot2);  
 	Dist /= n;  
 
+	BounceOffWall( Dir, Dist, TriangleNormal );
+
+	float     d  = Dist.Length() - n;
+
+	// relative amount of displacement to make the ball touch (walls have a mass of 1)
+	float ratio1 = 1.f / (m_Mass + 1.f);   
+
+	// move the balls to theire ideal positon.  
+	m_pOwner->m_Position -= Dist * d * ratio1;  
+}
+
+
+//-------------------------------------------------------------------------
+//	first triangle our movement hits this step. move up to it and bounce
+//	off so the rest of the step cant take us through it
+//-------------------------------------------------------------------------
+void GPhysicsSphere::DoSweptCollision(float3& From, float3& Dir, float HitTime, float3& HitNormal)
+{
+	//	already bounced away from it off another triangle
+	if ( AccumulatedMovement().DotProduct( HitNormal ) >= 0.f )
+		return;
+
+	//	From is our sphere's position, not our owner's
+	m_pOwner->m_Position = From - m_SphereOffset + Dir * HitTime;
+
+	float3 Dist( HitNormal * -1.f );
+	BounceOffWall( Dir, Dist, HitNormal );
+
+	//	a soft bounce can leave some movement into the triangle, remove it
+	float VdotN = m_Velocity.DotProduct( HitNormal );
+	if ( VdotN < 0.f )
+		m_Velocity -= HitNormal * VdotN;
+
+	float FdotN = m_Force.DotProduct( HitNormal );
+	if ( FdotN < 0.f )
+		m_Force -= HitNormal * FdotN;
+}
+
+
+//-------------------------------------------------------------------------
+//	collide with a static surface as if it were a physics object moving
+//	with our reflected movement
+//-------------------------------------------------------------------------
+void GPhysicsSphere::BounceOffWall(float3& Dir, float3& Dist, float3& WallNormal)
+{
 	float3 FloorReflectedDir = Dir;
-	FloorReflectedDir.Reflect( TriangleNormal );
+	FloorReflectedDir.Reflect( WallNormal );
 	float3 FloorReflectedVelocity = m_Velocity;
-	FloorReflectedVelocity.Reflect( TriangleNormal );
+	FloorReflectedVelocity.Reflect( WallNormal );
 
 	//	need a physics object to collide with
 	GPhysicsObject WallPhysicsObject;
@@ -530,23 +797,13 @@ void GPhysicsSphere::DoIntersection(float3& From, float3& Dir, float3& MeshPos,
 		DoCollision( &WallPhysicsObject, Dist, VdotN );
 	}      
 
-	float     d  = Dist.Length() - n;
-
-	// relative amount of displacement to make the ball touch         
-	float ratio1 = (WallPhysicsObject.m_Mass) / (m_Mass + WallPhysicsObject.m_Mass);   
-	float ratio2 = 1.0f - ratio1;    
-
-	// move the balls to theire ideal positon.  
-	m_pOwner->m_Position -= Dist * d * ratio1;  
-
-	
 	if ( m_LastFloorNormal.LengthSq() == 0.f )
 	{
-		m_LastFloorNormal = TriangleNormal;
+		m_LastFloorNormal = WallNormal;
 	}
 	else
 	{
-		m_LastFloorNormal += TriangleNormal;
+		m_LastFloorNormal += WallNormal;
 		m_LastFloorNormal.Normalise();
 	}
 
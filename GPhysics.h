@@ -30,6 +30,7 @@ namespace GPhysicsFlags
 	const u32	StickToFloor	= 1<<1;	//	stick to surfaces
 	const u32	DontRotate		= 1<<2;	//	dont imply rotation from physics
 	const u32	NewOwnerPos		= 1<<3;	//	don't use OwnerLastPos
+	const u32	NeverSleep		= 1<<4;	//	always simulate, even when at rest
 };
 
 
@@ -62,6 +63,16 @@ typedef struct
 
 } GCollisionTestTriangle;
 
+//--------------------------------------------------------------------------------------------------------
+// first triangle hit by a swept object
+//--------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	float	Time;		//	along the movement (0..1), more than 1 if nothing has been hit
+	float3	Normal;		//	points away from the triangle
+
+} GSweptHit;
+
 
 
 //-------------------------------------------------------------------------
@@ -69,6 +80,12 @@ typedef struct
 //-------------------------------------------------------------------------
 class GPhysicsObject
 {
+public:
+	static float		g_StepDelta;			//	seconds in the physics step being processed, set by the world
+	static Bool			g_AllowSleep;			//	let objects at rest sleep
+	static float		g_SleepSpeed;			//	objects moving slower than this (units per second) are settling
+	static int			g_SleepSteps;			//	steps an object has to settle for before it can sleep
+
 public:
 	float3				m_Velocity;
 	float3				m_Force;
@@ -81,9 +98,15 @@ public:
 	u32					m_PhysicsFlags;			//	GPhysicsFlags
 	GList<GMeshTestRef>	m_CollisionTestCases;
 	float3				m_DeltaMovement;		//	non-physics movement
+	int					m_BroadphaseID;			//	id in the world's broadphase (index in world's object list)
+	GList<GPhysicsObject*>	m_Contacts;			//	objects we're touching this collision iteration, in world order
+	Bool				m_Sleeping;				//	at rest, skipped by the physics step until woken
+	int					m_SettleSteps;			//	steps we've been moving slower than g_SleepSpeed
+	float3				m_SleepPosition;		//	owner's position when we went to sleep, moving the owner wakes us
 
 private:
 	float3				m_GravityForce;			//	gravity force applied this frame
+	GList<int>			m_MeshTestTriangles;	//	triangles returned from mesh BVH queries (kept to save reallocating)
 
 public:
 	GPhysicsObject();
@@ -92,18 +115,30 @@ public:
 	virtual void	PreUpdate(GWorld* pWorld);	//	before collisions are processed
 	virtual void	PostUpdate(GWorld* pWorld);	//	after collisions are handled
 	void			ProcessCollision(GWorld& World);
-	void			CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& From, float3& To);
+	void			CheckMeshCollision(GMesh* pMesh, float3& MeshPos, float3& From, float3& To, int2* pBVHTests=NULL, GSweptHit* pSweptHit=NULL);	//	pBVHTests collects the mesh hierarchy's node and triangle tests instead of the stats, for worker threads. pSweptHit finds the first hit instead of colliding
 	virtual void	DoIntersection(float3& From, float3& Dir, float3& MeshPos, GPlane& TrianglePlane, float3& TriangleNormal, float3& TriangleV1, float3& TriangleV2, float3& TriangleV3);
 	virtual void	DoCollision(GPhysicsObject* pObject, float3& Dist, float VdotN);
+	virtual Bool	SweptCollision()		{	return FALSE;	};		//	also find the first triangle our movement hits in all the meshes, so fast objects cant pass through
+	virtual void	DoSweptCollision(float3& From, float3& Dir, float HitTime, float3& HitNormal)	{	};	//	first triangle hit moving from From (our position before any collisions), HitTime is along Dir (0..1) and HitNormal points away from the triangle
 	virtual int		CollisionIterations()	{	return 1;	};
+	virtual float	CollisionRadius()		{	return 0.f;	};		//	how far from our position we can touch mesh triangles
 	virtual void	PostIteration()			{	};			//	called after each map collision iteration
-	static void		ProcessCollision(GPhysicsObject* pObjA, GPhysicsObject* pObjB);
+	static Bool		ProcessCollision(GPhysicsObject* pObjA, GPhysicsObject* pObjB);	//	returns if the objects were moving together and have bounced
+
+	void			ApplyImpulse(const float3& Impulse);	//	change velocity by Impulse/mass and wake up
+	void			Sleep();								//	stop moving and stop being simulated
+	inline void		Wake()					{	m_Sleeping = FALSE;	m_SettleSteps = 0;	};
+	inline Bool		IsSleeping() const		{	return m_Sleeping;	};
+	Bool			CheckWake();							//	wake up if we've been moved or given force/movement while sleeping. returns if we're awake
+	void			UpdateSettle(float3& StepFromPosition);	//	count how long we've been at rest, after the step's post update
+	inline Bool		IsSettled() const		{	return m_SettleSteps >= g_SleepSteps && g_AllowSleep && !( m_PhysicsFlags & GPhysicsFlags::NeverSleep );	};
 	virtual float3	GetPosition()			{	return m_pOwner ? m_pOwner->m_Position : float3(0,0,0);	};	//	return base position of physics
 	virtual float3	AccumulatedMovement()	{	return m_Velocity + m_Force + m_DeltaMovement;	};
 	virtual Bool	PreDraw(GMesh* pMesh, GDrawInfo& DrawInfo)		{	return TRUE;	};	//	drawing routine for physics, called just before gameobject is draw, return FALSE to cancel game object draw
 
 private:
 	void			CheckTriangleCollision(float3& MeshPos, GPlane& Plane, float3& v1, float3& v2, float3& v3, float3& From, float3& Dir );
+	void			SweepTriangle(float3& From, float3& Dir, float Radius, GPlane& Plane, float3& v1, float3& v2, float3& v3, GSweptHit& FirstHit);
 };
 
 
@@ -118,6 +153,7 @@ public:
 	float3			m_SphereOffset;		//	offset position from parent
 	float3			m_LastRollAxis;		//	store last roll axis
 	float			m_LastRoll;			//	continue roll
+	Bool			m_ContinuousCollision;	//	sweep our movement against mesh triangles
 
 public:
 	GPhysicsSphere();
@@ -125,8 +161,14 @@ public:
 	
 	virtual void	PostUpdate(GWorld* pWorld);	//	after collisions are handled
 	virtual void	DoIntersection(float3& From, float3& Dir, float3& MeshPos, GPlane& TrianglePlane, float3& TriangleNormal, float3& TriangleV1, float3& TriangleV2, float3& TriangleV3);
+	virtual Bool	SweptCollision()		{	return m_ContinuousCollision;	};
+	virtual void	DoSweptCollision(float3& From, float3& Dir, float HitTime, float3& HitNormal);
 	virtual float3	GetPosition()			{	return m_pOwner ? m_pOwner->m_Position+m_SphereOffset : m_SphereOffset;	};	//	return base position of physics
+	virtual float	CollisionRadius()		{	return m_SphereRadius;	};
 	virtual Bool	PreDraw(GMesh* pMesh, GDrawInfo& DrawInfo);
+
+protected:
+	void			BounceOffWall(float3& Dir, float3& Dist, float3& WallNormal);	//	bounce off a static surface, Dist is the unit direction from us to the surface
 };
 
 
@@ -134,6 +176,7 @@ public:
 
 //	Declarations
 //------------------------------------------------
+Bool	SweptSphereTriangle(float3& From, float3& Dir, float Radius, float3& v0, float3& v1, float3& v2, GPlane& Plane, float& HitTime, float3& HitNormal);	//	first time (0..1 along Dir) a sphere moving towards the front of the triangle touches it. FALSE if it doesnt, or already does
 
 
 //	Inline Definitions
@@ -0,0 +1,123 @@
+/*------------------------------------------------
+
+  GPoseCache.cpp
+
+	evaluated anim poses and bone palettes for this frame, so skin
+	shaders at the same point in the same anims can share them
+
+-------------------------------------------------*/
+
+
+//	Includes
+//------------------------------------------------
+#include "GPoseCache.h"
+#include "GDebug.h"
+
+
+//	globals
+//------------------------------------------------
+
+
+//	Definitions
+//------------------------------------------------
+
+
+GPoseCache::GPoseCache()
+{
+	m_Used = 0;
+	for ( int b=0;	b<POSECACHE_BUCKETS;	b++ )
+		m_Buckets[b] = -1;
+}
+
+
+GPoseCache::~GPoseCache()
+{
+	DeleteAll();
+}
+
+
+void GPoseCache::Empty()
+{
+	m_Used = 0;
+	for ( int b=0;	b<POSECACHE_BUCKETS;	b++ )
+		m_Buckets[b] = -1;
+}
+
+
+void GPoseCache::DeleteAll()
+{
+	for ( int i=0;	i<m_Entries.Size();	i++ )
+		GDelete( m_Entries[i] );
+
+	m_Entries.Empty();
+	Empty();
+}
+
+
+GPoseCacheEntry* GPoseCache::Find(const GPoseCacheKey& Key)
+{
+	int Index = m_Buckets[ Hash( Key ) ];
+	while ( Index != -1 )
+	{
+		GPoseCacheEntry* pEntry = m_Entries[Index];
+		if ( KeysMatch( pEntry->m_Key, Key ) )
+			return pEntry;
+
+		Index = pEntry->m_Next;
+	}
+
+	return NULL;
+}
+
+
+GPoseCacheEntry* GPoseCache::Add(const GPoseCacheKey& Key)
+{
+	//	need another entry
+	if ( m_Used == m_Entries.Size() )
+		m_Entries.Add( new GPoseCacheEntry );
+
+	int Index = m_Used++;
+	GPoseCacheEntry* pEntry = m_Entries[Index];
+	pEntry->m_Key = Key;
+
+	//	add to the front of its bucket
+	u32 Bucket = Hash( Key );
+	pEntry->m_Next = m_Buckets[Bucket];
+	m_Buckets[Bucket] = Index;
+
+	return pEntry;
+}
+
+
+u32 GPoseCache::Hash(const GPoseCacheKey& Key)
+{
+	//	adding zero makes -0 into 0, which compare as equal
+	float Floats[3] = { Key.Frame + 0.f, Key.BlendFrame + 0.f, Key.BlendAmount + 0.f };
+	u32 Frame, BlendFrame, BlendAmount;
+	memcpy( &Frame, &Floats[0], sizeof(u32) );
+	memcpy( &BlendFrame, &Floats[1], sizeof(u32) );
+	memcpy( &BlendAmount, &Floats[2], sizeof(u32) );
+
+	u32 Hash = Key.Anim;
+	Hash = Hash * 31 + Frame;
+	Hash = Hash * 31 + Key.BlendAnim;
+	Hash = Hash * 31 + BlendFrame;
+	Hash = Hash * 31 + BlendAmount;
+	Hash = Hash * 31 + Key.Skeleton;
+	Hash ^= Hash >> 16;
+
+	return Hash & (POSECACHE_BUCKETS-1);
+}
+
+
+Bool GPoseCache::KeysMatch(const GPoseCacheKey& a, const GPoseCacheKey& b)
+{
+	return	a.Anim == b.Anim &&
+			a.Frame == b.Frame &&
+			a.BlendAnim == b.BlendAnim &&
+			a.BlendFrame == b.BlendFrame &&
+			a.BlendAmount == b.BlendAmount &&
+			a.Skeleton == b.Skeleton;
+}
+
+
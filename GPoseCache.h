@@ -0,0 +1,101 @@
+/*------------------------------------------------
+
+  GPoseCache Header file
+
+	evaluated anim poses and bone palettes for this frame, so skin
+	shaders at the same point in the same anims can share them
+
+-------------------------------------------------*/
+
+#ifndef __GPOSECACHE__H_
+#define __GPOSECACHE__H_
+
+
+
+//	Includes
+//------------------------------------------------
+#include "GMain.h"
+#include "GList.h"
+#include "GSkeleton.h"
+
+
+
+//	Macros
+//------------------------------------------------
+#define POSECACHE_BUCKETS		256		//	must be a power of 2
+
+
+
+//	Types
+//------------------------------------------------
+
+//-------------------------------------------------------------------------
+//	everything a shader's pose depends on (with no modified rotations)
+//-------------------------------------------------------------------------
+typedef struct
+{
+	GAssetRef		Skeleton;
+	GAssetRef		Anim;
+	float			Frame;
+	GAssetRef		BlendAnim;		//	GAssetRef_Invalid when not blending
+	float			BlendFrame;
+	float			BlendAmount;
+
+} GPoseCacheKey;
+
+
+class GPoseCacheEntry
+{
+public:
+	GPoseCacheKey		m_Key;
+	GAnimPose			m_Pose;
+	GBoneMask			m_ValidRotations;
+	float3				m_ExtractedMovement;
+	GList<GMatrix>		m_BoneFinal;
+	int					m_Next;					//	next entry in the same bucket, -1 for none
+};
+
+
+//-------------------------------------------------------------------------
+//	entries are kept allocated when the cache is emptied so their lists
+//	don't need reallocating every frame. not thread safe, shaders use it
+//	in Update which is called on the main thread
+//-------------------------------------------------------------------------
+class GPoseCache
+{
+protected:
+	GList<GPoseCacheEntry*>	m_Entries;
+	int						m_Used;						//	entries in use this frame
+	int						m_Buckets[POSECACHE_BUCKETS];	//	first entry for each hash, -1 for none
+
+public:
+	GPoseCache();
+	~GPoseCache();
+
+	void					Empty();							//	forget all entries, eg. at the start of a frame
+	void					DeleteAll();						//	free all entries
+
+	GPoseCacheEntry*		Find(const GPoseCacheKey& Key);
+	GPoseCacheEntry*		Add(const GPoseCacheKey& Key);		//	new entry for the caller to fill in
+	inline int				Size()								{	return m_Used;	};
+
+protected:
+	static u32				Hash(const GPoseCacheKey& Key);
+	static Bool				KeysMatch(const GPoseCacheKey& a, const GPoseCacheKey& b);
+};
+
+
+
+//	Declarations
+//------------------------------------------------
+
+
+
+//	Inline Definitions
+//-------------------------------------------------
+
+
+
+
+#endif
+
@@ -84,6 +84,9 @@ public:
 	//	game specific shader functions
 	virtual Bool		GetVertexProgram(GString& String)=0;	//	fill the string with the program code
 	virtual void		Update()								{	};					//	
+	virtual Bool		PrepareBatchUpdate()					{	return FALSE;	};	//	called on the main thread after Update(). return TRUE to have BatchUpdate() called
+	virtual void		BatchUpdate()							{	};					//	per-frame heavy work, run on worker threads at the same time as other shaders' batch updates. must only modify this shader
+	virtual GBounds*	GetBounds()								{	return NULL;	};	//	bounds (relative to the object, before rotation) if this shader moves the vertexes, NULL to use the mesh's. main thread only
 
 	virtual Bool		HardwareVersion()						{	return FALSE;	};	//	does this have a hardware shader
 	virtual Bool		HardwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3>*& pVertexBuffer, GList<float3>*& NormalBuffer, GList<float2>*& pTextureUVBuffer, GList<float2>*& pTextureUV2Buffer, GList<float3>*& pColourBuffer)=0;	//	do pre-render stuff
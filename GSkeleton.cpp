@@ -16,6 +16,7 @@
 #include "GMesh.h"
 #include "GAssetList.h"
 #include "GBinaryData.h"
+#include "GAnimCompressed.h"
 
 
 //	globals
@@ -23,7 +24,9 @@
 float3			GSkeleton::g_DebugColour =			float4( 1.0f, 0.5f, 0.0f, 1.f );	//	orange
 float3			GSkeleton::g_DebugHighlightColour =	float4( 1.0f, 1.0f, 0.0f, 1.f );	//	yellow
 const u32		GSkeleton::g_Version		= 0x11110002;
-const u32		GSkeletonAnim::g_Version	= 0x11220003;
+const u32		GSkeletonAnim::g_Version	= 0x11220004;
+const u32		GSkeletonAnim::g_VersionMatrixKeyframes	= 0x11220003;
+const u32		GSkeletonAnim::g_VersionCompressed		= 0x11220005;
 const float		g_BoneDebugRad = 0.1f;
 #define			FRAME_SNAP	NEAR_ZERO	//	if we're this close to a start or end keyframe, jump to that keyframe rather than interpolating between
 
@@ -44,43 +47,89 @@ inline Bool CompareIsLess(GAnimKeyFrame*& a, GAnimKeyFrame*& b)
 
 
 //-------------------------------------------------------------------------
-//	blend these rotations with the rotations passed in
+//	resize the pose, new bones are identity
 //-------------------------------------------------------------------------
-GRotationBlendResult GMatrixRotations::Blend(GMatrixRotations& BlendRotations, float BlendInterp)
+void GAnimPose::Resize(int BoneCount)
+{
+	int OldCount = Size();
+
+	m_Rotations.Resize( BoneCount );
+	m_Translations.Resize( BoneCount );
+
+	for ( int b=OldCount;	b<BoneCount;	b++ )
+	{
+		m_Rotations[b].SetIdentity();
+		m_Translations[b] = float3( 0, 0, 0 );
+	}
+}
+
+
+void GAnimPose::SetAllIdentity()
+{
+	m_Rotations.SetAll( GQuaternion() );
+	m_Translations.SetAll( float3( 0, 0, 0 ) );
+}
+
+
+void GAnimPose::Copy(const GAnimPose& Pose)
+{
+	m_Rotations.Copy( Pose.m_Rotations );
+	m_Translations.Copy( Pose.m_Translations );
+}
+
+
+//-------------------------------------------------------------------------
+//	set a bone from a matrix (eg. from older data). any scale is lost
+//-------------------------------------------------------------------------
+void GAnimPose::SetBoneMatrix(int Bone, const GMatrix& Matrix)
+{
+	MatrixToQuaternion( Matrix, m_Rotations[Bone] );
+	m_Translations[Bone] = float3( Matrix.m_Column[3].x, Matrix.m_Column[3].y, Matrix.m_Column[3].z );
+}
+
+
+void GAnimPose::GetBoneMatrix(int Bone, GMatrix& Matrix) const
+{
+	QuaternionToMatrix( m_Rotations.ElementAtConst(Bone), Matrix );
+	Matrix.SetTranslate( m_Translations.ElementAtConst(Bone) );
+}
+
+
+//-------------------------------------------------------------------------
+//	blend this pose with the pose passed in
+//-------------------------------------------------------------------------
+GRotationBlendResult GAnimPose::Blend(const GAnimPose& BlendPose, float BlendInterp)
 {
 	//	need to be the same size
-	if ( Size() != BlendRotations.Size() )
+	if ( Size() != BlendPose.Size() )
 	{
-		GDebug_Break("Attempting to blend two sets of rotations with differing number of rotations\n");
+		GDebug_Break("Attempting to blend two poses with differing number of bones\n");
 		return GRotationBlendResult_Original;
 	}
 
-	//	interp is very low, just use current rotations
+	//	interp is very low, just use current pose
 	if ( BlendInterp < NEAR_ZERO )
 	{
 		return GRotationBlendResult_Original;
 	}
 
-	//	interp is very high, just use new rotations
+	//	interp is very high, just use new pose
 	if ( BlendInterp > 1.f - NEAR_ZERO )
 	{
-		Copy( BlendRotations );
+		Copy( BlendPose );
 		return GRotationBlendResult_New;
 	}
 
-	//	convert rotations to quaternions, and slerp between them
+	//	slerp rotations and lerp translations
+	GQuaternion* pRotations = m_Rotations.Data();
+	const GQuaternion* pBlendRotations = BlendPose.m_Rotations.DataConst();
 	for ( int r=0;	r<Size();	r++ )
-	{
-		GQuaternion QStart;
-		GQuaternion QEnd;
-		MatrixToQuaternion( ElementAt(r), QStart );
-		MatrixToQuaternion( BlendRotations[r], QEnd );
-		
-		GQuaternion Rot;
-		Rot = InterpQ( QStart, QEnd, BlendInterp );
+		pRotations[r] = InterpQ( pRotations[r], pBlendRotations[r], BlendInterp );
 
-		ElementAt(r).SetRotation( Rot );
-	}
+	float3* pTranslations = m_Translations.Data();
+	const float3* pBlendTranslations = BlendPose.m_Translations.DataConst();
+	for ( int t=0;	t<Size();	t++ )
+		pTranslations[t] += ( pBlendTranslations[t] - pTranslations[t] ) * BlendInterp;
 
 	return GRotationBlendResult_Merged;
 }
@@ -109,8 +158,8 @@ void GBone::Reset()
 	m_BoneRef		= GAssetRef_Invalid;
 	m_BoneCount		= -1;
 	m_Index			= -1;
-	m_ParentBones	= 0xffffffff;
-	m_ChildBones	= 0xffffffff;
+	m_ParentBones.SetAll();
+	m_ChildBones.SetAll();
 }
 
 //-------------------------------------------------------------------------
@@ -309,7 +358,7 @@ GBone* GBone::AddBone(GBone* pBone)
 	}
 	
 	//	check if we have all our bones already
-	if ( m_pSkeleton->BoneCount() == MAX_BONES )
+	if ( m_pSkeleton->BoneCount() >= MAX_BONES )
 	{
 		GDebug::Print("Failed to add bone to skeleton, already at max number of bones (%d)\n", MAX_BONES );
 		return NULL;
@@ -508,6 +557,8 @@ void GBone::MoveOffset(float3& Change)
 
 	//	reinitialise matrixes
 	InitBoneMatrix();
+	if ( m_pSkeleton )
+		m_pSkeleton->InvalidateFlatBones();
 }
 
 
@@ -518,6 +569,8 @@ void GBone::SetOffset(float3& Offset)
 
 	//	reinitialise matrixes
 	InitBoneMatrix();
+	if ( m_pSkeleton )
+		m_pSkeleton->InvalidateFlatBones();
 }
 
 	
@@ -647,96 +700,20 @@ void GBone::InitBoneMatrix()
 
 
 
-void GBone::GetBoneTransform(GList<GMatrix>& BoneFinal, int& BoneIndex, int ParentIndex, GList<GMatrix>& MainRotations, GList<GMatrix>* pModifiedRotations, u32& BonesNeedUpdating, Bool Recurse, const u32& ValidAnimRotations, const u32& ValidModifiedRotations )
-{
-	//	no more bones need updating
-	if ( !BonesNeedUpdating )
-		return;
-
-	//	does this bone need updating?
-	if ( BonesNeedUpdating & (1<<BoneIndex) )
-	{
-		GMatrix& Final = BoneFinal[BoneIndex];
-
-		//	anim, intially same as absolute
-		//Final = m_Absolute;
-
-		u32 AnimMatrixValid = ValidAnimRotations & (1<<BoneIndex);
-		u32 ModifiedMatrixValid = ValidModifiedRotations & (1<<BoneIndex);
-		if ( ! pModifiedRotations )
-			ModifiedMatrixValid = 0x0;
-
-		//	only apply if both matrixes are valid
-		if ( AnimMatrixValid || ModifiedMatrixValid )
-		{
-			//	animated final transformation. transform is already interpolated
-			GMatrix Transform;
-
-			if ( AnimMatrixValid )
-				Transform = MainRotations[BoneIndex];
-			else
-				Transform.SetIdentity();
-
-			if ( ModifiedMatrixValid )
-				Transform *= pModifiedRotations->ElementAt(BoneIndex);
-
-			//	calc final this-frame matrix
-			GMatrix RelativeFinal( m_Relative );
-			RelativeFinal *= Transform;	//	postmultiply
-
-			if ( ParentIndex == -1 )
-			{
-				Final = RelativeFinal;
-			}
-			else
-			{
-				Final = BoneFinal[ParentIndex];
-				Final *= RelativeFinal;
-			}
-		}
-		else
-		{
-			Final = m_Relative;
-		}
-
-		//	this bone doesnt need updating
-		BonesNeedUpdating &= ~(1<<BoneIndex);
-	}
-
-	//	increase index
-	int ThisBoneIndex = BoneIndex;
-	BoneIndex++;
-
-	//	recurse through children
-	if ( Recurse )
-	{
-		for ( int c=0;	c<m_Children.Size();	c++ )
-		{
-			//	no more bones need updating
-			if ( !BonesNeedUpdating )
-				return;
-			
-			//	recurse
-			m_Children[c]->GetBoneTransform( BoneFinal, BoneIndex, ThisBoneIndex, MainRotations, pModifiedRotations, BonesNeedUpdating, Recurse, ValidAnimRotations, ValidModifiedRotations );
-		}
-	}
-
-}
-
-
 //-------------------------------------------------------------------------
 //	recursive function to setup bones' parent bones bitmask
 //-------------------------------------------------------------------------
-void GBone::SetParentBoneMask(u32 CurrentParentBoneMask)
+void GBone::SetParentBoneMask(const GBoneMask& CurrentParentBoneMask)
 {
 	//	set this bone's parent bone mask to the current mask being passed down
 	m_ParentBones = CurrentParentBoneMask;
 
 	//	add our index to the mask and set children's parent bone mask
-	CurrentParentBoneMask |= 1<<GetIndex();
+	GBoneMask ChildParentBoneMask( CurrentParentBoneMask );
+	ChildParentBoneMask.Set( GetIndex() );
 
 	for ( int c=0;	c<m_Children.Size();	c++ )
-		m_Children[c]->SetParentBoneMask( CurrentParentBoneMask );
+		m_Children[c]->SetParentBoneMask( ChildParentBoneMask );
 }
 
 
@@ -745,14 +722,14 @@ void GBone::SetParentBoneMask(u32 CurrentParentBoneMask)
 //-------------------------------------------------------------------------
 void GBone::UpdateChildBoneMask()
 {
-	int ThisIndexBit = 1<<GetIndex();
+	int ThisIndex = GetIndex();
 
 	//	go through all the parents of this bone
 	GBone* pParentBone = ParentBone();
 	while ( pParentBone )
 	{
 		//	add this as a child of this parent
-		pParentBone->m_ChildBones |= ThisIndexBit;
+		pParentBone->m_ChildBones.Set( ThisIndex );
 
 		//	next parent up
 		pParentBone = pParentBone->ParentBone();
@@ -766,6 +743,7 @@ GSkeleton::GSkeleton()
 {
 	//	set root bone's skeleton owner
 	m_RootBone.m_pSkeleton = this;
+	m_FlatBonesValid = FALSE;
 }
 
 
@@ -906,6 +884,8 @@ Bool GSkeleton::DeleteBone(GAssetRef BoneRef)
 		return FALSE;
 	}
 
+	InvalidateFlatBones();
+
 	return pBone->m_pParent->DeleteBone( pBone );
 }
 
@@ -1006,48 +986,116 @@ void GSkeleton::GetBonePositions( GList<float3>& BonePositions )
 }
 
 //-------------------------------------------------------------------------
-//	
+//	calc final matrixes for bones that need updating. bones are in depth
+//	first order so one pass forward through them always has a bone's
+//	parent done before the bone
 //-------------------------------------------------------------------------
-void GSkeleton::GetBoneTransform(GList<GMatrix>& BoneFinal, GList<GMatrix>& MainRotations, GList<GMatrix>* pModifiedRotations, u32 BonesNeedUpdating, const u32& ValidAnimRotations, const u32& ValidModifiedRotations )
+void GSkeleton::GetBoneTransform(GList<GMatrix>& BoneFinal, const GAnimPose& AnimPose, GList<GMatrix>* pModifiedRotations, const GBoneMask& BonesNeedUpdating, const GBoneMask& ValidAnimRotations, const GBoneMask& ValidModifiedRotations )
 {
-	//#define RECURSE_THROUGH_BONES	//	if defined, we process the bones recursivly, otherwise through the list
-
 	int BoneSize = BoneCount();
-	int BoneIndex = 0;
 	BoneFinal.Resize( BoneSize );
 
-	#ifdef RECURSE_THROUGH_BONES
-	{
-		//	recurse through bones
-		m_RootBone.GetBoneTransform( BoneFinal, BoneIndex, -1, MainRotations, pModifiedRotations, BonesNeedUpdating, TRUE );
-	}
-	#else
+	if ( !m_FlatBonesValid )
+		RebuildFlatBones();
+
+	//	nothing after the last bone that needs updating has to be looked at
+	int LastBone = BonesNeedUpdating.LastSet();
+	if ( LastBone >= BoneSize )
+		LastBone = BoneSize-1;
+
+	const int* pParents = m_BoneParents.Data();
+	const GMatrix* pRelative = m_BoneRelative.Data();
+	GMatrix* pFinal = BoneFinal.Data();
+	GMatrix AnimMatrix;
+	GMatrix AnimLocal;
+	GMatrix ModifiedLocal;
+
+	for ( int b=0;	b<=LastBone;	b++ )
 	{
-		//	run through bone list
-		for ( int b=0;	b<BoneSize;	b++ )
+		if ( !BonesNeedUpdating.IsSet(b) )
+			continue;
+
+		Bool AnimValid = ( b < AnimPose.Size() ) && ValidAnimRotations.IsSet(b);
+		Bool ModifiedValid = pModifiedRotations && ValidModifiedRotations.IsSet(b);
+
+		//	no animation or modification, just use the relative matrix
+		if ( !AnimValid && !ModifiedValid )
 		{
-			if ( BonesNeedUpdating & (1<<b) )
-			{
-				GBone* pBone = GetBoneIndex(b);
-				BoneIndex = b;
-				pBone->GetBoneTransform( BoneFinal, BoneIndex, pBone->GetParentIndex(), MainRotations, pModifiedRotations, BonesNeedUpdating, FALSE, ValidAnimRotations, ValidModifiedRotations );
+			pFinal[b] = pRelative[b];
+			continue;
+		}
 
-				//	this bone doesnt need updating anymore
-				BonesNeedUpdating &= ~(1<<b);
+		//	local = relative * anim rotation * modified rotation (postmultiply)
+		const GMatrix* pLocal = &pRelative[b];
+		if ( AnimValid )
+		{
+			AnimPose.GetBoneMatrix( b, AnimMatrix );
+			AnimLocal.SetMultiply( *pLocal, AnimMatrix );
+			pLocal = &AnimLocal;
+		}
 
-				if ( BonesNeedUpdating == 0x0 )
-					break;
-			}
+		if ( ModifiedValid )
+		{
+			ModifiedLocal.SetMultiply( *pLocal, pModifiedRotations->ElementAt(b) );
+			pLocal = &ModifiedLocal;
 		}
 
+		//	final = parent final * local
+		if ( pParents[b] == -1 )
+			pFinal[b] = *pLocal;
+		else
+			pFinal[b].SetMultiply( pFinal[ pParents[b] ], *pLocal );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	GetBoneTransform builds the bone count and flattened bones the first
+//	time it needs them, do that now so it doesnt modify the skeleton
+//-------------------------------------------------------------------------
+void GSkeleton::PrepareForThreads()
+{
+	BoneCount();
+
+	if ( !m_FlatBonesValid )
+		RebuildFlatBones();
+}
+
+
+//-------------------------------------------------------------------------
+//	flatten the bone tree into parent indexes and relative matrixes
+//-------------------------------------------------------------------------
+void GSkeleton::RebuildFlatBones()
+{
+	int BoneSize = BoneCount();
+	if ( m_BonePtrList.Size() != BoneSize )
+		RebuildBonePtrList();
+
+	m_BoneParents.Resize( BoneSize );
+	m_BoneRelative.Resize( BoneSize );
+
+	for ( int b=0;	b<BoneSize;	b++ )
+	{
+		GBone* pBone = m_BonePtrList[b];
+		m_BoneParents[b] = pBone->GetParentIndex();
+		m_BoneRelative[b] = pBone->m_Relative;
+
+		//	forward pass relies on parents being before children
+		if ( m_BoneParents[b] >= b )
+		{
+			GDebug_Break("Bone %d's parent (%d) is not before it in the skeleton\n", b, m_BoneParents[b] );
+			m_BoneParents[b] = -1;
+		}
 	}
-	#endif
+
+	m_FlatBonesValid = TRUE;
 }
 
 
 void GSkeleton::InitBoneMatrixes()
 {
 	m_RootBone.InitBoneMatrix();
+	InvalidateFlatBones();
 }
 
 
@@ -1061,6 +1109,7 @@ void GSkeleton::RebuildBonePtrList()
 
 	m_BonePtrList.Empty();
 	m_BonePtrList.Resize( BoneCount() );
+	InvalidateFlatBones();
 
 	for ( i=0;	i<BoneCount();	i++ )
 	{
@@ -1076,7 +1125,7 @@ void GSkeleton::RebuildBonePtrList()
 
 	//	need to reset all the child bone masks before updating them
 	for ( i=0;	i<BoneCount();	i++ )
-		m_BonePtrList[i]->m_ChildBones = 0x0;
+		m_BonePtrList[i]->m_ChildBones.Empty();
 
 	//	update the child masks
 	for ( i=0;	i<BoneCount();	i++ )
@@ -1089,6 +1138,9 @@ GSkeletonAnim::GSkeletonAnim()
 {
 	m_SkinRef	= GAssetRef_Invalid;
 	m_BoneCount		= 0;
+	m_SaveCompressed	= FALSE;
+	m_CompressRotationTolerance		= ANIMCOMPRESSED_DEFAULT_ROTATION_TOLERANCE;
+	m_CompressTranslationTolerance	= ANIMCOMPRESSED_DEFAULT_TRANSLATION_TOLERANCE;
 
 	//	first frame frame number is always zero
 	m_FirstFrame.m_FrameNumber = 0.f;
@@ -1102,7 +1154,7 @@ GSkeletonAnim::~GSkeletonAnim()
 
 Bool GSkeletonAnim::Load(GBinaryData& Data)
 {
-	int i,b;
+	int i;
 	//#define CHECK_SIZE(size,err)	{	if ( DataSize < size )	{	GDebug_Break(err);	return FALSE;	}	}
 	//#define UPDATE_READ(size)		{	pData += size;	DataSize -= size;	DataRead += size;	}
 	//#define READ(dest,size,err)		{	CHECK_SIZE(size,err);	memcpy( dest, pData, size );	UPDATE_READ( size );	}
@@ -1117,16 +1169,30 @@ Bool GSkeletonAnim::Load(GBinaryData& Data)
 	//	alloc data for bones
 	SetBoneCount( Header.BoneCount );
 
-	//	read base keyframe
-	for ( b=0;	b<Header.BoneCount;	b++ )
+	//	compressed tracks are decoded into keyframes, and saved compressed again
+	m_SaveCompressed = ( m_LoadVersion == GSkeletonAnim::g_VersionCompressed );
+	if ( m_SaveCompressed )
 	{
-		//READ( &m_FirstFrame[b], GDataSizeOf(GMatrix), "Failed to read matrix in first frame" );
-		if ( !Data.Read( &m_FirstFrame[b], GDataSizeOf(GMatrix), "Skeleton anim root keyframe rotation" ) )
+		GAnimCompressed Compressed;
+		if ( !Compressed.Load( Data, m_BoneCount, Header.KeyFrames ) )
 			return FALSE;
+
+		m_CompressRotationTolerance		= Compressed.RotationTolerance();
+		m_CompressTranslationTolerance	= Compressed.TranslationTolerance();
+
+		return Compressed.Decompress( *this );
 	}
 
+	//	older anims stored a matrix for each bone
+	Bool MatrixKeyframes = ( m_LoadVersion == GSkeletonAnim::g_VersionMatrixKeyframes );
+
+	//	read base keyframe
+	if ( !LoadPose( Data, m_FirstFrame, MatrixKeyframes ) )
+		return FALSE;
+
 	//	delete any current keyframes
 	m_Keyframes.DeleteAll();
+	UpdateKeyframeNumbers();
 
 	//	alloc one by one
 	for ( i=0;	i<Header.KeyFrames;	i++ )
@@ -1144,15 +1210,13 @@ Bool GSkeletonAnim::Load(GBinaryData& Data)
 
 		//	copy header data to frame
 		pKeyframe->m_RootOffset = KeyframeHeader.RootOffset;
-		pKeyframe->m_ValidRotMask = KeyframeHeader.ValidRotMask;
 
-		//	copy in matrixes
-		for ( b=0;	b<m_BoneCount;	b++ )
-		{
-			//READ( &pKeyframe->ElementAt(b), GDataSizeOf(GMatrix),  "Failed to read quaternion in keyframe" );
-			if ( !Data.Read( &pKeyframe->ElementAt(b), GDataSizeOf(GMatrix), "Skeleton anim keyframe matrix" ) )
-				return FALSE;
-		}
+		//	copy in rotations
+		if ( !LoadPose( Data, *pKeyframe, MatrixKeyframes ) )
+			return FALSE;
+
+		//	the header's mask only has room for 32 bones so work it out from the rotations
+		pKeyframe->UpdateValidRotMask();
 	}
 
 //	#undef CHECK_SIZE
@@ -1164,7 +1228,7 @@ Bool GSkeletonAnim::Load(GBinaryData& Data)
 
 Bool GSkeletonAnim::Save(GBinaryData& SaveData)
 {
-	int i,b;
+	int i;
 	
 	//	add header
 	GSkeletonAnimHeader Header;
@@ -1173,12 +1237,17 @@ Bool GSkeletonAnim::Save(GBinaryData& SaveData)
 	Header.SkinRef = m_SkinRef;
 	SaveData.Write( &Header, GDataSizeOf(GSkeletonAnimHeader) );
 
-	//	save base keyframe
-	for ( b=0;	b<m_BoneCount;	b++ )
+	if ( m_SaveCompressed )
 	{
-		SaveData.Write( &m_FirstFrame[b], GDataSizeOf(GMatrix) );
+		GAnimCompressed Compressed;
+		Compressed.Compress( *this, m_CompressRotationTolerance, m_CompressTranslationTolerance );
+		Compressed.Save( SaveData );
+		return TRUE;
 	}
 
+	//	save base keyframe
+	SavePose( SaveData, m_FirstFrame );
+
 	//	save other keyframes
 	for ( i=0;	i<m_Keyframes.Size();	i++ )
 	{
@@ -1186,20 +1255,57 @@ Bool GSkeletonAnim::Save(GBinaryData& SaveData)
 		GSkeletonAnimKeyframeHeader KeyframeHeader;
 		KeyframeHeader.FrameNumber = m_Keyframes[i]->m_FrameNumber;
 		KeyframeHeader.RootOffset = m_Keyframes[i]->m_RootOffset;
-		KeyframeHeader.ValidRotMask = m_Keyframes[i]->m_ValidRotMask;
+		KeyframeHeader.ValidRotMask = m_Keyframes[i]->m_ValidRotMask.GetWord(0);
 
 		SaveData.Write( &KeyframeHeader, GDataSizeOf(GSkeletonAnimKeyframeHeader) );
 
-		//	save each matrix in keyframe
-		for ( b=0;	b<m_BoneCount;	b++ )
+		//	save rotations in keyframe
+		SavePose( SaveData, *m_Keyframes[i] );
+	}
+
+	return TRUE;
+}
+
+
+//-------------------------------------------------------------------------
+//	read m_BoneCount rotations then translations. older data has a matrix
+//	for each bone instead which is converted
+//-------------------------------------------------------------------------
+Bool GSkeletonAnim::LoadPose(GBinaryData& Data, GAnimPose& Pose, Bool MatrixKeyframes)
+{
+	Pose.Resize( m_BoneCount );
+
+	if ( MatrixKeyframes )
+	{
+		GMatrix Matrix;
+		for ( int b=0;	b<m_BoneCount;	b++ )
 		{
-			SaveData.Write( &m_Keyframes[i]->ElementAt(b), GDataSizeOf(GMatrix) );
+			if ( !Data.Read( &Matrix, GDataSizeOf(GMatrix), "Skeleton anim keyframe matrix" ) )
+				return FALSE;
+
+			Pose.SetBoneMatrix( b, Matrix );
 		}
+		return TRUE;
 	}
 
+	if ( !Data.Read( Pose.m_Rotations.Data(), Pose.m_Rotations.DataSize(), "Skeleton anim keyframe rotations" ) )
+		return FALSE;
+
+	if ( !Data.Read( Pose.m_Translations.Data(), Pose.m_Translations.DataSize(), "Skeleton anim keyframe translations" ) )
+		return FALSE;
+
 	return TRUE;
 }
 
+
+void GSkeletonAnim::SavePose(GBinaryData& SaveData, GAnimPose& Pose)
+{
+	Pose.Resize( m_BoneCount );
+
+	SaveData.Write( Pose.m_Rotations.Data(), Pose.m_Rotations.DataSize() );
+	SaveData.Write( Pose.m_Translations.Data(), Pose.m_Translations.DataSize() );
+}
+
 void GSkeletonAnim::SetBoneCount(int BoneCount)
 {
 	//	dont need to change
@@ -1207,7 +1313,7 @@ void GSkeletonAnim::SetBoneCount(int BoneCount)
 		return;
 
 	//	check amount
-	if ( BoneCount >= MAX_BONES )
+	if ( BoneCount > MAX_BONES )
 	{
 		GDebug_Break("Tried to set bone count(%d) on skeleton anim to more than allowed (%d)\n", BoneCount, MAX_BONES );
 	}
@@ -1255,6 +1361,7 @@ GAnimKeyFrame* GSkeletonAnim::AddKeyframe(float Frame)
 
 	//	resort keyframe list
 	m_Keyframes.Sort();
+	UpdateKeyframeNumbers();
 
 	return pKeyframe;
 }
@@ -1275,9 +1382,9 @@ int GSkeletonAnim::GetKeyframeIndexFromFrame(float Frame)
 		return 0;
 
 	//	find index
-	for ( int k=0;	k<m_Keyframes.Size();	k++ )
-		if ( m_Keyframes[k]->m_FrameNumber == Frame )
-			return k+1;
+	int k = FindKeyframeAfter( Frame );
+	if ( k < m_Keyframes.Size() && m_Keyframes[k]->m_FrameNumber == Frame )
+		return k+1;
 
 	//	not found
 	return -1;
@@ -1315,11 +1422,15 @@ Bool GSkeletonAnim::RemoveKeyframeIndex(int Index)
 
 		//	remove frame 1 (which is now the base frame)
 		m_Keyframes.RemoveAt( 0 );
+		UpdateKeyframeNumbers();
 
 		return TRUE;
 	}
 
-	return m_Keyframes.DeleteAt( Index-1 );
+	Bool Removed = m_Keyframes.DeleteAt( Index-1 );
+	UpdateKeyframeNumbers();
+
+	return Removed;
 }
 
 
@@ -1349,7 +1460,8 @@ GAnimKeyFrame* GSkeletonAnim::GetKeyframe(float Frame)
 		return &m_FirstFrame;
 
 	//	find matching keyframe (or very close)
-	for ( int k=0;	k<m_Keyframes.Size();	k++ )
+	int k = FindKeyframeAfter( Frame - FRAME_SNAP );
+	if ( k < m_Keyframes.Size() )
 	{
 		float kframe = m_Keyframes[k]->m_FrameNumber;
 
@@ -1363,28 +1475,88 @@ GAnimKeyFrame* GSkeletonAnim::GetKeyframe(float Frame)
 }
 
 
-void GSkeletonAnim::GetRotations( float Frame, GMatrixRotations& Rotations, u32& ValidRotMask, float PreviousFrame, float3& ExtractedMovement )
+//-------------------------------------------------------------------------
+//	binary search for the first keyframe at or after this frame. if a
+//	cursor is passed, it and the keyframe after it are checked first so
+//	playing forward doesnt have to search at all
+//-------------------------------------------------------------------------
+int GSkeletonAnim::FindKeyframeAfter(float Frame, int* pCursor)
+{
+	//	keyframes have been changed without updating the frame numbers
+	if ( m_KeyframeNumbers.Size() != m_Keyframes.Size() )
+		UpdateKeyframeNumbers();
+
+	const float* pFrames = m_KeyframeNumbers.Data();
+	int Count = m_KeyframeNumbers.Size();
+
+	//	check the cursor is still at the right keyframe, or has moved onto the next one
+	if ( pCursor )
+	{
+		int Index = *pCursor;
+		for ( int Step=0;	Step<2 && Index>=0 && Index<=Count;	Step++, Index++ )
+		{
+			if ( ( Index == 0 || pFrames[Index-1] < Frame ) && ( Index == Count || pFrames[Index] >= Frame ) )
+			{
+				*pCursor = Index;
+				return Index;
+			}
+		}
+	}
+
+	//	binary search
+	int Low = 0;
+	int High = Count;
+	while ( Low < High )
+	{
+		int Mid = ( Low + High ) / 2;
+		if ( pFrames[Mid] < Frame )
+			Low = Mid + 1;
+		else
+			High = Mid;
+	}
+
+	if ( pCursor )
+		*pCursor = Low;
+
+	return Low;
+}
+
+
+void GSkeletonAnim::UpdateKeyframeNumbers()
+{
+	m_KeyframeNumbers.Resize( m_Keyframes.Size() );
+
+	for ( int k=0;	k<m_Keyframes.Size();	k++ )
+		m_KeyframeNumbers[k] = m_Keyframes[k]->m_FrameNumber;
+}
+
+
+void GSkeletonAnim::GetRotations( float Frame, GAnimPose& Pose, GBoneMask& ValidRotMask, float PreviousFrame, float3& ExtractedMovement, int* pCursor )
 {
 	//GDebug::Print("Getting rotations for frame %2.2f\n", Frame );
 	
-	//	find before and after keyframe indexes to base matrixes on
+	//	find before and after keyframe indexes to base matrixes on (0 is the first frame, 1.. are m_Keyframes)
 	int StartKeyframe = 0;
 	int EndKeyframe = 0;
+	int KeyframeAfter = FindKeyframeAfter( Frame, pCursor );
 
-	for ( int i=0;	i<m_Keyframes.Size();	i++ )
+	if ( KeyframeAfter == m_Keyframes.Size() )
 	{
-		//	find the last keyframe BEFORE this frame
-		if ( m_Keyframes[i]->m_FrameNumber <= Frame )
-			StartKeyframe = i+1;
-
-		//	find the first keyframe AFTER our frame
-		if ( m_Keyframes[i]->m_FrameNumber >= Frame )
-		{
-			EndKeyframe = i+1;
-			
-			//	must have found start *and* end
-			break;
-		}
+		//	after the last keyframe
+		StartKeyframe = KeyframeAfter;
+		EndKeyframe = 0;
+	}
+	else if ( m_KeyframeNumbers[KeyframeAfter] == Frame )
+	{
+		//	exactly on a keyframe
+		StartKeyframe = KeyframeAfter+1;
+		EndKeyframe = KeyframeAfter+1;
+	}
+	else
+	{
+		//	between the keyframe before and this one
+		StartKeyframe = KeyframeAfter;
+		EndKeyframe = KeyframeAfter+1;
 	}
 
 	//	grab keyframe
@@ -1396,10 +1568,10 @@ void GSkeletonAnim::GetRotations( float Frame, GMatrixRotations& Rotations, u32&
 	}
 
 	//	get rotations
-	GMatrixRotations& StartRotations = *pStartKeyframe;
+	GAnimPose& StartPose = *pStartKeyframe;
 
 	//	no rotations specified!
-	if ( StartRotations.Size() == 0 )
+	if ( StartPose.Size() == 0 )
 	{
 		//	copy originals
 		pStartKeyframe->SetAllIdentity();
@@ -1408,14 +1580,14 @@ void GSkeletonAnim::GetRotations( float Frame, GMatrixRotations& Rotations, u32&
 	//	start and end keyframes are the same, just copy matrixes if theyre set
 	if ( StartKeyframe == EndKeyframe )
 	{
-		Rotations.Copy( StartRotations );
+		Pose.Copy( StartPose );
 		ValidRotMask = pStartKeyframe->ValidRotMask();
 		return;
 	}
 
 	//	grab keyframe data
 	GAnimKeyFrame* pEndKeyframe = GetKeyframeIndex(EndKeyframe);
-	GMatrixRotations& EndRotations = *pEndKeyframe;
+	GAnimPose& EndPose = *pEndKeyframe;
 
 	//	get interpolation amount between keyframes
 	float FrameLength = pEndKeyframe->m_FrameNumber - pStartKeyframe->m_FrameNumber;
@@ -1429,8 +1601,8 @@ void GSkeletonAnim::GetRotations( float Frame, GMatrixRotations& Rotations, u32&
 	float KeyframeIndexInterpolation = ( Frame - pStartKeyframe->m_FrameNumber) / FrameLength;
 
 	//	blend from start keyframes to end keyframe
-	Rotations.Copy( StartRotations );
-	GRotationBlendResult BlendResult = Rotations.Blend( EndRotations, KeyframeIndexInterpolation );
+	Pose.Copy( StartPose );
+	GRotationBlendResult BlendResult = Pose.Blend( EndPose, KeyframeIndexInterpolation );
 
 	//	update other info depending on how rotations were merged
 	switch ( BlendResult )
@@ -1487,15 +1659,23 @@ Bool GSkeletonAnim::Copy(GSkeletonAnim* pAnim,GAssetRef NewRef)
 		IncrementAssetRef( NewRef );
 	}
 
-	//	copy data, by saving and reloading the data! so simple!
+	//	copy data, by saving and reloading the data! so simple! saved uncompressed so the copy is exact
 	GBinaryData SavedAnim;
-	if ( ! pAnim->Save( SavedAnim ) )
+	Bool SaveCompressed = pAnim->m_SaveCompressed;
+	pAnim->m_SaveCompressed = FALSE;
+	Bool Saved = pAnim->Save( SavedAnim );
+	pAnim->m_SaveCompressed = SaveCompressed;
+	if ( !Saved )
 		return FALSE;
 
 	int DataRead=0;
 	if ( ! Load( SavedAnim ) )
 		return FALSE;
 
+	m_SaveCompressed				= pAnim->m_SaveCompressed;
+	m_CompressRotationTolerance		= pAnim->m_CompressRotationTolerance;
+	m_CompressTranslationTolerance	= pAnim->m_CompressTranslationTolerance;
+
 	SetAssetRef( NewRef );
 
 	return TRUE;
@@ -1504,23 +1684,35 @@ Bool GSkeletonAnim::Copy(GSkeletonAnim* pAnim,GAssetRef NewRef)
 
 
 
+//-------------------------------------------------------------------------
+//	compress the anim as it would be saved and print how much error that
+//	adds to each bone. the anim isn't changed
+//-------------------------------------------------------------------------
+void GSkeletonAnim::ReportCompressionError()
+{
+	GAnimCompressed Compressed;
+	Compressed.Compress( *this, m_CompressRotationTolerance, m_CompressTranslationTolerance );
+	Compressed.ReportError( *this );
+}
+
+
+
+
 GAnimKeyFrame::GAnimKeyFrame()
 {
-	m_ValidRotMask	= 0x0;
 	m_FrameNumber	= 0.f;
 	m_RootOffset	= float3(0,0,0);
 }
 
 void GAnimKeyFrame::UpdateValidRotMask()
 {
-	m_ValidRotMask = 0x0;
+	m_ValidRotMask.Empty();
 
-	for ( int i=0;	i<Size();	i++ )
+	for ( int i=0;	i<Size() && i<MAX_BONES;	i++ )
 	{
-		//if ( ElementAt(i).IsValid() )
-		if ( !ElementAt(i).IsIdentity() )
+		if ( !IsIdentity(i) )
 		{
-			m_ValidRotMask |= 1<<i;
+			m_ValidRotMask.Set(i);
 		}
 	}
 }
@@ -1528,42 +1720,34 @@ void GAnimKeyFrame::UpdateValidRotMask()
 void GAnimKeyFrame::UpdateBoneCount(int BoneCount)
 {
 	int OldCount = Size();
-	Resize( BoneCount );
 
-	//	reset mask length (if now less rotations)
-	m_ValidRotMask &= (1<<BoneCount)-1;
+	//	new rotations are reset to identity
+	Resize( BoneCount );
 
-	//	reset new rotations
-	for ( int i=OldCount;	i<BoneCount;	i++ )
-	{
-		ElementAt(i).SetIdentity();
-		m_ValidRotMask &= ~(1<<i);
-	}
+	//	reset mask length (if now less rotations) and new rotations are identity
+	m_ValidRotMask.ClearFrom( OldCount < BoneCount ? OldCount : BoneCount );
 }
 
 void GAnimKeyFrame::SetAllIdentity()
 {
-	//	reset matrixes
-	for ( int i=0;	i<Size();	i++ )
-	{
-		ElementAt(i).SetIdentity();
-	}
+	//	reset rotations
+	GAnimPose::SetAllIdentity();
 
 	//	update identity mask
-	m_ValidRotMask = 0x0;
+	m_ValidRotMask.Empty();
 }
 
 
 //-------------------------------------------------------------------------
-//	copy frame info and matrixes from the param
+//	copy frame info and pose from the param
 //-------------------------------------------------------------------------
 void GAnimKeyFrame::Copy(GAnimKeyFrame& Keyframe)
 {
 	m_FrameNumber = Keyframe.m_FrameNumber;
 	m_ValidRotMask = Keyframe.m_ValidRotMask;
 
-	//	do inherited list Copy to copy matrixes
-	GList<GMatrix>::Copy( Keyframe );
+	//	do inherited Copy to copy rotations
+	GAnimPose::Copy( Keyframe );
 }
 
 
@@ -23,9 +23,9 @@
 
 //	Macros
 //------------------------------------------------
-//	limited to 32 bones to make use of bitfields
-//	limited to 29 for max shader constants (96 max)
-#define MAX_BONES	29		
+#define MAX_BONES			128		//	bones in a skeleton, GBoneMask has a bit for each. must be a multiple of 32
+#define MAX_HARDWARE_BONES	29		//	limited to 29 for max shader constants (96 max). skins with more bones are skinned in software
+#define BONEMASK_WORDS		(MAX_BONES/32)
 
 namespace GSkeletonDataFlags
 {
@@ -47,17 +47,74 @@ class GSkeleton;
 class GSkin;
 
 //-------------------------------------------------------------------------
-//	matrix list but with a few additonal funcs for rotations
+//	bitmask with a bit for each bone index, fixed size so it needs no
+//	allocation and can be copied around like the u32 masks it replaced
 //-------------------------------------------------------------------------
-class GMatrixRotations : public GList<GMatrix>
+class GBoneMask
 {
+protected:
+	u32					m_Bits[BONEMASK_WORDS];
+
 public:
-	
+	GBoneMask()									{	Empty();	};
+
+	inline void			Empty()						{	memset( m_Bits, 0, sizeof(m_Bits) );	};
+	inline void			SetAll()					{	memset( m_Bits, 0xff, sizeof(m_Bits) );	};
+	inline void			SetFirst(int Count);		//	set bits 0..Count-1 and clear the rest
+	inline void			ClearFrom(int Index);		//	clear this bit and all the ones after it
+	inline Bool			IsEmpty() const;
+	inline int			LastSet() const;			//	index of the highest bit set, -1 if empty
+
+	inline Bool			IsSet(int Index) const		{	GDebug_CheckIndex(Index,0,MAX_BONES);	return ( m_Bits[Index>>5] & ( (u32)1<<(Index&31) ) ) != 0x0;	};
+	inline void			Set(int Index)				{	GDebug_CheckIndex(Index,0,MAX_BONES);	m_Bits[Index>>5] |= (u32)1<<(Index&31);	};
+	inline void			Clear(int Index)			{	GDebug_CheckIndex(Index,0,MAX_BONES);	m_Bits[Index>>5] &= ~( (u32)1<<(Index&31) );	};
+	inline void			Remove(const GBoneMask& Mask);	//	clear the bits that are set in Mask
+
+	inline u32			GetWord(int Word) const		{	return m_Bits[Word];	};	//	bits Word*32 .. Word*32+31
+	inline void			SetWord(int Word,u32 Bits)	{	m_Bits[Word] = Bits;	};
+
+	inline GBoneMask&	operator|=(const GBoneMask& Mask);
+	inline GBoneMask&	operator&=(const GBoneMask& Mask);
+	inline GBoneMask	operator|(const GBoneMask& Mask) const	{	GBoneMask Result( *this );	Result |= Mask;	return Result;	};
+	inline GBoneMask	operator&(const GBoneMask& Mask) const	{	GBoneMask Result( *this );	Result &= Mask;	return Result;	};
+};
+
+
+//-------------------------------------------------------------------------
+//	matrix list for rotations
+//-------------------------------------------------------------------------
+class GMatrixRotations : public GList<GMatrix>
+{
 public:
 	GMatrixRotations()		{	};
 	~GMatrixRotations()		{	};
+};
+
+
+//-------------------------------------------------------------------------
+//	rotation and translation of each bone. kept in seperate lists so
+//	sampling and blending run straight through them in quaternion space
+//-------------------------------------------------------------------------
+class GAnimPose
+{
+public:
+	GList<GQuaternion>	m_Rotations;
+	GList<float3>		m_Translations;
+
+public:
+	GAnimPose()			{	};
+	~GAnimPose()		{	};
+
+	inline int				Size() const					{	return m_Rotations.Size();	};
+	void					Resize(int BoneCount);			//	new bones are identity
+	void					SetAllIdentity();
+	inline Bool				IsIdentity(int Bone) const;		//	no rotation or translation
+	void					Copy(const GAnimPose& Pose);
 
-	GRotationBlendResult	Blend(GMatrixRotations& BlendRotations, float BlendRate);	//	blend these rotations with the rotations passed in
+	void					SetBoneMatrix(int Bone, const GMatrix& Matrix);	//	set from a rotation/translation matrix
+	void					GetBoneMatrix(int Bone, GMatrix& Matrix) const;	//	get as a rotation/translation matrix
+
+	GRotationBlendResult	Blend(const GAnimPose& BlendPose, float BlendRate);	//	blend this pose with the pose passed in
 };
 
 
@@ -86,8 +143,8 @@ public:
 
 	GMatrix				m_Relative;		//	local transformation matrix
 	GMatrix				m_Absolute;		//	transformation matrix in heirachy
-	u32					m_ParentBones;	//	bitmask of this bones parents (-1 if uninitialised as not ALL bones can be parent)
-	u32					m_ChildBones;	//	bitmask of this bones children (similar to ParentBones bitmask)
+	GBoneMask			m_ParentBones;	//	bitmask of this bones parents (all set if uninitialised as not ALL bones can be parent)
+	GBoneMask			m_ChildBones;	//	bitmask of this bones children (similar to ParentBones bitmask)
 
 private:
 	GBone*				m_pParent;		//	parent bone
@@ -124,10 +181,9 @@ protected:
 	void				DeleteChildren();				//	delete child bones
 	int					CountBones(Bool Recurseup=FALSE);	//	updates our bone counter. if Recurse up is true, parents recalc bone counts too
 	void				GetBonePosition(GList<float3>& BonePositions, float3 ParentPos, int& BoneIndex );	//	recursive func to gather bone positions
-	void				GetBoneTransform(GList<GMatrix>& BoneFinal, int& BoneIndex, int ParentIndex, GList<GMatrix>& MainRotations, GList<GMatrix>* pModifiedRotations, u32& BonesNeedUpdating, Bool Recurse, const u32& ValidAnimRotations, const u32& ValidModifiedRotations );
 	void				InitBoneMatrix();
 	int					CalcIndex();					//	runs through skeleton to get index
-	void				SetParentBoneMask(u32 CurrentParentBoneMask);	//	recursive function to setup bones' parent bones bitmask
+	void				SetParentBoneMask(const GBoneMask& CurrentParentBoneMask);	//	recursive function to setup bones' parent bones bitmask
 	void				UpdateChildBoneMask();			//	goes up through its parents and adds to bitmask
 };
 
@@ -158,6 +214,9 @@ public:
 private:
 	GBone				m_RootBone;
 	GList<GBone*>		m_BonePtrList;	//	quick access list to bones via indexes
+	GList<int>			m_BoneParents;	//	parent index of each bone (-1 for root). bones are depth first so parents always come before their children
+	GList<GMatrix>		m_BoneRelative;	//	each bone's relative matrix in bone index order
+	Bool				m_FlatBonesValid;	//	m_BoneParents and m_BoneRelative match the bone tree
 
 public:
 	GSkeleton();
@@ -175,9 +234,10 @@ public:
 
 	void				GenerateDebugColours(Bool GenerateForAll);	//	makes new debug colours for our bones
 	void				GetBonePositions(GList<float3>& BonePositions);
-	void				GetBoneTransform(GList<GMatrix>& BoneFinalRotations, GList<GMatrix>& MainRotations, GList<GMatrix>* pModifiedRotations, u32 BonesNeedUpdating, const u32& ValidAnimRotations, const u32& ValidModifiedRotations );
+	void				GetBoneTransform(GList<GMatrix>& BoneFinalRotations, const GAnimPose& AnimPose, GList<GMatrix>* pModifiedRotations, const GBoneMask& BonesNeedUpdating, const GBoneMask& ValidAnimRotations, const GBoneMask& ValidModifiedRotations );
 
 	inline int			BoneCount()						{	return m_RootBone.BoneCount();	};
+	void				PrepareForThreads();			//	build cached data so GetBoneTransform can be called from several threads at once
 	GBone*				FindBone(GAssetRef BoneRef)		{	int Index=0;	return m_RootBone.FindBone( BoneRef, Index );	};	//	search through children for this bone
 	GBone*				RootBone()						{	return &m_RootBone;	};
 	Bool				DeleteBone(GAssetRef BoneRef);	//	delete a bone from the skeleton
@@ -193,7 +253,9 @@ protected:
 	void				OnBoneAdded(GBone* pBone);		//	callback when a bone is added
 	void				InitBoneMatrixes();				//	
 	void				RebuildBonePtrList();
-	inline void			SetupBoneParentMasks()			{	m_RootBone.SetParentBoneMask(0x0);	};	//	setup each bone's parent bone mask
+	void				RebuildFlatBones();				//	rebuild parent indexes and relative matrixes from the bone tree
+	inline void			InvalidateFlatBones()			{	m_FlatBonesValid = FALSE;	};	//	bone tree or offsets have changed
+	inline void			SetupBoneParentMasks()			{	m_RootBone.SetParentBoneMask( GBoneMask() );	};	//	setup each bone's parent bone mask
 
 };
 
@@ -213,7 +275,7 @@ typedef struct
 typedef struct 
 {
 	float		FrameNumber;
-	u32			ValidRotMask;
+	u32			ValidRotMask;	//	only has room for the first 32 bones, the mask is recalculated from the matrixes when loaded
 	float3		RootOffset;
 
 } GSkeletonAnimKeyframeHeader;
@@ -222,22 +284,22 @@ typedef struct
 //-------------------------------------------------------------------------
 //	keyframe of anim
 //-------------------------------------------------------------------------
-class GAnimKeyFrame : public GMatrixRotations
+class GAnimKeyFrame : public GAnimPose
 {
 public:
 	GAnimKeyFrame();
 
 	float				m_FrameNumber;					//	which frame does this keyframe represent(whole numbers only)
-	u32					m_ValidRotMask;					//	bitmask of which rotations are applied(non identity)
+	GBoneMask			m_ValidRotMask;					//	bitmask of which rotations are applied(non identity)
 	float3				m_RootOffset;					//	root bone's offset from first frame. this is absolute, not relative to previous frames
 
-//	inline const u32	ValidRotMask()					{	return m_ValidRotMask;	};
-	inline const u32	ValidRotMask()					{	return 0xffffffff;	};
+//	inline const GBoneMask&	ValidRotMask()				{	return m_ValidRotMask;	};
+	inline GBoneMask	ValidRotMask()					{	GBoneMask All;	All.SetAll();	return All;	};
 	void				UpdateValidRotMask();			//	update bitmask of which rotations need to be applied
 	void				SetAllIdentity();				//	reset all rotations
-	void				UpdateBoneCount(int Bonecount);	//	update num of matrixes
+	void				UpdateBoneCount(int Bonecount);	//	update num of bones in the pose
 
-	virtual void		Copy(GAnimKeyFrame& Keyframe);	//	copies frame info AND matrixes
+	virtual void		Copy(GAnimKeyFrame& Keyframe);	//	copies frame info AND pose
 
 	inline Bool			operator==(GAnimKeyFrame& k)	{	return floorf(m_FrameNumber) == floorf( k.m_FrameNumber );	};
 };
@@ -256,12 +318,20 @@ class GSkeletonAnim : public GAsset
 {
 public:
 	const static u32		g_Version;
+	const static u32		g_VersionMatrixKeyframes;	//	older version with a matrix for each bone in a keyframe, still loaded
+	const static u32		g_VersionCompressed;		//	keyframes saved as compressed tracks (see GAnimCompressed)
 
 public:
 	GAssetRef				m_SkinRef;		//	main skin(and inside, skeleton) associated with for this anim
 	GAnimKeyFrame			m_FirstFrame;	//	base keyframe
 	GAnimKeyFrameList		m_Keyframes;	//	keyframes
 	int						m_BoneCount;	//	number of matrixes matches this number of bones
+	Bool					m_SaveCompressed;				//	save as compressed tracks. lossy, keys are kept within these tolerances
+	float					m_CompressRotationTolerance;	//	radians
+	float					m_CompressTranslationTolerance;
+
+protected:
+	GList<float>			m_KeyframeNumbers;	//	frame number of each keyframe in m_Keyframes, in one block for searching
 
 public:
 	GSkeletonAnim();
@@ -269,7 +339,8 @@ public:
 
 	//	asset virtual
 	virtual GAssetType		AssetType()						{	return GAssetSkeletonAnim;	};
-	virtual u32				Version()						{	return GSkeletonAnim::g_Version;	};
+	virtual u32				Version()						{	return m_SaveCompressed ? GSkeletonAnim::g_VersionCompressed : GSkeletonAnim::g_Version;	};
+	virtual Bool			SupportsVersion(u32 AssetVersion)	{	return ( AssetVersion == GSkeletonAnim::g_Version || AssetVersion == GSkeletonAnim::g_VersionMatrixKeyframes || AssetVersion == GSkeletonAnim::g_VersionCompressed );	};
 	virtual Bool			Load(GBinaryData& Data);
 	virtual Bool			Save(GBinaryData& Data);
 	
@@ -284,12 +355,19 @@ public:
 	Bool					RemoveKeyframeIndex(int Index);
 	GAnimKeyFrame*			GetKeyframeIndex(int KeyframeIndex);
 
-	void					GetRotations(float Frame, GMatrixRotations& Rotations, u32& ValidRotMask, float PreviousFrame, float3& ExtractedMovement );	//	extract rotations from anim on this frame (calculates interpolated frames too)
+	void					GetRotations(float Frame, GAnimPose& Pose, GBoneMask& ValidRotMask, float PreviousFrame, float3& ExtractedMovement, int* pCursor=NULL );	//	extract rotations from anim on this frame (calculates interpolated frames too). pCursor is the caller's last keyframe position to speed up playback
 
 	inline int				KeyframeCount()					{	return m_Keyframes.Size();	};			//	doesnt include base keyframe..
 	inline float			LastKeyframe()					{	return (m_Keyframes.Size() == 0) ? 0.f : m_Keyframes[ m_Keyframes.LastIndex() ]->m_FrameNumber;	};
 
 	Bool					Copy(GSkeletonAnim* pAnim,GAssetRef NewRef=GAssetRef_Invalid);		//	make this anim a copy of pAnim
+	void					ReportCompressionError();		//	compress with the current tolerances and print the error and size
+
+protected:
+	int						FindKeyframeAfter(float Frame, int* pCursor=NULL);	//	index in m_Keyframes of the first keyframe at or after this frame, KeyframeCount() if none
+	void					UpdateKeyframeNumbers();		//	rebuild m_KeyframeNumbers after m_Keyframes has changed
+	Bool					LoadPose(GBinaryData& Data, GAnimPose& Pose, Bool MatrixKeyframes);	//	read a keyframe's rotations and translations, converting from matrixes in older data
+	void					SavePose(GBinaryData& Data, GAnimPose& Pose);
 };
 
 
@@ -306,6 +384,74 @@ Bool CompareIsLess(GAnimKeyFrame*& a, GAnimKeyFrame*& b);
 
 //	Inline Definitions
 //-------------------------------------------------
+inline void GBoneMask::SetFirst(int Count)
+{
+	Empty();
+	for ( int w=0;	w<BONEMASK_WORDS && Count>0;	w++, Count-=32 )
+		m_Bits[w] = ( Count >= 32 ) ? 0xffffffff : ( ( (u32)1<<Count ) - 1 );
+}
+
+inline void GBoneMask::ClearFrom(int Index)
+{
+	if ( Index < 0 )
+		Index = 0;
+
+	for ( int w=Index>>5;	w<BONEMASK_WORDS;	w++, Index=w<<5 )
+		m_Bits[w] &= ( (u32)1<<(Index&31) ) - 1;
+}
+
+inline Bool GBoneMask::IsEmpty() const
+{
+	for ( int w=0;	w<BONEMASK_WORDS;	w++ )
+		if ( m_Bits[w] )
+			return FALSE;
+
+	return TRUE;
+}
+
+inline int GBoneMask::LastSet() const
+{
+	for ( int w=BONEMASK_WORDS-1;	w>=0;	w-- )
+	{
+		if ( !m_Bits[w] )
+			continue;
+
+		for ( int b=31;	b>=0;	b-- )
+			if ( m_Bits[w] & ( (u32)1<<b ) )
+				return (w<<5) + b;
+	}
+
+	return -1;
+}
+
+inline void GBoneMask::Remove(const GBoneMask& Mask)
+{
+	for ( int w=0;	w<BONEMASK_WORDS;	w++ )
+		m_Bits[w] &= ~Mask.m_Bits[w];
+}
+
+inline GBoneMask& GBoneMask::operator|=(const GBoneMask& Mask)
+{
+	for ( int w=0;	w<BONEMASK_WORDS;	w++ )
+		m_Bits[w] |= Mask.m_Bits[w];
+	return *this;
+}
+
+inline GBoneMask& GBoneMask::operator&=(const GBoneMask& Mask)
+{
+	for ( int w=0;	w<BONEMASK_WORDS;	w++ )
+		m_Bits[w] &= Mask.m_Bits[w];
+	return *this;
+}
+
+inline Bool GAnimPose::IsIdentity(int Bone) const
+{
+	const GQuaternion& Rotation = m_Rotations.ElementAtConst(Bone);
+	const float3& Translation = m_Translations.ElementAtConst(Bone);
+
+	return ( Rotation == GQuaternion() ) && ( Translation.x == 0.f && Translation.y == 0.f && Translation.z == 0.f );
+}
+
 inline int GBone::CalcIndex()						
 {	
 	m_Index = m_pSkeleton->GetBoneIndex(this);
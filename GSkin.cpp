@@ -17,11 +17,40 @@
 #include "GAssetList.h"
 #include "GFile.h"
 #include "GWorld.h"
+#include "GStats.h"
+#include "GThreadPool.h"
+
+#ifdef GSKIN_SSE
+	#include <xmmintrin.h>
+#endif
 
 
 //	globals
 //------------------------------------------------
-const u32 GSkin::g_Version	= 0x99990004;
+const u32 GSkin::g_Version			= 0x99990005;
+const u32 GSkin::g_VersionS8Bones	= 0x99990004;
+volatile LONG GSkin::g_NextBoneDataID	= 0;
+Bool GSkinShader::g_ScalarSkinning	= FALSE;
+Bool GSkinShader::g_UsePoseCache	= FALSE;
+float GSkinShader::g_PoseCacheFrameStep	= 0.f;
+float GSkinShader::g_PoseCacheBlendStep	= 0.f;
+GPoseCache GSkinShader::g_PoseCache;
+Bool GSkinShader::g_UseAnimLOD	= FALSE;
+float GSkinShader::g_AnimLODDistance[GSKIN_ANIM_LODS]	= { 0.f, 15.f, 30.f, 60.f };
+float3 GSkinShader::g_AnimLODViewPos( 0, 0, 0 );
+Bool GSkinShader::g_AnimLODViewPosValid	= FALSE;
+u32 GSkinShader::g_AnimLODFrame	= 0;
+u32 GSkinShader::g_AnimLODNextPhase	= 0;
+
+GDeclareCounter(PoseCacheHits);
+GDeclareCounter(PoseCacheMisses);
+GDeclareCounter(AnimLOD0Updates);
+GDeclareCounter(AnimLOD1Updates);
+GDeclareCounter(AnimLOD2Updates);
+GDeclareCounter(AnimLOD3Updates);
+GDeclareCounter(AnimLODHeldPoses);
+
+static const char* g_AnimLODCounterNames[GSKIN_ANIM_LODS] = { "AnimLOD0Updates", "AnimLOD1Updates", "AnimLOD2Updates", "AnimLOD3Updates" };
 
 extern const char g_SkinShaderARB[];
 
@@ -39,6 +68,7 @@ GSkin::GSkin()
 {
 	m_Skeleton	= GAssetRef_Invalid;
 	m_Mesh		= GAssetRef_Invalid;
+	NewBoneDataID();
 }
 
 //-------------------------------------------------------------------------
@@ -71,6 +101,8 @@ Bool GSkin::Load(GBinaryData& Data)
 	//	take data from header
 	m_Mesh = Header.MeshRef;
 	m_Skeleton = Header.SkeletonRef;
+	m_BoneBounds.Empty();
+	NewBoneDataID();
 
 	//	load in additional data
 	if ( Header.DataFlags & GSkinHeaderDataFlags::BoneVertexLinks )
@@ -117,8 +149,22 @@ Bool GSkin::Load(GBinaryData& Data)
 
 		m_VertexBones.Resize( VertexCount );
 		//LOAD_DATA( m_VertexBones.Data(), m_VertexBones.DataSize() );
-		if ( !Data.Read( m_VertexBones.Data(), m_VertexBones.DataSize(), "Skin VertexBone data" ) )
-			return FALSE;
+		if ( m_LoadVersion == GSkin::g_VersionS8Bones )
+		{
+			//	convert old 8 bit bone indexes
+			GList<s82> VertexBonesS8;
+			VertexBonesS8.Resize( VertexCount );
+			if ( !Data.Read( VertexBonesS8.Data(), VertexBonesS8.DataSize(), "Skin VertexBone data" ) )
+				return FALSE;
+
+			for ( int v=0;	v<VertexBonesS8.Size();	v++ )
+				m_VertexBones[v] = s162( VertexBonesS8[v].x, VertexBonesS8[v].y );
+		}
+		else
+		{
+			if ( !Data.Read( m_VertexBones.Data(), m_VertexBones.DataSize(), "Skin VertexBone data" ) )
+				return FALSE;
+		}
 	}
 
 	if ( Header.DataFlags & GSkinHeaderDataFlags::BoneBoneList )
@@ -138,8 +184,26 @@ Bool GSkin::Load(GBinaryData& Data)
 		m_BoneBoneVertexList.Resize( VertexCount );
 		//LOAD_DATA( m_BoneBoneList.Data(), m_BoneBoneList.DataSize() );
 		//LOAD_DATA( m_BoneBoneVertexList.Data(), m_BoneBoneVertexList.DataSize() );
-		if ( !Data.Read( m_BoneBoneList.Data(), m_BoneBoneList.DataSize(), "Skin BoneBone data" ) )
-			return FALSE;
+		if ( m_LoadVersion == GSkin::g_VersionS8Bones )
+		{
+			//	convert old 8 bit bone indexes
+			GList<GSkinBoneBoneS8> BoneBoneListS8;
+			BoneBoneListS8.Resize( BoneBoneCount );
+			if ( !Data.Read( BoneBoneListS8.Data(), BoneBoneListS8.DataSize(), "Skin BoneBone data" ) )
+				return FALSE;
+
+			for ( int bb=0;	bb<BoneBoneListS8.Size();	bb++ )
+			{
+				m_BoneBoneList[bb].BoneA		= BoneBoneListS8[bb].BoneA;
+				m_BoneBoneList[bb].BoneB		= BoneBoneListS8[bb].BoneB;
+				m_BoneBoneList[bb].NoOfVerts	= BoneBoneListS8[bb].NoOfVerts;
+			}
+		}
+		else
+		{
+			if ( !Data.Read( m_BoneBoneList.Data(), m_BoneBoneList.DataSize(), "Skin BoneBone data" ) )
+				return FALSE;
+		}
 		if ( !Data.Read( m_BoneBoneVertexList.Data(), m_BoneBoneVertexList.DataSize(), "Skin BoneBone vertex data" ) )
 			return FALSE;
 	}
@@ -278,14 +342,98 @@ void GSkin::Draw(GDrawInfo& DrawInfo, GSkinShader* pShader, GAssetRef HighlightB
 
 
 
+//-------------------------------------------------------------------------
+//	vertexes are linked to the nearest bone. a bone's segments run from it
+//	to each of its children (the limb it moves), bones without children
+//	are just a point
+//-------------------------------------------------------------------------
+typedef struct
+{
+	float3		Start;
+	float3		End;
+	int			Bone;
+
+} GSkinBoneSegment;
+
+#define WEIGHT_JOB_VERTS	1024	//	vertexes for each weight generation job
+
+typedef struct
+{
+	GSkin*						pSkin;
+	const float3*				pVerts;
+	int							VertCount;
+	const GSkinBoneSegment*		pSegments;
+	int							SegmentCount;
+
+} GSkinWeightJob;
+
+
+//-------------------------------------------------------------------------
+//	job for the thread pool, links a range of vertexes to their nearest bone
+//-------------------------------------------------------------------------
+static void GenerateWeightsJob(int JobIndex,void* pParam)
+{
+	GSkinWeightJob& Job = *(GSkinWeightJob*)pParam;
+	int FirstVert = JobIndex * WEIGHT_JOB_VERTS;
+	int LastVert = FirstVert + WEIGHT_JOB_VERTS;
+	if ( LastVert > Job.VertCount )
+		LastVert = Job.VertCount;
+
+	float2* pWeights = Job.pSkin->m_VertexWeights.Data();
+	s162* pVertexBones = Job.pSkin->m_VertexBones.Data();
+
+	for ( int v=FirstVert;	v<LastVert;	v++ )
+	{
+		const float3& VertPos = Job.pVerts[v];
+
+		//	find nearest bone segment, first one wins if they're the same distance
+		int NearBone = Job.pSegments[0].Bone;
+		float NearLengthSq = -1.f;
+
+		for ( int s=0;	s<Job.SegmentCount;	s++ )
+		{
+			const GSkinBoneSegment& Segment = Job.pSegments[s];
+
+			//	nearest point on the segment
+			float3 Dir = Segment.End - Segment.Start;
+			float3 Closest = Segment.Start;
+			float DirLengthSq = Dir.LengthSq();
+			if ( DirLengthSq > 0.f )
+			{
+				float t = ( VertPos - Segment.Start ).DotProduct( Dir ) / DirLengthSq;
+				if ( t > 1.f )	t = 1.f;
+				if ( t > 0.f )	Closest += Dir * t;
+			}
+
+			float LengthSq = ( VertPos - Closest ).LengthSq();
+			if ( NearLengthSq < 0.f || LengthSq < NearLengthSq )
+			{
+				NearBone = Segment.Bone;
+				NearLengthSq = LengthSq;
+			}
+		}
+
+		//	setup weight
+		pWeights[v][0] = 1.f;
+		pWeights[v][1] = 0.f;
+
+		//	setup bones
+		pVertexBones[v][0] = NearBone;
+		pVertexBones[v][1] = -1;
+	}
+}
+
+
 void GSkin::GenerateBoneVertexWeights()
 {
-	int b;
+	int b, v;
 
 	//	clear out current data
 	m_VertexWeights.Empty();
 	m_BoneVertexList.Empty();
 	m_VertexBones.Empty();
+	m_BoneBounds.Empty();
+	NewBoneDataID();
 
 
 	GMesh* pMesh = GetMesh();
@@ -305,50 +453,69 @@ void GSkin::GenerateBoneVertexWeights()
 	int BoneCount = BonePositions.Size();
 	int VertCount = pMesh->m_Verts.Size();
 
+	if ( BoneCount == 0 )
+	{
+		GDebug::Print("Skeleton has no bones to generate skin's bone-vertex weights\n");
+		return;
+	}
+
+	//	segment from each bone to each child, or just the bone's position if it has no children
+	GList<GSkinBoneSegment> Segments;
+	GList<Bool> HasChildren;
+	HasChildren.Resize( BoneCount );
+	HasChildren.SetAll( FALSE );
+
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		int Parent = pSkeleton->GetBoneIndex(b)->GetParentIndex();
+		if ( Parent < 0 || Parent >= BoneCount )
+			continue;
+
+		GSkinBoneSegment Segment;
+		Segment.Start	= BonePositions[Parent];
+		Segment.End		= BonePositions[b];
+		Segment.Bone	= Parent;
+		Segments.Add( Segment );
+		HasChildren[Parent] = TRUE;
+	}
+
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		if ( HasChildren[b] )
+			continue;
+
+		GSkinBoneSegment Segment;
+		Segment.Start	= BonePositions[b];
+		Segment.End		= BonePositions[b];
+		Segment.Bone	= b;
+		Segments.Add( Segment );
+	}
+
 	//	alloc data
 	m_VertexWeights.Resize( VertCount );
 	m_VertexWeights.SetAll( float2( 0.f, 0.f ) );
 	
 	//	alloc and init
 	m_VertexBones.Resize( VertCount );
-	m_VertexBones.SetAll( s82( -1, -1 ) );
+	m_VertexBones.SetAll( s162( -1, -1 ) );
+
+	//	find each vertex's nearest bone, in ranges of vertexes across threads
+	GSkinWeightJob Job;
+	Job.pSkin			= this;
+	Job.pVerts			= pMesh->m_Verts.Data();
+	Job.VertCount		= VertCount;
+	Job.pSegments		= Segments.Data();
+	Job.SegmentCount	= Segments.Size();
+	GThreadPool::g_ThreadPool.ParallelFor( ( VertCount + WEIGHT_JOB_VERTS - 1 ) / WEIGHT_JOB_VERTS, GenerateWeightsJob, &Job );
 
 	//	initialise data
 	m_BoneVertexList.Resize( BoneCount );
 	for ( b=0;	b<BoneCount;	b++ )
 		m_BoneVertexList[b].Vertexes.Realloc(0);
 
-	//	go through each vertex and find the nearest bone
-	for ( int v=0;	v<VertCount;	v++ )
-	{
-		float3& VertPos = pMesh->m_Verts[v];
-
-		//	find nearest bone from list
-		int NearBone = 0;
-		float NearLengthSq = ( VertPos - BonePositions[0] ).LengthSq();
-
-		for ( int b=1;	b<BoneCount;	b++ )
-		{
-			float BoneLengthSq = ( VertPos - BonePositions[b] ).LengthSq();
-			if ( BoneLengthSq < NearLengthSq )
-			{
-				NearBone = b;
-				NearLengthSq = BoneLengthSq;
-			}
-		}
-
-		//	setup weight
-		m_VertexWeights[v][0] = 1.f;
-		m_VertexWeights[v][1] = 0.f;
-
-		//	setup bones
-		m_VertexBones[v][0] = NearBone;
-		m_VertexBones[v][1] = -1;
-
-		//	nearest bone is NearBone (use weight #0)
-		m_BoneVertexList[NearBone].Vertexes.Add( int2( v, 0 ) );
-	}
-
+	//	link bones to their vertexes (use weight #0)
+	for ( v=0;	v<VertCount;	v++ )
+		m_BoneVertexList[ m_VertexBones[v][0] ].Vertexes.Add( int2( v, 0 ) );
 	
 	//	calc bone-bone list
 	GenerateBoneBoneLists();
@@ -357,10 +524,14 @@ void GSkin::GenerateBoneVertexWeights()
 }
 
 //-------------------------------------------------------------------------
-//	calculate the bone-bone lists from the current bone/vertex links
+//	calculate the bone-bone lists from the current bone/vertex links.
+//	vertexes are counting sorted into BoneA then BoneB order (BoneB -1
+//	first), in vertex order within each pair
 //-------------------------------------------------------------------------
 void GSkin::GenerateBoneBoneLists()
 {
+	int v, p;
+	NewBoneDataID();
 	GMesh* pMesh = GetMesh();
 	GSkeleton* pSkeleton = GetSkeleton();
 
@@ -373,37 +544,60 @@ void GSkin::GenerateBoneBoneLists()
 	
 	int BoneCount = pSkeleton->BoneCount();
 	int VertCount = pMesh->VertCount();
+	if ( VertCount > m_VertexBones.Size() )
+		VertCount = m_VertexBones.Size();
 
 	//	clear out current data
 	m_BoneBoneList.Empty();
 	m_BoneBoneVertexList.Empty();
 
-	for ( int BoneA=0;	BoneA<BoneCount;	BoneA++ )
+	//	pair index for each vertex, -1 if its bones are out of range
+	int PairCount = BoneCount * ( BoneCount + 1 );
+	GList<int> VertPairs;
+	GList<int> PairStart;
+	VertPairs.Resize( VertCount );
+	PairStart.Resize( PairCount + 1 );
+	PairStart.SetAll( 0 );
+
+	for ( v=0;	v<VertCount;	v++ )
 	{
-		for ( int BoneB=-1;	BoneB<BoneCount;	BoneB++ )
+		int BoneA = m_VertexBones[v][0];
+		int BoneB = m_VertexBones[v][1];
+
+		if ( BoneA < 0 || BoneA >= BoneCount || BoneB < -1 || BoneB >= BoneCount )
 		{
-			int ABVertCount = 0;
+			VertPairs[v] = -1;
+			continue;
+		}
 
-			for ( int v=0;	v<VertCount;	v++ )
-			{
-				if ( (m_VertexBones[v][0] == BoneA) && (m_VertexBones[v][1] == BoneB) )
-				{
-					//	add entry
-					ABVertCount++;
-					m_BoneBoneVertexList.Add( v );
-				}
-			}
+		VertPairs[v] = BoneA * ( BoneCount + 1 ) + ( BoneB + 1 );
+		PairStart[ VertPairs[v] + 1 ]++;
+	}
 
-			//	create bone bone entry if applicable
-			if ( ABVertCount > 0 )
-			{
-				GSkinBoneBone BoneBone;
-				BoneBone.BoneA = BoneA;
-				BoneBone.BoneB = BoneB;
-				BoneBone.NoOfVerts = ABVertCount;
-				m_BoneBoneList.Add( BoneBone );
-			}
+	//	bone-bone entry for each pair with vertexes, and where its vertexes start
+	for ( p=0;	p<PairCount;	p++ )
+	{
+		int PairVerts = PairStart[p+1];
+		if ( PairVerts > 0 )
+		{
+			GSkinBoneBone BoneBone;
+			BoneBone.BoneA = p / ( BoneCount + 1 );
+			BoneBone.BoneB = ( p % ( BoneCount + 1 ) ) - 1;
+			BoneBone.NoOfVerts = PairVerts;
+			m_BoneBoneList.Add( BoneBone );
 		}
+
+		PairStart[p+1] += PairStart[p];
+	}
+
+	//	place vertexes, in order so they stay in vertex order within their pair
+	m_BoneBoneVertexList.Resize( PairStart[PairCount] );
+	for ( v=0;	v<VertCount;	v++ )
+	{
+		if ( VertPairs[v] == -1 )
+			continue;
+
+		m_BoneBoneVertexList[ PairStart[ VertPairs[v] ]++ ] = v;
 	}
 }
 
@@ -418,6 +612,106 @@ GMesh* GSkin::GetMesh()
 }
 
 
+//-------------------------------------------------------------------------
+//	get the bounds of the vertexes that move with each bone, in the bone's
+//	space (the same space as the inverse vertexes) so they can be moved 
+//	with the final bone matrixes. a vertex's position is a blend of where
+//	each of its bones puts its inverse vertex so it's added to both bones
+//-------------------------------------------------------------------------
+GList<GBounds>* GSkin::GetBoneBounds()
+{
+	GSkeleton* pSkeleton = GetSkeleton();
+	GMesh* pMesh = GetMesh();
+	if ( !pSkeleton || !pMesh )
+		return NULL;
+
+	int BoneCount = pSkeleton->BoneCount();
+	if ( m_BoneBounds.Size() == BoneCount )
+		return &m_BoneBounds;
+
+	if ( m_VertexBones.Size() != pMesh->m_Verts.Size() || m_BoneVertexList.Size() < BoneCount )
+	{
+		GDebug_Print("Skin vertex bones don't match the mesh, can't generate bone bounds\n");
+		return NULL;
+	}
+
+	int b, v;
+
+	//	inverse vertexes by their first bone, same as the skinning shader
+	GList<float3> InverseVerts;
+	InverseVerts.Copy( pMesh->m_Verts );
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		GMatrix& BoneAbsolute = pSkeleton->GetBoneIndex(b)->m_Absolute;
+		for ( int i=0;	i<m_BoneVertexList[b].Vertexes.Size();	i++ )
+		{
+			float3& VertPos = InverseVerts[ m_BoneVertexList[b].Vertexes[i][0] ];
+			BoneAbsolute.InverseTranslateVect( VertPos );
+			BoneAbsolute.InverseRotateVect( VertPos );
+		}
+	}
+
+	//	box around each bone's vertexes
+	GList<float3> BoxMin;
+	GList<float3> BoxMax;
+	GList<int> BoneVertCount;
+	BoxMin.Resize( BoneCount );
+	BoxMax.Resize( BoneCount );
+	BoneVertCount.Resize( BoneCount );
+	BoneVertCount.SetAll( 0 );
+
+	for ( v=0;	v<InverseVerts.Size();	v++ )
+	{
+		float3 Pos = InverseVerts[v];
+		for ( int w=0;	w<2;	w++ )
+		{
+			int Bone = m_VertexBones[v][w];
+			if ( Bone < 0 || Bone >= BoneCount )
+				continue;
+
+			if ( BoneVertCount[Bone]++ == 0 )
+			{
+				BoxMin[Bone] = Pos;
+				BoxMax[Bone] = Pos;
+				continue;
+			}
+
+			float3& Min = BoxMin[Bone];
+			float3& Max = BoxMax[Bone];
+			for ( int a=0;	a<3;	a++ )
+			{
+				if ( Pos[a] < Min[a] )	Min[a] = Pos[a];
+				if ( Pos[a] > Max[a] )	Max[a] = Pos[a];
+			}
+		}
+	}
+
+	//	sphere from the centre of the box out to the furthest vertex
+	m_BoneBounds.Resize( BoneCount );
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		m_BoneBounds[b].m_Radius = BoneVertCount[b] ? 0.f : -1.f;
+		m_BoneBounds[b].m_Offset = BoneVertCount[b] ? ( BoxMin[b] + BoxMax[b] ) * 0.5f : float3(0,0,0);
+	}
+
+	for ( v=0;	v<InverseVerts.Size();	v++ )
+	{
+		for ( int w=0;	w<2;	w++ )
+		{
+			int Bone = m_VertexBones[v][w];
+			if ( Bone < 0 || Bone >= BoneCount )
+				continue;
+
+			float Distance = ( InverseVerts[v] - m_BoneBounds[Bone].m_Offset ).Length();
+			if ( Distance > m_BoneBounds[Bone].m_Radius )
+				m_BoneBounds[Bone].m_Radius = Distance;
+		}
+	}
+
+	return &m_BoneBounds;
+}
+
+
 
 
 
@@ -427,12 +721,15 @@ GSkinShader::GSkinShader()
 {
 	m_AnimFrame					= 0.f;
 	m_Anim						= GAssetRef_Invalid;
+	m_AnimKeyframeCursor		= 0;
 	m_Skin						= GAssetRef_Invalid;
 	m_LastBoneCounter			= 0;
-	m_ModifiedBones				= 0x0;
-	m_ValidAnimRotations		= 0x0;
-	m_ValidModifiedRotations	= 0x0;
-	m_VertexModifiedBones		= 0x0;
+	m_SkinStreamStride			= 0;
+	m_InverseBoneDataID			= 0;
+	m_pBatchSkeleton			= NULL;
+	m_BatchSkinVertexes			= FALSE;
+	m_SoftwareSkinned			= FALSE;
+	m_SkinnedBoundsValid		= FALSE;
 	m_NewAnim					= GAssetRef_Invalid;
 	m_NewAnimFrame				= 0.f;
 	m_Flags						= 0x0;
@@ -441,9 +738,15 @@ GSkinShader::GSkinShader()
 	m_BlendAnim					= GAssetRef_Invalid;
 	m_BlendAnimFrame			= 0.f;
 	m_BlendAnimNewFrame			= 0.f;
+	m_BlendAnimKeyframeCursor	= 0;
 	m_BlendAmount				= 0.f;
 	m_BlendRate					= 0.f;
 
+	m_AnimLOD					= 0;
+	m_AnimLODPhase				= g_AnimLODNextPhase++;
+	m_AnimLODFramesHeld			= 0;
+	m_AnimLODHeldStep			= 0.f;
+
 }
 
 GSkinShader::~GSkinShader()
@@ -451,6 +754,20 @@ GSkinShader::~GSkinShader()
 }
 
 
+//-------------------------------------------------------------------------
+//	the vertex program only has constants for MAX_HARDWARE_BONES bone
+//	matrixes, skeletons with more bones are skinned in software
+//-------------------------------------------------------------------------
+Bool GSkinShader::HardwareVersion()
+{
+	GSkeleton* pSkeleton = GetSkeleton();
+	if ( pSkeleton && pSkeleton->BoneCount() > MAX_HARDWARE_BONES )
+		return FALSE;
+
+	return TRUE;
+}
+
+
 //-------------------------------------------------------------------------
 //	set the attribs for this vertex
 //-------------------------------------------------------------------------
@@ -461,7 +778,7 @@ Bool GSkinShader::HardwarePreDrawVertex(float3& Vertex, float3& Normal, int Vert
 	if ( !pSkin )
 		return FALSE;
 	
-	s82& BoneIndex = pSkin->m_VertexBones[VertexIndex];
+	s162& BoneIndex = pSkin->m_VertexBones[VertexIndex];
 
 	//	set vertex attrib (bone matrix indexes)
 	g_DisplayExt.glVertexAttrib2sARB()( BONEINDEX_ATTRIB, BoneIndex[0], BoneIndex[1] );
@@ -481,6 +798,8 @@ Bool GSkinShader::HardwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3
 	GSkin* pSkin = GetSkin();
 	GSkeletonAnim* pAnim = GetAnim();
 
+	m_SoftwareSkinned = FALSE;
+
 	//	update inverse vertex buffer and bones
 	CalcInverseVertexBuffer( *pVertexBuffer );
 	UpdateFinalBones();
@@ -489,7 +808,7 @@ Bool GSkinShader::HardwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3
 	pVertexBuffer = &m_InverseVertexBuffer;
 
 	//	set vertex attribs (bone matrix indexes)
-	pMesh->BindAttribArray( pSkin->m_VertexBones.Data(), GL_BYTE, 2, BONEINDEX_ATTRIB );
+	pMesh->BindAttribArray( pSkin->m_VertexBones.Data(), GL_SHORT, 2, BONEINDEX_ATTRIB );
 
 	//	load matrixes into constant registers
 	int ConstantIndex = m_FirstConstant; //	0..3 has projection matrix
@@ -555,22 +874,33 @@ Bool GSkinShader::GetVertexProgram(GString& String)
 }
 
 
-void GSkinShader::CalcInverseVertexBuffer( GList<float3>& VertexBuffer )
+void GSkinShader::CalcInverseVertexBuffer( GList<float3>& VertexBuffer, GList<float3>* pNormalBuffer )
 {
 	GSkin* pSkin = GetSkin();
 	if ( !pSkin )	
 		return;
 
 	GSkeleton* pSkeleton = GetSkeleton(pSkin->m_Skeleton);
+
+	//	only use normals that match the vertexes
+	if ( pNormalBuffer && pNormalBuffer->Size() != VertexBuffer.Size() )
+		pNormalBuffer = NULL;
 	
-	//	need new inverse vertex buffer
-	if ( m_InverseVertexBuffer.Size() != VertexBuffer.Size() )
+	//	need new inverse vertex buffer. a different skin (or its bones changing) needs it even if it's the same size
+	Bool NeedNormals = pNormalBuffer && ( m_InverseNormalBuffer.Size() != pNormalBuffer->Size() );
+	if ( m_InverseVertexBuffer.Size() != VertexBuffer.Size() || NeedNormals || m_InverseBoneDataID != pSkin->m_BoneDataID )
 	{
+		m_InverseBoneDataID = pSkin->m_BoneDataID;
+
 		//	force update of whole vertex buffer
-		m_VertexModifiedBones = (1<<m_LastBoneCounter)-1;
+		m_VertexModifiedBones.SetFirst( m_LastBoneCounter );
 
 		//	copy new vertex buffer into inverse buffer
 		m_InverseVertexBuffer.Copy( VertexBuffer );
+		if ( pNormalBuffer )
+			m_InverseNormalBuffer.Copy( *pNormalBuffer );
+		else
+			m_InverseNormalBuffer.Empty();
 	
 		//	inverse vertexes and setup constant data
 		for ( int b=0;	b<pSkeleton->BoneCount();	b++ )
@@ -591,189 +921,391 @@ void GSkinShader::CalcInverseVertexBuffer( GList<float3>& VertexBuffer )
 				GMatrix& BoneAbsolute = pBone->m_Absolute;
 				BoneAbsolute.InverseTranslateVect( VertPos );
 				BoneAbsolute.InverseRotateVect( VertPos );
+
+				//	normals are only rotated
+				if ( m_InverseNormalBuffer.Size() )
+					BoneAbsolute.InverseRotateVect( m_InverseNormalBuffer[ VertIndex ] );
 			}
 		}
+
+		//	streams are built from the inverse buffers
+		m_SkinStreamGroups.Empty();
 	}
 }
 
 
 //-------------------------------------------------------------------------
-//	update internal vertex buffer if required and set vertex buffer reference to it
+//	put the inverse vertexes into SoA streams, grouped by the bones they
+//	use, so software skinning can do 4 vertexes with the same bones at once
 //-------------------------------------------------------------------------
-Bool GSkinShader::SoftwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3>*& pVertexBuffer, GList<float3>*& pNormalBuffer, GList<float2>*& pTextureUVBuffer, GList<float2>*& pTextureUV2Buffer, GList<float3>*& pColourBuffer)
+void GSkinShader::BuildSkinStreams(GSkin* pSkin)
 {
-	GSkin* pSkin = GetSkin();
-	GSkeletonAnim* pAnim = GetAnim();
+	int v;
+	int VertCount = m_InverseVertexBuffer.Size();
 
-	if ( !pSkin || !pAnim )
-		return FALSE;
+	m_SkinStreamGroups.Empty();
+	m_SkinStreamVerts.Empty();
 
-	GSkeleton* pSkeleton = GetSkeleton(pSkin->m_Skeleton);
+	//	vertex order. bone-bone list already has vertexes grouped by bones
+	GList<int> VertOrder;
+	if ( pSkin->m_BoneBoneVertexList.Size() > 0 )
+	{
+		VertOrder.Resize( pSkin->m_BoneBoneVertexList.Size() );
+		for ( v=0;	v<VertOrder.Size();	v++ )
+			VertOrder[v] = pSkin->m_BoneBoneVertexList[v];
+	}
+	else
+	{
+		VertOrder.Resize( VertCount );
+		for ( v=0;	v<VertCount;	v++ )
+			VertOrder[v] = v;
+	}
 
-	//	calc a new inverse buffer if we need it
-	CalcInverseVertexBuffer( *pVertexBuffer );
+	//	split into runs using the same bones, padding each run to a multiple of 4
+	for ( v=0;	v<VertOrder.Size();	v++ )
+	{
+		int VertIndex = VertOrder[v];
+		if ( VertIndex < 0 || VertIndex >= VertCount || VertIndex >= pSkin->m_VertexBones.Size() )
+			continue;
 
-	if ( m_SoftwareVertexBuffer.Size() != m_InverseVertexBuffer.Size() )
-		m_SoftwareVertexBuffer.Resize( m_InverseVertexBuffer.Size() );
-	
-	//	assign local buffer
-	pVertexBuffer = &m_SoftwareVertexBuffer;
+		const s162& VertBone = pSkin->m_VertexBones[VertIndex];
+		int BoneA = VertBone[0];
+		int BoneB = VertBone[1];
 
-	//	update any bones that have been modified before modifying vertex buffer
-	UpdateFinalBones();
-	
-	//	recalc all verts
-	m_VertexModifiedBones = 0xffffffff;
+		//	single bones always go in A
+		if ( BoneA == -1 )
+		{
+			BoneA = BoneB;
+			BoneB = -1;
+		}
 
-	//	use bone-bone entries if availible
-	if ( pSkin->m_BoneBoneList.Size() > 0 )
-	{
-		int BBVertIndex = 0;
+		//	neither bone exists
+		if ( BoneA == -1 )
+		{
+			GDebug::Print("Warning: no bones for vertex %d\n",VertIndex);
+			continue;
+		}
 
-		for ( int BBIndex=0;	BBIndex<pSkin->m_BoneBoneList.Size();	BBIndex++ )
+		GSkinStreamGroup* pGroup = m_SkinStreamGroups.Size() ? &m_SkinStreamGroups.ElementLast() : NULL;
+		if ( !pGroup || pGroup->BoneA != BoneA || pGroup->BoneB != BoneB )
 		{
-			const s8& BoneA = pSkin->m_BoneBoneList[BBIndex].BoneA;
-			const s8& BoneB = pSkin->m_BoneBoneList[BBIndex].BoneB;
-			s82 VertBone;
-			VertBone[0] = BoneA;
-			VertBone[1] = BoneB;
+			//	pad last group
+			while ( m_SkinStreamVerts.Size() & 3 )
+				m_SkinStreamVerts.Add( -1 );
+
+			GSkinStreamGroup Group;
+			Group.BoneA	= BoneA;
+			Group.BoneB	= BoneB;
+			Group.First	= m_SkinStreamVerts.Size();
+			Group.Count	= 0;
+			pGroup = &m_SkinStreamGroups.ElementAt( m_SkinStreamGroups.Add( Group ) );
+		}
 
-			u32 BoneChanged[2] = { FALSE, FALSE };
-			if ( BoneA != -1 )	BoneChanged[0] = m_VertexModifiedBones & (1<<((u32)BoneA));
-			if ( BoneB != -1 )	BoneChanged[1] = m_VertexModifiedBones & (1<<((u32)BoneB));
+		m_SkinStreamVerts.Add( VertIndex );
+	}
 
-			if ( BoneChanged[0] || BoneChanged[1] )
-			{
-				//	get bones
-				GBone* pBone[2] = { NULL, NULL };
-				pBone[0] = BoneA == -1 ? NULL : pSkeleton->GetBoneIndex( BoneA );
-				pBone[1] = BoneB == -1 ? NULL : pSkeleton->GetBoneIndex( BoneB );
+	while ( m_SkinStreamVerts.Size() & 3 )
+		m_SkinStreamVerts.Add( -1 );
 
-				//	neither bone exists
-				if ( !pBone[0] && !pBone[1] )
-				{
-					continue;
-				}
+	for ( int g=0;	g<m_SkinStreamGroups.Size();	g++ )
+	{
+		GSkinStreamGroup& Group = m_SkinStreamGroups[g];
+		int End = ( g+1 < m_SkinStreamGroups.Size() ) ? m_SkinStreamGroups[g+1].First : m_SkinStreamVerts.Size();
+		Group.Count = End - Group.First;
+	}
 
-				for ( int v=0;	v<pSkin->m_BoneBoneList[BBIndex].NoOfVerts;	v++)
-				{
-					int VertIndex = pSkin->m_BoneBoneVertexList[ BBVertIndex + v ];
-					float2 VertWeight = pSkin->m_VertexWeights[VertIndex];
-			
-					//	get the inverse for the vertex
-					float3& FinalVertex = m_SoftwareVertexBuffer[ VertIndex ];
-					float3& InverseVertex = m_InverseVertexBuffer[ VertIndex ];
+	//	fill streams, padding is zero
+	m_SkinStreamStride = m_SkinStreamVerts.Size();
+	m_SkinStreams.Resize( m_SkinStreamStride * GSkinStream::Count );
+	m_SkinStreams.SetAll( 0.f );
 
-					//	-1 means use both bones, else, use a particular index
-					int UseBoneIndex = -1;
-					if ( pBone[0] && !pBone[1] )		UseBoneIndex = 0;
-					else if ( !pBone[0] && pBone[1] )	UseBoneIndex = 1;
+	Bool HasNormals = ( m_InverseNormalBuffer.Size() == VertCount );
+	float* pStreams = m_SkinStreams.Data();
+	for ( int i=0;	i<m_SkinStreamStride;	i++ )
+	{
+		int VertIndex = m_SkinStreamVerts[i];
+		if ( VertIndex == -1 )
+			continue;
 
-					//	set to singular bone
-					if ( UseBoneIndex != -1 )
-					{
-						//	transform vertex
-						GMatrix& BoneFinal = m_BoneFinal[ VertBone[UseBoneIndex] ];
-						FinalVertex = InverseVertex;
-						BoneFinal.TransformVector( FinalVertex );
-					}
-					else
-					{
-						//	blend between bones
-						GMatrix& BoneFinalA = m_BoneFinal[ BoneA ];
-						GMatrix& BoneFinalB = m_BoneFinal[ BoneB ];
-						
-						float3 VertexA = InverseVertex;
-						float3 VertexB = InverseVertex;
-						BoneFinalA.TransformVector( VertexA );
-						BoneFinalB.TransformVector( VertexB );
-
-						FinalVertex = VertexA;
-						FinalVertex += VertexB * VertWeight[1];
-					}
-				}
-			}
+		const float3& Pos = m_InverseVertexBuffer[VertIndex];
+		pStreams[ GSkinStream::PosX * m_SkinStreamStride + i ] = Pos.x;
+		pStreams[ GSkinStream::PosY * m_SkinStreamStride + i ] = Pos.y;
+		pStreams[ GSkinStream::PosZ * m_SkinStreamStride + i ] = Pos.z;
 
-			BBVertIndex += pSkin->m_BoneBoneList[BBIndex].NoOfVerts;
+		if ( HasNormals )
+		{
+			const float3& Normal = m_InverseNormalBuffer[VertIndex];
+			pStreams[ GSkinStream::NormalX * m_SkinStreamStride + i ] = Normal.x;
+			pStreams[ GSkinStream::NormalY * m_SkinStreamStride + i ] = Normal.y;
+			pStreams[ GSkinStream::NormalZ * m_SkinStreamStride + i ] = Normal.z;
 		}
 
+		//	weights are swapped if the bones were
+		const float2& Weight = pSkin->m_VertexWeights[VertIndex];
+		Bool Swapped = ( pSkin->m_VertexBones[VertIndex][0] == -1 );
+		pStreams[ GSkinStream::WeightA * m_SkinStreamStride + i ] = Swapped ? Weight[1] : Weight[0];
+		pStreams[ GSkinStream::WeightB * m_SkinStreamStride + i ] = Swapped ? Weight[0] : Weight[1];
 	}
-	else
-	{
-		for ( int v=0;	v<m_SoftwareVertexBuffer.Size();	v++ )
-		{
-			const s82& VertBone = pSkin->m_VertexBones[v];
-			float2 VertWeight = pSkin->m_VertexWeights[v];
+}
 
-			//	get bones
-			GBone* pBone[2] = { NULL, NULL };
-			pBone[0] = VertBone[0] == -1 ? NULL : pSkeleton->GetBoneIndex( VertBone[0] );
-			pBone[1] = VertBone[1] == -1 ? NULL : pSkeleton->GetBoneIndex( VertBone[1] );
 
-			//	neither bone exists
-			if ( !pBone[0] && !pBone[1] )
+//-------------------------------------------------------------------------
+//	skin 4 stream entries with the scalar reference code. does exactly the
+//	same float operations in the same order as the SSE version so results
+//	are identical (when floats are evaluated at float precision, ie. not x87)
+//-------------------------------------------------------------------------
+static void SkinStreamScalar(const float* pStreams, int Stride, int First, const GMatrix* pMatA, const GMatrix* pMatB, const int* pVerts, float3* pOutPos, float3* pOutNormal)
+{
+	for ( int i=First;	i<First+4;	i++ )
+	{
+		int VertIndex = pVerts[i];
+		if ( VertIndex == -1 )
+			continue;
+
+		//	blend matrixes. only need the 3x4 part
+		float m[16];
+		const float* a = &pMatA->m_Matrix[0];
+		if ( pMatB )
+		{
+			const float* b = &pMatB->m_Matrix[0];
+			float wa = pStreams[ GSkinStream::WeightA * Stride + i ];
+			float wb = pStreams[ GSkinStream::WeightB * Stride + i ];
+			for ( int e=0;	e<16;	e++ )
 			{
-				GDebug::Print("Warning: no bones for vertex %d\n",v);
-				continue;
+				if ( ( e & 3 ) == 3 )
+					continue;
+				float ma = wa * a[e];
+				float mb = wb * b[e];
+				m[e] = ma + mb;
 			}
+		}
+		else
+		{
+			for ( int e=0;	e<16;	e++ )
+				m[e] = a[e];
+		}
 
-			u32 BoneChanged[2] = { FALSE, FALSE };
+		float px = pStreams[ GSkinStream::PosX * Stride + i ];
+		float py = pStreams[ GSkinStream::PosY * Stride + i ];
+		float pz = pStreams[ GSkinStream::PosZ * Stride + i ];
+		int r;
+		for ( r=0;	r<3;	r++ )
+		{
+			float x = m[r] * px;
+			float y = m[4+r] * py;
+			float z = m[8+r] * pz;
+			float f = x + y;
+			f = f + z;
+			f = f + m[12+r];
+			pOutPos[VertIndex][r] = f;
+		}
 
-			if ( pBone[0] )	BoneChanged[0] = m_VertexModifiedBones & (1<<((u32)VertBone[0]));
-			if ( pBone[1] )	BoneChanged[1] = m_VertexModifiedBones & (1<<((u32)VertBone[1]));
+		if ( !pOutNormal )
+			continue;
 
-			//	neither bone has changed, vertex doesnt need updated
-			if ( (!BoneChanged[0]) && (!BoneChanged[1]) )
-			{
-			//	GDebug::Print("bones %d and %d not updated\n", VertBone[0], VertBone[1] );
-				continue;
-			}
+		float nx = pStreams[ GSkinStream::NormalX * Stride + i ];
+		float ny = pStreams[ GSkinStream::NormalY * Stride + i ];
+		float nz = pStreams[ GSkinStream::NormalZ * Stride + i ];
+		for ( r=0;	r<3;	r++ )
+		{
+			float x = m[r] * nx;
+			float y = m[4+r] * ny;
+			float z = m[8+r] * nz;
+			float f = x + y;
+			f = f + z;
+			pOutNormal[VertIndex][r] = f;
+		}
+	}
+}
 
-			//	get the inverse for the vertex
-			float3& FinalVertex = m_SoftwareVertexBuffer[ v ];
-			float3& InverseVertex = m_InverseVertexBuffer[ v ];
 
-			//	-1 means use both bones, else, use a particular index
-			int UseBoneIndex = -1;
-			if ( pBone[0] && !pBone[1] )		UseBoneIndex = 0;
-			else if ( !pBone[0] && pBone[1] )	UseBoneIndex = 1;
-		
+#ifdef GSKIN_SSE
 
-			//	set to singular bone
-			if ( UseBoneIndex != -1 )
-			{
-				//	transform vertex
-				GMatrix& BoneFinal = m_BoneFinal[ VertBone[UseBoneIndex] ];
-				FinalVertex = InverseVertex;
-				BoneFinal.TransformVector( FinalVertex );
-			}
-			else
+//-------------------------------------------------------------------------
+//	skin a group of stream entries with SSE, 4 at a time. the bone matrixes
+//	are the same for the whole group so each element is broadcast once,
+//	then blended with each vertex's weights before transforming
+//-------------------------------------------------------------------------
+static void SkinStreamSSE(const float* pStreams, int Stride, const GSkinStreamGroup& Group, const GMatrix* pMatA, const GMatrix* pMatB, const int* pVerts, float3* pOutPos, float3* pOutNormal)
+{
+	int e;
+	__m128 a[16];
+	__m128 b[16];
+	for ( e=0;	e<16;	e++ )
+	{
+		a[e] = _mm_set1_ps( pMatA->m_Matrix[e] );
+		b[e] = _mm_set1_ps( pMatB ? pMatB->m_Matrix[e] : 0.f );
+	}
+
+	const float* pPosX		= &pStreams[ GSkinStream::PosX * Stride ];
+	const float* pPosY		= &pStreams[ GSkinStream::PosY * Stride ];
+	const float* pPosZ		= &pStreams[ GSkinStream::PosZ * Stride ];
+	const float* pNormalX	= &pStreams[ GSkinStream::NormalX * Stride ];
+	const float* pNormalY	= &pStreams[ GSkinStream::NormalY * Stride ];
+	const float* pNormalZ	= &pStreams[ GSkinStream::NormalZ * Stride ];
+	const float* pWeightA	= &pStreams[ GSkinStream::WeightA * Stride ];
+	const float* pWeightB	= &pStreams[ GSkinStream::WeightB * Stride ];
+
+	for ( int i=Group.First;	i<Group.First+Group.Count;	i+=4 )
+	{
+		//	blend matrixes for each of the 4 vertexes
+		__m128 m[16];
+		if ( pMatB )
+		{
+			__m128 wa = _mm_loadu_ps( &pWeightA[i] );
+			__m128 wb = _mm_loadu_ps( &pWeightB[i] );
+			for ( e=0;	e<16;	e++ )
 			{
-				//	blend between bones
-				GMatrix& BoneFinalA = m_BoneFinal[ VertBone[0] ];
-				GMatrix& BoneFinalB = m_BoneFinal[ VertBone[1] ];
-				
-				float3 VertexA = InverseVertex;
-				float3 VertexB = InverseVertex;
-				BoneFinalA.TransformVector( VertexA );
-				BoneFinalB.TransformVector( VertexB );
-
-				FinalVertex = VertexA;
-				FinalVertex += VertexB * VertWeight[1];
+				if ( ( e & 3 ) == 3 )
+					continue;
+				m[e] = _mm_add_ps( _mm_mul_ps( wa, a[e] ), _mm_mul_ps( wb, b[e] ) );
 			}
+		}
+		else
+		{
+			for ( e=0;	e<16;	e++ )
+				m[e] = a[e];
+		}
+
+		float Out[3][4];
+		__m128 px = _mm_loadu_ps( &pPosX[i] );
+		__m128 py = _mm_loadu_ps( &pPosY[i] );
+		__m128 pz = _mm_loadu_ps( &pPosZ[i] );
+		int r;
+		for ( r=0;	r<3;	r++ )
+		{
+			__m128 f = _mm_add_ps( _mm_mul_ps( m[r], px ), _mm_mul_ps( m[4+r], py ) );
+			f = _mm_add_ps( f, _mm_mul_ps( m[8+r], pz ) );
+			f = _mm_add_ps( f, m[12+r] );
+			_mm_storeu_ps( Out[r], f );
+		}
+
+		int j;
+		for ( j=0;	j<4;	j++ )
+		{
+			int VertIndex = pVerts[i+j];
+			if ( VertIndex != -1 )
+				pOutPos[VertIndex] = float3( Out[0][j], Out[1][j], Out[2][j] );
+		}
+
+		if ( !pOutNormal )
+			continue;
+
+		__m128 nx = _mm_loadu_ps( &pNormalX[i] );
+		__m128 ny = _mm_loadu_ps( &pNormalY[i] );
+		__m128 nz = _mm_loadu_ps( &pNormalZ[i] );
+		for ( r=0;	r<3;	r++ )
+		{
+			__m128 f = _mm_add_ps( _mm_mul_ps( m[r], nx ), _mm_mul_ps( m[4+r], ny ) );
+			f = _mm_add_ps( f, _mm_mul_ps( m[8+r], nz ) );
+			_mm_storeu_ps( Out[r], f );
+		}
 
+		for ( j=0;	j<4;	j++ )
+		{
+			int VertIndex = pVerts[i+j];
+			if ( VertIndex != -1 )
+				pOutNormal[VertIndex] = float3( Out[0][j], Out[1][j], Out[2][j] );
 		}
 	}
+}
 
-	//	vertex-bone related data has been updated
-	m_VertexModifiedBones = 0x0;
+#endif
+
+
+//-------------------------------------------------------------------------
+//	update internal vertex buffer if required and set vertex buffer reference to it
+//-------------------------------------------------------------------------
+Bool GSkinShader::SoftwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3>*& pVertexBuffer, GList<float3>*& pNormalBuffer, GList<float2>*& pTextureUVBuffer, GList<float2>*& pTextureUV2Buffer, GList<float3>*& pColourBuffer)
+{
+	GSkin* pSkin = GetSkin();
+	GSkeletonAnim* pAnim = GetAnim();
+
+	if ( !pSkin || !pAnim )
+		return FALSE;
+
+	m_SoftwareSkinned = TRUE;
+
+	//	calc a new inverse buffer if we need it
+	CalcInverseVertexBuffer( *pVertexBuffer, pNormalBuffer );
+
+	if ( m_SoftwareVertexBuffer.Size() != m_InverseVertexBuffer.Size() )
+		m_SoftwareVertexBuffer.Resize( m_InverseVertexBuffer.Size() );
+
+	//	skin normals too if we have them
+	Bool SkinNormals = ( m_InverseNormalBuffer.Size() == m_InverseVertexBuffer.Size() ) && m_InverseNormalBuffer.Size();
+	if ( SkinNormals && m_SoftwareNormalBuffer.Size() != m_InverseNormalBuffer.Size() )
+		m_SoftwareNormalBuffer.Resize( m_InverseNormalBuffer.Size() );
+	
+	//	assign local buffers
+	pVertexBuffer = &m_SoftwareVertexBuffer;
+	if ( SkinNormals )
+		pNormalBuffer = &m_SoftwareNormalBuffer;
 
+	//	update any bones that have been modified before modifying vertex buffer
+	UpdateFinalBones();
 
+	if ( !m_SkinStreamGroups.Size() )
+		BuildSkinStreams( pSkin );
+
+	//	skin vertexes for bones that have changed (may have already been done by BatchUpdate)
+	SkinVertexes();
 
 	return TRUE;
 }
 
 
+//-------------------------------------------------------------------------
+//	skin the vertexes (and normals) of groups whose bones have changed
+//	since they were last skinned
+//-------------------------------------------------------------------------
+void GSkinShader::SkinVertexes()
+{
+	if ( m_VertexModifiedBones.IsEmpty() )
+		return;
+
+	Bool SkinNormals = m_InverseNormalBuffer.Size() && ( m_SoftwareNormalBuffer.Size() == m_InverseNormalBuffer.Size() );
+
+	const float* pStreams = m_SkinStreams.Data();
+	const int* pVerts = m_SkinStreamVerts.Data();
+	float3* pOutPos = m_SoftwareVertexBuffer.Data();
+	float3* pOutNormal = SkinNormals ? m_SoftwareNormalBuffer.Data() : NULL;
+
+	for ( int g=0;	g<m_SkinStreamGroups.Size();	g++ )
+	{
+		const GSkinStreamGroup& Group = m_SkinStreamGroups[g];
+
+		//	bones must exist
+		if ( Group.BoneA >= m_BoneFinal.Size() || Group.BoneB >= m_BoneFinal.Size() )
+			continue;
+
+		//	neither bone has changed, vertexes dont need updating
+		Bool BoneChanged = m_VertexModifiedBones.IsSet( Group.BoneA );
+		if ( Group.BoneB != -1 && m_VertexModifiedBones.IsSet( Group.BoneB ) )
+			BoneChanged = TRUE;
+		if ( !BoneChanged )
+			continue;
+
+		const GMatrix* pMatA = &m_BoneFinal[ Group.BoneA ];
+		const GMatrix* pMatB = ( Group.BoneB == -1 ) ? NULL : &m_BoneFinal[ Group.BoneB ];
+
+		#ifdef GSKIN_SSE
+		if ( !g_ScalarSkinning )
+		{
+			SkinStreamSSE( pStreams, m_SkinStreamStride, Group, pMatA, pMatB, pVerts, pOutPos, pOutNormal );
+			continue;
+		}
+		#endif
+
+		for ( int i=Group.First;	i<Group.First+Group.Count;	i+=4 )
+			SkinStreamScalar( pStreams, m_SkinStreamStride, i, pMatA, pMatB, pVerts, pOutPos, pOutNormal );
+	}
+
+	//	vertex-bone related data has been updated
+	m_VertexModifiedBones.Empty();
+}
+
+
 
 //-------------------------------------------------------------------------
 //	update anim matrixes to the new frame and/or anim
@@ -851,36 +1383,72 @@ Bool GSkinShader::UpdateToNewFrame()
 		}
 	}
 
-	//	get matrixes from anim
+	//	frames to sample the anims at
+	float SampleFrame = m_NewAnimFrame;
+	float BlendSampleFrame = m_BlendAnimNewFrame;
+	float BlendAmount = m_BlendAmount;
+	GSkeletonAnim* pBlendAnim = ( m_Flags & GSkinShaderFlags::BlendAnim ) ? GetBlendAnim() : NULL;
+
+	//	shaders with the same anim poses can share them (and the bone palette) if nothing else changes the bones
+	GPoseCacheKey CacheKey;
+	GPoseCacheEntry* pCachedPose = NULL;
+	Bool UsePoseCache = g_UsePoseCache && m_ValidModifiedRotations.IsEmpty();
+	if ( UsePoseCache )
+	{
+		if ( g_PoseCacheFrameStep > 0.f )
+		{
+			SampleFrame = floorf( SampleFrame / g_PoseCacheFrameStep + 0.5f ) * g_PoseCacheFrameStep;
+			BlendSampleFrame = floorf( BlendSampleFrame / g_PoseCacheFrameStep + 0.5f ) * g_PoseCacheFrameStep;
+		}
+
+		if ( g_PoseCacheBlendStep > 0.f )
+			BlendAmount = floorf( BlendAmount / g_PoseCacheBlendStep + 0.5f ) * g_PoseCacheBlendStep;
+
+		CacheKey.Skeleton		= pSkin->m_Skeleton;
+		CacheKey.Anim			= pAnim->AssetRef();
+		CacheKey.Frame			= SampleFrame;
+		CacheKey.BlendAnim		= pBlendAnim ? pBlendAnim->AssetRef() : GAssetRef_Invalid;
+		CacheKey.BlendFrame		= pBlendAnim ? BlendSampleFrame : 0.f;
+		CacheKey.BlendAmount	= pBlendAnim ? BlendAmount : 0.f;
+
+		pCachedPose = g_PoseCache.Find( CacheKey );
+	}
+
 	float3 ExtractedMovement(0,0,0);
-	pAnim->GetRotations( m_NewAnimFrame, m_AnimRotations, m_ValidAnimRotations, m_AnimFrame, ExtractedMovement );
+	if ( pCachedPose )
+	{
+		m_AnimRotations.Copy( pCachedPose->m_Pose );
+		m_ValidAnimRotations = pCachedPose->m_ValidRotations;
+		ExtractedMovement = pCachedPose->m_ExtractedMovement;
+	}
+	else
+	{
+		//	get matrixes from anim
+		pAnim->GetRotations( SampleFrame, m_AnimRotations, m_ValidAnimRotations, m_AnimFrame, ExtractedMovement, &m_AnimKeyframeCursor );
+	}
 
 	//	blending, blend sets of rotations
-	if ( m_Flags & GSkinShaderFlags::BlendAnim )
+	if ( !pCachedPose && pBlendAnim )
 	{
-		GSkeletonAnim* pBlendAnim = GetBlendAnim();
-		if ( pBlendAnim )
-		{
-			GMatrixRotations BlendAnimRotations;
-			u32 ValidBlendAnimRotations = 0x0;
-			float3 BlendAnimExtractedMotion( 0,0,0 );
+		GAnimPose BlendAnimRotations;
+		GBoneMask ValidBlendAnimRotations;
+		float3 BlendAnimExtractedMotion( 0,0,0 );
 
-			//	get blend anim's rotations
-			pBlendAnim->GetRotations( m_BlendAnimNewFrame, BlendAnimRotations, ValidBlendAnimRotations, m_BlendAnimFrame, BlendAnimExtractedMotion );
+		//	get blend anim's rotations
+		pBlendAnim->GetRotations( BlendSampleFrame, BlendAnimRotations, ValidBlendAnimRotations, m_BlendAnimFrame, BlendAnimExtractedMotion, &m_BlendAnimKeyframeCursor );
 
-			//	blend rotation sets
-			m_AnimRotations.Blend( BlendAnimRotations, m_BlendAmount );
+		//	blend rotation sets
+		m_AnimRotations.Blend( BlendAnimRotations, BlendAmount );
 
-			//	add non identity blend anim info
-			m_ValidAnimRotations |= ValidBlendAnimRotations;
-		}
+		//	add non identity blend anim info
+		m_ValidAnimRotations |= ValidBlendAnimRotations;
 	}
 
 	//	we've got a new list of bones
 	m_LastBoneCounter = m_AnimRotations.Size();
 
 	//	assume all bones have been modified and need to be updated again
-	m_ModifiedBones = (1<<m_LastBoneCounter)-1;
+	m_ModifiedBones.SetFirst( m_LastBoneCounter );
 
 	//	update modified rotations size
 	int ModifiedSize = m_ModifiedRotations.Size();
@@ -890,7 +1458,29 @@ Bool GSkinShader::UpdateToNewFrame()
 		m_ModifiedRotations[i].SetIdentity();
 
 		//	this is now identity
-		m_ValidModifiedRotations &= ~(1<<i);
+		m_ValidModifiedRotations.Clear(i);
+	}
+
+	if ( pCachedPose )
+	{
+		//	bone palette has already been worked out, vertexes still need skinning with it
+		m_BoneFinal.Copy( pCachedPose->m_BoneFinal );
+		m_VertexModifiedBones |= m_ModifiedBones;
+		m_ModifiedBones.Empty();
+		m_SkinnedBoundsValid = FALSE;
+		GIncCounter( PoseCacheHits, 1 );
+	}
+	else if ( UsePoseCache )
+	{
+		//	work out the bone palette now so other shaders can share it
+		UpdateFinalBones( pSkeleton );
+
+		GPoseCacheEntry* pEntry = g_PoseCache.Add( CacheKey );
+		pEntry->m_Pose.Copy( m_AnimRotations );
+		pEntry->m_ValidRotations = m_ValidAnimRotations;
+		pEntry->m_ExtractedMovement = ExtractedMovement;
+		pEntry->m_BoneFinal.Copy( m_BoneFinal );
+		GIncCounter( PoseCacheMisses, 1 );
 	}
 
 	//	changed to new frame
@@ -923,13 +1513,14 @@ Bool GSkinShader::UpdateToNewFrame()
 	return TRUE;
 }
 
-void GSkinShader::UpdateFinalBones()
+void GSkinShader::UpdateFinalBones(GSkeleton* pSkeleton)
 {
 	//	no bones need recalculating
-	if ( !m_ModifiedBones )
+	if ( m_ModifiedBones.IsEmpty() )
 		return;
 
-	GSkeleton* pSkeleton = GetSkeleton();
+	if ( !pSkeleton )
+		pSkeleton = GetSkeleton();
 	if ( !pSkeleton )
 		return;
 
@@ -949,16 +1540,17 @@ void GSkinShader::UpdateFinalBones()
 
 	//	vertexes need updating
 	m_VertexModifiedBones |= m_ModifiedBones;
+	m_SkinnedBoundsValid = FALSE;
 
 	//	bones dont need updating any more
-	m_ModifiedBones = 0x0;
+	m_ModifiedBones.Empty();
 }
 
 
 void GSkinShader::SetModifiedMatrix(int BoneIndex, GMatrix& NewMatrix)
 {
 	Bool IsIdentity = NewMatrix.IsIdentity() ? TRUE : FALSE;
-	Bool WasIdentity = ( m_ValidModifiedRotations & (1<<BoneIndex) ) ? FALSE : TRUE;
+	Bool WasIdentity = m_ValidModifiedRotations.IsSet(BoneIndex) ? FALSE : TRUE;
 
 	//	has it changed?
 	if ( IsIdentity && WasIdentity )
@@ -966,12 +1558,12 @@ void GSkinShader::SetModifiedMatrix(int BoneIndex, GMatrix& NewMatrix)
 
 	//	set is-not-identity flag
 	if ( IsIdentity )
-		m_ValidModifiedRotations &= ~(1<<BoneIndex);
+		m_ValidModifiedRotations.Clear(BoneIndex);
 	else
-		m_ValidModifiedRotations |= (1<<BoneIndex);
+		m_ValidModifiedRotations.Set(BoneIndex);
 
 	//	has been modified
-	m_ModifiedBones |= (1<<BoneIndex);
+	m_ModifiedBones.Set(BoneIndex);
 	
 	//	set child bones of this bone as modified too
 	GSkeleton* pSkeleton = GetSkeleton();
@@ -1082,6 +1674,133 @@ GMesh* GSkinShader::GetMesh(GAssetRef MeshRef)
 	return GAssets::g_Meshes.Find( MeshRef );
 }
 
+//-------------------------------------------------------------------------
+//	find everything BatchUpdate needs on the main thread (asset lookups
+//	may load assets) so BatchUpdate only touches this shader's data
+//-------------------------------------------------------------------------
+Bool GSkinShader::PrepareBatchUpdate()
+{
+	m_pBatchSkeleton = NULL;
+
+	//	skin vertexes now if we were last drawn in software mode (draw mode is reset after drawing) and the buffers are setup
+	m_BatchSkinVertexes = ( m_SoftwareSkinned && m_SkinStreamGroups.Size() && m_SoftwareVertexBuffer.Size() == m_InverseVertexBuffer.Size() );
+
+	//	bones and vertexes are up to date
+	if ( m_ModifiedBones.IsEmpty() && !( m_BatchSkinVertexes && !m_VertexModifiedBones.IsEmpty() ) )
+		return FALSE;
+
+	GSkeleton* pSkeleton = GetSkeleton();
+	if ( !pSkeleton )
+		return FALSE;
+
+	//	skeleton is shared between shaders, make sure it wont change when used
+	pSkeleton->PrepareForThreads();
+	m_pBatchSkeleton = pSkeleton;
+
+	return TRUE;
+}
+
+
+//-------------------------------------------------------------------------
+//	pose evaluation and software skinning. can run at the same time as
+//	other shaders' batch updates
+//-------------------------------------------------------------------------
+void GSkinShader::BatchUpdate()
+{
+	if ( !m_pBatchSkeleton )
+		return;
+
+	UpdateFinalBones( m_pBatchSkeleton );
+
+	if ( m_BatchSkinVertexes )
+		SkinVertexes();
+
+	m_pBatchSkeleton = NULL;
+}
+
+
+//-------------------------------------------------------------------------
+//	move each bone's bounds with its final matrix and put a sphere around
+//	them. only depends on the bone count, not the vertex count
+//-------------------------------------------------------------------------
+GBounds* GSkinShader::GetBounds()
+{
+	//	bones are normally up to date after the batch update
+	UpdateFinalBones();
+
+	if ( m_SkinnedBoundsValid )
+		return &m_SkinnedBounds;
+
+	GSkin* pSkin = GetSkin();
+	GList<GBounds>* pBoneBounds = pSkin ? pSkin->GetBoneBounds() : NULL;
+	if ( !pBoneBounds || pBoneBounds->Size() != m_BoneFinal.Size() )
+		return NULL;
+
+	GList<GBounds>& BoneBounds = *pBoneBounds;
+	float3 Min, Max;
+	int b;
+	int BoneCount = 0;
+
+	//	move the bones' spheres and get a box around them
+	GList<float4> BoneSpheres;
+	BoneSpheres.Resize( BoneBounds.Size() );
+	for ( b=0;	b<BoneBounds.Size();	b++ )
+	{
+		if ( BoneBounds[b].m_Radius < 0.f )
+			continue;
+
+		GMatrix& Mat = m_BoneFinal[b];
+		float3 Centre = BoneBounds[b].m_Offset;
+		Mat.TransformVector( Centre );
+
+		//	allow for scale in the bone matrix
+		float ScaleSq = 0.f;
+		for ( int c=0;	c<3;	c++ )
+		{
+			float3 Column( Mat.m_Matrix[c*4+0], Mat.m_Matrix[c*4+1], Mat.m_Matrix[c*4+2] );
+			if ( Column.LengthSq() > ScaleSq )
+				ScaleSq = Column.LengthSq();
+		}
+		float Radius = BoneBounds[b].m_Radius * sqrtf( ScaleSq );
+
+		BoneSpheres[BoneCount++] = float4( Centre.x, Centre.y, Centre.z, Radius );
+
+		float3 SphereMin = Centre - float3( Radius, Radius, Radius );
+		float3 SphereMax = Centre + float3( Radius, Radius, Radius );
+		if ( BoneCount == 1 )
+		{
+			Min = SphereMin;
+			Max = SphereMax;
+			continue;
+		}
+
+		for ( int a=0;	a<3;	a++ )
+		{
+			if ( SphereMin[a] < Min[a] )	Min[a] = SphereMin[a];
+			if ( SphereMax[a] > Max[a] )	Max[a] = SphereMax[a];
+		}
+	}
+
+	if ( BoneCount == 0 )
+		return NULL;
+
+	//	sphere from the centre of the box that contains all the bones' spheres
+	m_SkinnedBounds.m_Offset = ( Min + Max ) * 0.5f;
+	m_SkinnedBounds.m_Radius = 0.f;
+	for ( b=0;	b<BoneCount;	b++ )
+	{
+		float4& Sphere = BoneSpheres[b];
+		float Distance = ( float3( Sphere.x, Sphere.y, Sphere.z ) - m_SkinnedBounds.m_Offset ).Length() + Sphere.w;
+		if ( Distance > m_SkinnedBounds.m_Radius )
+			m_SkinnedBounds.m_Radius = Distance;
+	}
+
+	m_SkinnedBoundsValid = TRUE;
+
+	return &m_SkinnedBounds;
+}
+
+
 //-------------------------------------------------------------------------
 //	continue animation per frame
 //-------------------------------------------------------------------------
@@ -1104,6 +1823,16 @@ void GSkinShader::Update()
 	if ( ( m_Flags & (GSkinShaderFlags::NewAnim|GSkinShaderFlags::ForceUpdate) ) == 0x0 )
 	{
 		float StepRate = m_AnimSpeed * g_App->FrameDelta60();
+
+		//	hold the pose on frames we're not updating on and catch up with the time on the next update
+		if ( !IsAnimLODFrame() )
+		{
+			m_AnimLODHeldStep += StepRate;
+			return;
+		}
+		StepRate += m_AnimLODHeldStep;
+		m_AnimLODHeldStep = 0.f;
+
 		float Step = ANIMATE_STEP * StepRate;
 
 		//	set new frame no
@@ -1161,11 +1890,49 @@ void GSkinShader::Update()
 		}
 
 	}
+	else
+	{
+		//	forced updates happen straight away, and time held for the old anim is lost
+		m_AnimLODFramesHeld = 0;
+		m_AnimLODHeldStep = 0.f;
+	}
 
 	//	update animation bones
 	UpdateToNewFrame();
 }
 
+
+
+//-------------------------------------------------------------------------
+//	anim LOD n evaluates the pose (and so skins) every 2^n frames. shaders
+//	are spread over the frames by their phase so they dont all update at
+//	once. a pose is never held for longer than its LOD allows, even if the
+//	LOD has just changed
+//-------------------------------------------------------------------------
+Bool GSkinShader::IsAnimLODFrame()
+{
+	m_AnimLOD = 0;
+	if ( g_UseAnimLOD && g_AnimLODViewPosValid && m_pOwner )
+	{
+		float DistanceSq = ( m_pOwner->m_Position - g_AnimLODViewPos ).LengthSq();
+		while ( m_AnimLOD+1 < GSKIN_ANIM_LODS && DistanceSq >= g_AnimLODDistance[m_AnimLOD+1] * g_AnimLODDistance[m_AnimLOD+1] )
+			m_AnimLOD++;
+	}
+
+	int Interval = 1 << m_AnimLOD;
+	if ( ( ( g_AnimLODFrame + m_AnimLODPhase ) & (Interval-1) ) != 0 && m_AnimLODFramesHeld+1 < Interval )
+	{
+		m_AnimLODFramesHeld++;
+		GIncCounter( AnimLODHeldPoses, 1 );
+		return FALSE;
+	}
+
+	m_AnimLODFramesHeld = 0;
+	GStatsTempCounter LODCounter( g_AnimLODCounterNames[m_AnimLOD], 1 );
+
+	return TRUE;
+}
+
 	
 void GSkinShader::SetNewAnim(GAssetRef Anim, float NewFrame)					
 {	
@@ -18,11 +18,16 @@
 #include "GSkeleton.h"
 #include "GAsset.h"
 #include "GSkin.h"
+#include "GPoseCache.h"
+#include "GDisplay.h"
 
 
 
 //	Macros
 //------------------------------------------------
+#define GSKIN_SSE			//	use SSE for software skinning. comment out for compilers without xmmintrin.h
+#define GSKIN_ANIM_LODS		4	//	anim LOD n evaluates the pose every 2^n frames
+
 namespace GSkinHeaderDataFlags
 {
 	const u32	BoneVertexLinks		= 1<<0;	//	list of links from bone->vertex
@@ -38,6 +43,19 @@ namespace GSkinShaderFlags
 	const u32	ForceUpdate			= 1<<2;	//	force it to get new frame
 };
 
+namespace GSkinStream		//	streams in GSkinShader::m_SkinStreams
+{
+	const int	PosX		= 0;
+	const int	PosY		= 1;
+	const int	PosZ		= 2;
+	const int	NormalX		= 3;
+	const int	NormalY		= 4;
+	const int	NormalZ		= 5;
+	const int	WeightA		= 6;
+	const int	WeightB		= 7;
+	const int	Count		= 8;
+};
+
 
 //	Types
 //------------------------------------------------
@@ -69,7 +87,18 @@ typedef struct
 
 
 //-------------------------------------------------------------------------
-//	bone bone struct entry (todo: convert to a single u32)
+//	bone bone struct entry
+//-------------------------------------------------------------------------
+typedef struct 
+{
+	s16		BoneA;
+	s16		BoneB;
+	u16		NoOfVerts;
+
+} GSkinBoneBone;
+
+//-------------------------------------------------------------------------
+//	bone bone struct entry in skins saved before bone indexes were 16 bit
 //-------------------------------------------------------------------------
 typedef struct 
 {
@@ -77,7 +106,20 @@ typedef struct
 	s8		BoneB;
 	u16		NoOfVerts;
 
-} GSkinBoneBone;
+} GSkinBoneBoneS8;
+
+//-------------------------------------------------------------------------
+//	run of software skinning stream entries that all use the same bones.
+//	Count is a multiple of 4 so SSE can do 4 vertexes at once
+//-------------------------------------------------------------------------
+typedef struct 
+{
+	int		BoneA;		//	-1 if no bone
+	int		BoneB;		//	-1 if single bone
+	int		First;		//	first stream entry
+	int		Count;		//	number of entries including padding
+
+} GSkinStreamGroup;
 
 //-------------------------------------------------------------------------
 //	GSkin joins a skeleton to a mesh, contains vertex weights etc
@@ -88,16 +130,22 @@ class GSkin : public GAsset
 {
 public:
 	const static u32	g_Version;
+	const static u32	g_VersionS8Bones;	//	older version with 8 bit bone indexes, still loaded
+	static volatile LONG	g_NextBoneDataID;	//	skins can load on worker threads, so ids are taken with InterlockedIncrement
 
 public:
 	GAssetRef					m_Skeleton;			//	skeleton assigned to this skin
 	GAssetRef					m_Mesh;				//	mesh assigned to this skin
 	GList<float2>				m_VertexWeights;	//	2 weights per vertex. one for each bone
-	GList<s82>					m_VertexBones;		//	2 bones per vertex.
+	GList<s162>					m_VertexBones;		//	2 bones per vertex.
 	GList<GSkinBoneVertexList>	m_BoneVertexList;	//	for each bone, a list of vertexes linked with it
 
 	GList<GSkinBoneBone>		m_BoneBoneList;
 	GList<u32>					m_BoneBoneVertexList;
+	u32							m_BoneDataID;		//	unique id, changed whenever the vertex bones, weights or skeleton ref change so shaders rebuild data made from them (not saved)
+
+protected:
+	GList<GBounds>				m_BoneBounds;		//	bounds of each bone's vertexes relative to the bone (not saved). radius is -1 for bones without vertexes
 	
 public:
 	GSkin();
@@ -106,6 +154,7 @@ public:
 	//	asset virtual
 	virtual GAssetType	AssetType()						{	return GAssetSkin;	};
 	virtual u32			Version()						{	return GSkin::g_Version;	};
+	virtual Bool		SupportsVersion(u32 AssetVersion)	{	return ( AssetVersion == GSkin::g_Version || AssetVersion == GSkin::g_VersionS8Bones );	};
 	virtual Bool		Load(GBinaryData& Data);
 	virtual Bool		Save(GBinaryData& Data);
 
@@ -114,6 +163,8 @@ public:
 	
 	void				GenerateBoneVertexWeights();	//	auto generate weight and vertex-bone links based on vertex positions nearest to bones
 	void				GenerateBoneBoneLists();		//	generate the bone-bone links from the existing bone-vertex link info
+	GList<GBounds>*		GetBoneBounds();				//	per-bone bounds, generated when missing or the skeleton has changed. NULL if there's no mesh or skeleton
+	inline void			NewBoneDataID()					{	m_BoneDataID = (u32)InterlockedIncrement( &g_NextBoneDataID );	};	//	data made from our bone data needs rebuilding
 
 	GSkeleton*			GetSkeleton();
 	GMesh*				GetMesh();
@@ -130,19 +181,53 @@ class GSkinShader : public GShader
 protected:
 	float				m_AnimFrame;				//	current frame in skeleton anim
 	GAssetRef			m_Anim;						//	current skeleton anim
-	GMatrixRotations	m_AnimRotations;
-	u32					m_ValidAnimRotations;		//	bitfield of non-identity matrixes
+	int					m_AnimKeyframeCursor;		//	last keyframe position in the current anim, so playing forward doesnt search for keyframes
+	GAnimPose			m_AnimRotations;			//	current anim (and blend anim) rotations
+	GBoneMask			m_ValidAnimRotations;		//	bitfield of non-identity matrixes
 
 	GMatrixRotations	m_ModifiedRotations;
-	u32					m_ValidModifiedRotations;	//	bitfield of non-identity matrixes
+	GBoneMask			m_ValidModifiedRotations;	//	bitfield of non-identity matrixes
 
-	u32					m_ModifiedBones;			//	bitfield of bones(final matrixes) that need recalculating
-	u32					m_VertexModifiedBones;		//	bitfield of bones that need vertex buffer vertexes recalculating
+	GBoneMask			m_ModifiedBones;			//	bitfield of bones(final matrixes) that need recalculating
+	GBoneMask			m_VertexModifiedBones;		//	bitfield of bones that need vertex buffer vertexes recalculating
 	GList<float3>		m_SoftwareVertexBuffer;		//	local vertex buffer for software mode
+	GList<float3>		m_SoftwareNormalBuffer;		//	local normal buffer for software mode
+	GList<float3>		m_InverseNormalBuffer;		//	cached list of inversed normals for software mode
+
+	GList<float>			m_SkinStreams;			//	SoA streams of inverse positions, normals and weights in skinning group order (see GSkinStream)
+	int						m_SkinStreamStride;		//	floats in each stream
+	GList<int>				m_SkinStreamVerts;		//	vertex index of each stream entry, -1 for padding
+	GList<GSkinStreamGroup>	m_SkinStreamGroups;		//	runs of stream entries using the same bones
+	u32						m_InverseBoneDataID;	//	skin bone data (GSkin::m_BoneDataID) the inverse buffers and streams were made from
+
+	GSkeleton*			m_pBatchSkeleton;			//	skeleton found by PrepareBatchUpdate for BatchUpdate
+	Bool				m_BatchSkinVertexes;		//	BatchUpdate should update the software vertex buffer too
+	Bool				m_SoftwareSkinned;			//	last drawn in software mode
+
+	GBounds				m_SkinnedBounds;			//	bounds of the skinned vertexes for the current bones
+	Bool				m_SkinnedBoundsValid;		//	FALSE when the bones have changed since m_SkinnedBounds was calculated
 
 	GAssetRef			m_Skin;						//	skin (mesh/skeleton)
 
+	int					m_AnimLOD;					//	anim LOD from the last update
+	u32					m_AnimLODPhase;				//	offset into the LOD frame counter so shaders at the same LOD dont all update on the same frame
+	int					m_AnimLODFramesHeld;		//	frames the current pose has been held for
+	float				m_AnimLODHeldStep;			//	anim step saved up while the pose has been held
+
 public:
+	static Bool			g_ScalarSkinning;			//	use the scalar reference version of the SSE software skinning. results are the same
+	static Bool			g_UsePoseCache;				//	share poses and bone palettes between shaders at the same point in the same anims (with no modified rotations)
+	static float		g_PoseCacheFrameStep;		//	sample anims on multiples of this frame step so more shaders share poses. 0 for exact frames
+	static float		g_PoseCacheBlendStep;		//	blend amount step to share poses while blending. 0 for exact blend amounts
+	static GPoseCache	g_PoseCache;				//	poses evaluated this frame, emptied by the world each update
+
+	static Bool			g_UseAnimLOD;				//	evaluate poses less often for shaders far from the view position
+	static float		g_AnimLODDistance[GSKIN_ANIM_LODS];	//	distance from the view position at which each anim LOD starts
+	static float3		g_AnimLODViewPos;			//	position anim LOD distances are from, set when the world is drawn
+	static Bool			g_AnimLODViewPosValid;
+	static u32			g_AnimLODFrame;				//	counted up by the world each update
+	static u32			g_AnimLODNextPhase;
+
 	GList<float3>		m_InverseVertexBuffer;		//	cached list of inversed vertexes
 	GList<GMatrix>		m_BoneFinal;				//	bone transformation for our combined rotations
 
@@ -154,6 +239,7 @@ public:
 	GAssetRef			m_BlendAnim;				//	blend into this anim
 	float				m_BlendAnimFrame;			//	current frame of the blending anim
 	float				m_BlendAnimNewFrame;		//	go to this frame on next frame update for blend
+	int					m_BlendAnimKeyframeCursor;	//	last keyframe position in the blend anim
 	float				m_BlendAmount;				//	interp between current anim and blend anim, when this reaches 1 switch to the blend anim only
 	float				m_BlendRate;				//	increase blend amount by this amount every (whole) frame
 
@@ -165,7 +251,7 @@ public:
 	~GSkinShader();
 
 	//	shader virtual
-	virtual Bool		HardwareVersion()			{	return TRUE;	};
+	virtual Bool		HardwareVersion();				//	FALSE if the skeleton has too many bones for the vertex program
 	virtual Bool		HardwarePreDraw(GMesh* pMesh,GDrawInfo& DrawInfo, GList<float3>*& pVertexBuffer, GList<float3>*& pNormalBuffer, GList<float2>*& pTextureUVBuffer, GList<float2>*& pTextureUV2Buffer, GList<float3>*& pColourBuffer);
 	virtual Bool		HardwarePreDrawVertex(float3& Vertex, float3& Normal, int VertexIndex );
 	virtual Bool		GetVertexProgram(GString& String);
@@ -176,6 +262,9 @@ public:
 	virtual void		PostDraw(GMesh* pMesh,GDrawInfo& DrawInfo);
 
 	virtual void		Update();							//	continue animation
+	virtual Bool		PrepareBatchUpdate();				//	get assets ready for BatchUpdate, returns FALSE if bones and vertexes are up to date
+	virtual void		BatchUpdate();						//	update bones and software skinned vertexes
+	virtual GBounds*	GetBounds();						//	bounds from the per-bone bounds and the current bones
 
 	//	skinning
 	GSkeletonAnim*		GetAnim();
@@ -200,13 +289,17 @@ public:
 	
 	inline Bool			HasAnimRotations()										{	return ( m_AnimRotations.Size() != 0 );	};
 	inline int			RotationCount()											{	return m_AnimRotations.Size();	};
-	inline void			SetAllBonesChanged()									{	m_ModifiedBones = 0xffffffff;	};
+	inline void			SetAllBonesChanged()									{	m_ModifiedBones.SetAll();	};
 	inline void			SetAnimBonesChanged()									{	m_AnimFrame = -1;	};
+	inline int			AnimLOD()												{	return m_AnimLOD;	};
 
 private:
 	Bool				UpdateToNewFrame();										//	updates our anim matrixes. returns if changed
-	void				CalcInverseVertexBuffer( GList<float3>& VertexBuffer );
-	void				UpdateFinalBones();										//	recalculated final bone matrixes as required
+	Bool				IsAnimLODFrame();										//	work out our anim LOD and if the pose should be evaluated this frame
+	void				CalcInverseVertexBuffer( GList<float3>& VertexBuffer, GList<float3>* pNormalBuffer=NULL );	//	normals only needed for software skinning
+	void				BuildSkinStreams(GSkin* pSkin);							//	sort inverse vertexes into SoA streams for software skinning
+	void				UpdateFinalBones(GSkeleton* pSkeleton=NULL);			//	recalculated final bone matrixes as required
+	void				SkinVertexes();											//	update software vertex/normal buffers for bones that have changed
 };
 
 
@@ -218,6 +311,17 @@ private:
 //	Inline Definitions
 //-------------------------------------------------
 
+//-------------------------------------------------------------------------
+//	move each bone's vertex list when a list of them reallocates
+//-------------------------------------------------------------------------
+inline void GMoveData(GSkinBoneVertexList* pNewData, GSkinBoneVertexList* pOldData, int Elements)
+{
+	for ( int i=0;	i<Elements;	i++ )
+	{
+		pNewData[i].Vertexes.TakeData( pOldData[i].Vertexes );
+	}
+}
+
 
 
 
@@ -32,6 +32,8 @@ class GString
 private:
 	GList<char>			m_Chars;
 
+	friend void			GMoveData(GString* pNewData, GString* pOldData, int Elements);
+
 public:
 	GString()									{	};
 	GString(const char* pString)				{	Set( pString );	};
@@ -126,6 +128,17 @@ inline void GCopyData(GString* pNewData, const GString* pOldData, int Elements)
 	}
 }
 
+//-------------------------------------------------------------------------
+//	strings being moved by a list reallocating can just take the old chars
+//-------------------------------------------------------------------------
+inline void GMoveData(GString* pNewData, GString* pOldData, int Elements)
+{
+	for ( int i=0;	i<Elements;	i++ )
+	{
+		pNewData[i].m_Chars.TakeData( pOldData[i].m_Chars );
+	}
+}
+
 
 #endif
 
@@ -242,9 +242,9 @@ Bool GTexture::Load(GBinaryData& Data)
 	//	from the header, allocate data
 	AllocTexture( int2( Header.Width, Header.Height ), Header.TextureFlags );
 
-	//	now read in the blocks of data that follow the header
+	//	now read in the blocks of data that follow the header (or view them if data is mapped)
 	//READ_BLOCK( m_Data.Data(), m_Data.Size() * GDataSizeOf(u8) );
-	if ( !Data.Read( m_Data.Data(), m_Data.DataSize(), "Texture data" ) )
+	if ( !Data.ReadList( m_Data, m_Data.Size(), "Texture data" ) )
 		return FALSE;
 
 	//#undef READ_BLOCK
@@ -0,0 +1,220 @@
+/*------------------------------------------------
+
+  GThreadPool.cpp
+
+	worker threads that split a list of independent jobs
+	between them (and the calling thread)
+
+-------------------------------------------------*/
+
+
+//	Includes
+//------------------------------------------------
+#include "GThreadPool.h"
+#include "GDebug.h"
+
+
+//	globals
+//------------------------------------------------
+GThreadPool GThreadPool::g_ThreadPool;
+
+
+//	Definitions
+//------------------------------------------------
+
+
+GThreadPool::GThreadPool()
+{
+	m_hDoneEvent	= NULL;
+	m_Initialised	= FALSE;
+	m_Quit			= FALSE;
+	m_Busy			= 0;
+	m_NextJob		= 0;
+	m_WorkersDone	= 0;
+	m_JobCount		= 0;
+	m_pJobFunc		= NULL;
+	m_pJobParam		= NULL;
+}
+
+
+GThreadPool::~GThreadPool()
+{
+	Shutdown();
+}
+
+
+//-------------------------------------------------------------------------
+//	start the worker threads
+//-------------------------------------------------------------------------
+Bool GThreadPool::Init(int Threads)
+{
+	Shutdown();
+
+	//	default to a thread for each other processor
+	if ( Threads < 0 )
+	{
+		SYSTEM_INFO SystemInfo;
+		GetSystemInfo( &SystemInfo );
+		Threads = (int)SystemInfo.dwNumberOfProcessors - 1;
+	}
+
+	if ( Threads > GTHREADPOOL_MAX_THREADS )
+		Threads = GTHREADPOOL_MAX_THREADS;
+
+	m_Initialised	= TRUE;
+	m_Quit			= FALSE;
+
+	if ( Threads <= 0 )
+		return TRUE;
+
+	m_hDoneEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+	if ( !m_hDoneEvent )
+	{
+		GDebug_Print("Failed to create thread pool event, jobs will run on the calling thread\n");
+		return FALSE;
+	}
+
+	//	workers are given a pointer to their entry so the list mustn't realloc after this
+	m_Workers.Resize( Threads );
+
+	int Started = 0;
+	for ( int i=0;	i<Threads;	i++ )
+	{
+		GThreadPoolWorker& Worker = m_Workers[Started];
+		Worker.pPool		= this;
+		Worker.hStartEvent	= CreateEvent( NULL, FALSE, FALSE, NULL );
+		Worker.hThread		= NULL;
+
+		if ( Worker.hStartEvent )
+		{
+			DWORD ThreadID = 0;
+			Worker.hThread = CreateThread( NULL, 0, WorkerThread, &Worker, 0, &ThreadID );
+		}
+
+		if ( !Worker.hThread )
+		{
+			GDebug_Print("Failed to create thread pool worker %d\n", i );
+			if ( Worker.hStartEvent )
+				CloseHandle( Worker.hStartEvent );
+			continue;
+		}
+
+		Started++;
+	}
+
+	//	shrinking doesnt realloc, so the started workers' pointers are still valid
+	m_Workers.Resize( Started );
+
+	return ( Started == Threads );
+}
+
+
+//-------------------------------------------------------------------------
+//	stop and close all the worker threads
+//-------------------------------------------------------------------------
+void GThreadPool::Shutdown()
+{
+	int i;
+
+	//	wake up all the workers so they see they should quit
+	m_Quit = TRUE;
+	for ( i=0;	i<m_Workers.Size();	i++ )
+		SetEvent( m_Workers[i].hStartEvent );
+
+	for ( i=0;	i<m_Workers.Size();	i++ )
+	{
+		WaitForSingleObject( m_Workers[i].hThread, INFINITE );
+		CloseHandle( m_Workers[i].hThread );
+		CloseHandle( m_Workers[i].hStartEvent );
+	}
+	m_Workers.Empty();
+
+	if ( m_hDoneEvent )
+	{
+		CloseHandle( m_hDoneEvent );
+		m_hDoneEvent = NULL;
+	}
+
+	m_Initialised = FALSE;
+}
+
+
+//-------------------------------------------------------------------------
+//	run all the jobs across the pool and wait for them to finish
+//-------------------------------------------------------------------------
+void GThreadPool::ParallelFor(int JobCount,GJobFunc pJobFunc,void* pParam)
+{
+	if ( JobCount <= 0 || !pJobFunc )
+		return;
+
+	if ( !m_Initialised )
+		Init();
+
+	//	run on this thread if there's nothing to share the jobs with, or the pool is already busy
+	if ( JobCount == 1 || !m_Workers.Size() || InterlockedExchange( &m_Busy, 1 ) != 0 )
+	{
+		for ( int i=0;	i<JobCount;	i++ )
+			pJobFunc( i, pParam );
+		return;
+	}
+
+	m_JobCount		= JobCount;
+	m_pJobFunc		= pJobFunc;
+	m_pJobParam		= pParam;
+	m_NextJob		= 0;
+	m_WorkersDone	= 0;
+
+	//	start the workers and help out
+	for ( int i=0;	i<m_Workers.Size();	i++ )
+		SetEvent( m_Workers[i].hStartEvent );
+
+	DoJobs();
+
+	//	wait for the workers to finish the jobs they've taken
+	WaitForSingleObject( m_hDoneEvent, INFINITE );
+
+	m_pJobFunc	= NULL;
+	m_pJobParam	= NULL;
+	InterlockedExchange( &m_Busy, 0 );
+}
+
+
+//-------------------------------------------------------------------------
+//	take and run jobs until there are none left
+//-------------------------------------------------------------------------
+void GThreadPool::DoJobs()
+{
+	while ( TRUE )
+	{
+		int JobIndex = InterlockedIncrement( &m_NextJob ) - 1;
+		if ( JobIndex >= m_JobCount )
+			break;
+
+		m_pJobFunc( JobIndex, m_pJobParam );
+	}
+}
+
+
+DWORD WINAPI GThreadPool::WorkerThread(void* pParam)
+{
+	GThreadPoolWorker* pWorker = (GThreadPoolWorker*)pParam;
+	GThreadPool* pPool = pWorker->pPool;
+
+	while ( TRUE )
+	{
+		WaitForSingleObject( pWorker->hStartEvent, INFINITE );
+
+		if ( pPool->m_Quit )
+			break;
+
+		pPool->DoJobs();
+
+		//	last worker to finish wakes up the calling thread
+		if ( InterlockedIncrement( &pPool->m_WorkersDone ) == pPool->m_Workers.Size() )
+			SetEvent( pPool->m_hDoneEvent );
+	}
+
+	return 0;
+}
+
+
@@ -0,0 +1,103 @@
+/*------------------------------------------------
+
+  GThreadPool Header file
+
+	worker threads that split a list of independent jobs
+	between them (and the calling thread)
+
+-------------------------------------------------*/
+
+#ifndef __GTHREADPOOL__H_
+#define __GTHREADPOOL__H_
+
+
+
+//	Includes
+//------------------------------------------------
+#include "GMain.h"
+#include "GList.h"
+
+
+//	Macros
+//------------------------------------------------
+#define GTHREADPOOL_MAX_THREADS		32		//	max worker threads (not including the calling thread)
+
+
+
+//	Types
+//------------------------------------------------
+class GThreadPool;
+
+//-------------------------------------------------------------------------
+//	job function, called once for each index from 0 to JobCount-1. jobs
+//	run on any thread in any order so must not depend on each other
+//-------------------------------------------------------------------------
+typedef void (*GJobFunc)(int JobIndex, void* pParam);
+
+
+//-------------------------------------------------------------------------
+//	a worker thread and the event that starts it on the current jobs
+//-------------------------------------------------------------------------
+typedef struct
+{
+	HANDLE			hThread;
+	HANDLE			hStartEvent;	//	auto-reset, set when there's jobs to do (or we're quitting)
+	GThreadPool*	pPool;
+
+} GThreadPoolWorker;
+
+
+//-------------------------------------------------------------------------
+//	pool of worker threads. ParallelFor blocks until all jobs are done,
+//	the calling thread does jobs too. if the pool is already running jobs
+//	(eg. ParallelFor called from inside a job) the jobs run on the calling thread
+//-------------------------------------------------------------------------
+class GThreadPool
+{
+public:
+	static GThreadPool		g_ThreadPool;	//	global pool, started on first use
+
+protected:
+	GList<GThreadPoolWorker>	m_Workers;
+	HANDLE					m_hDoneEvent;	//	auto-reset, set when the last worker finishes the current jobs
+	Bool					m_Initialised;
+	Bool					m_Quit;			//	workers exit when started with this set
+
+	volatile LONG			m_Busy;			//	non-zero while running jobs
+	volatile LONG			m_NextJob;		//	next job index to take
+	volatile LONG			m_WorkersDone;	//	workers that have finished the current jobs
+	int						m_JobCount;
+	GJobFunc				m_pJobFunc;
+	void*					m_pJobParam;
+
+public:
+	GThreadPool();
+	~GThreadPool();
+
+	Bool				Init(int Threads=-1);		//	start worker threads. -1 for one less than the number of processors (the calling thread makes up the rest)
+	void				Shutdown();					//	stop and close all the worker threads
+	inline int			ThreadCount() const			{	return m_Workers.Size() + 1;	};	//	threads jobs are spread over, including the calling thread
+
+	void				ParallelFor(int JobCount,GJobFunc pJobFunc,void* pParam);	//	run jobs 0..JobCount-1 across the pool and wait for them all to finish
+
+protected:
+	void				DoJobs();					//	take and run jobs until there are none left
+	static DWORD WINAPI	WorkerThread(void* pParam);
+};
+
+
+
+//	Declarations
+//------------------------------------------------
+
+
+
+
+//	Inline Definitions
+//-------------------------------------------------
+
+
+
+
+#endif
+
@@ -53,6 +53,7 @@ typedef Type3<int>		int3;
 typedef Type4<int>		int4;
 
 typedef Type2<s8>		s82;
+typedef Type2<s16>		s162;
 
 typedef Type2<float>	float2;
 typedef Type3<float>	float3;
@@ -16,11 +16,20 @@
 #include "GApp.h"
 #include "GAssetList.h"
 #include "GPhysics.h"
+#include "GBroadphase.h"
+#include "GThreadPool.h"
+#include "GSkin.h"
 
 
 //	globals
 //------------------------------------------------
 GDeclareCounter(GameObjIntersectionTest);
+GDeclareCounter(PhysicsTestCases);
+GDeclareCounter(PhysicsTestCasesCulled);
+GDeclareCounter(PhysicsGatheredObjects);
+GDeclareCounter(PhysicsActiveObjects);
+GDeclareCounter(PhysicsSleepingObjects);
+GDeclareCounter(PhysicsIslands);
 
 
 
@@ -38,6 +47,10 @@ GGameObject::GGameObject()
 	m_Rotation	= GQuaternion();
 	m_Colour	= float4(1,1,1,1);
 	m_ExtractedMovement	= float3(0,0,0);
+
+	m_StepFromPosition	= float3(0,0,0);
+	m_StepFromRotation	= GQuaternion();
+	m_StepInterp		= 1.f;
 	
 	m_SubMapOn	= -1;
 
@@ -98,14 +111,18 @@ GDrawResult GGameObject::Draw(u32 DrawFlags)
 	if ( !pMesh )
 		return GDrawResult_Error;
 
+	//	draw between physics steps
+	float3 Position = RenderPosition();
+	GQuaternion Rotation = RenderRotation();
+
 	//	setup drawinfo
 	GDrawInfo DrawInfo;
 	DrawInfo.Flags			= DrawFlags;
 	DrawInfo.pLight			= NULL;			//	todo
-	DrawInfo.pRotation		= &m_Rotation;
-	DrawInfo.Translation	= m_Position;
+	DrawInfo.pRotation		= &Rotation;
+	DrawInfo.Translation	= Position;
 	DrawInfo.RGBA			= m_Colour;
-	DrawInfo.WorldPos		= m_Position;
+	DrawInfo.WorldPos		= Position;
 	DrawInfo.TextureRef		= m_Texture;
 	DrawInfo.TextureRef2	= GAssetRef_Invalid;
 	DrawInfo.pShader		= m_pShader;
@@ -185,10 +202,40 @@ GSubMap* GGameObject::GetSubmapOn(GWorld* pWorld)
 }
 
 
+//-------------------------------------------------------------------------
+//	physics steps at a fixed rate so draw between the last two steps
+//-------------------------------------------------------------------------
+float3 GGameObject::RenderPosition()
+{
+	if ( m_StepInterp >= 1.f )
+		return m_Position;
+
+	return Interp( m_StepFromPosition, m_Position, m_StepInterp );
+}
+
+
+GQuaternion GGameObject::RenderRotation()
+{
+	if ( m_StepInterp >= 1.f )
+		return m_Rotation;
+
+	return InterpQ( m_StepFromRotation, m_Rotation, m_StepInterp );
+}
+
+
 GBounds& GGameObject::GetBounds()
 {
 	static GBounds TmpBounds( 1.f );
 
+	//	shader moves the vertexes (eg. skinning) so use its bounds
+	GBounds* pShaderBounds = m_pShader ? m_pShader->GetBounds() : NULL;
+	if ( pShaderBounds )
+	{
+		m_Bounds = *pShaderBounds;
+		m_Rotation.RotateVector( m_Bounds.m_Offset );
+		return m_Bounds;
+	}
+
 	//GDebug_Print("Todo: get new bounds from mesh\n");
 
 	return TmpBounds;
@@ -281,7 +328,8 @@ void GWorldRender::Build(GWorld& World, GCamera* pCamera, u32 BasePortal)
 			GBounds& Bounds = pGameObject->GetBounds();
 
 			//	check culling
-			if ( Bounds.IsCulled( pGameObject->m_Position, pCamera ) )
+			float3 Position = pGameObject->RenderPosition();
+			if ( Bounds.IsCulled( Position, pCamera ) )
 			{
 				continue;
 			}
@@ -542,11 +590,32 @@ GWorld::GWorld()
 	m_pSubmapObjectList	= NULL;
 	m_WorldUp			= float3(0,1,0);
 	m_pSkyBox			= NULL;
+	m_pBroadphase		= new GBroadphaseSAP;
+
+	m_FixedPhysicsStep		= TRUE;
+	m_DeterministicPhysics	= FALSE;
+	m_PhysicsStep			= 1.f / FIXED_FRAME_RATEF;
+	m_MaxPhysicsSteps		= 5;
+	m_PhysicsTime			= 0.f;
 }
 
 
 GWorld::~GWorld()
 {
+	GDelete( m_pBroadphase );
+}
+
+
+void GWorld::SetBroadphase(GBroadphase* pBroadphase)
+{
+	if ( !pBroadphase )
+	{
+		GDebug_Break("Cannot set NULL broadphase\n");
+		return;
+	}
+
+	GDelete( m_pBroadphase );
+	m_pBroadphase = pBroadphase;
 }
 
 
@@ -622,32 +691,292 @@ Bool GWorld::AddObjectToSubmapList( GGameObject* pObject, int SubMapIndex )
 
 
 
+//-------------------------------------------------------------------------
+//	job for the thread pool, pParam is the list of shaders to batch update
+//-------------------------------------------------------------------------
+static void BatchUpdateShaderJob(int JobIndex,void* pParam)
+{
+	GList<GShader*>& Shaders = *(GList<GShader*>*)pParam;
+	Shaders[JobIndex]->BatchUpdate();
+}
+
+
 void GWorld::Update()
 {
 	int i;
-	GPhysicsObject* pPhysics;
 
-	//	do phsyics' pre-update
+	//	skin shaders share poses evaluated this frame
+	GSkinShader::g_PoseCache.Empty();
+	GSkinShader::g_AnimLODFrame++;
+
+	//	do objects update
 	for ( i=0;	i<m_ObjectList.Size();	i++ )
 	{
-		pPhysics = m_ObjectList[i]->Physics();
-		if ( pPhysics )
+		m_ObjectList[i]->Update();
+
+		//	update shader
+		if ( m_ObjectList[i]->Shader() )
 		{
-			pPhysics->PreUpdate(this);
-			pPhysics->m_CollisionTestCases.Empty();
+			m_ObjectList[i]->Shader()->Update();
 		}
 	}
 
+	//	batch update shaders with changes (eg. skinning) across threads
+	GList<GShader*> BatchShaders;
+	for ( i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		GShader* pShader = m_ObjectList[i]->Shader();
+		if ( pShader && pShader->PrepareBatchUpdate() )
+			BatchShaders.Add( pShader );
+	}
+	GThreadPool::g_ThreadPool.ParallelFor( BatchShaders.Size(), BatchUpdateShaderJob, &BatchShaders );
+
+	//	step physics
+	float StepInterp = 1.f;
+	if ( m_DeterministicPhysics )
+	{
+		m_PhysicsTime = 0.f;
+		StepPhysics( m_PhysicsStep );
+	}
+	else if ( m_FixedPhysicsStep && m_PhysicsStep > 0.f )
+	{
+		m_PhysicsTime += g_App->FrameDelta();
+
+		int Steps = (int)( m_PhysicsTime / m_PhysicsStep );
+		if ( Steps > m_MaxPhysicsSteps )
+		{
+			Steps = m_MaxPhysicsSteps;
+			m_PhysicsTime = Steps * m_PhysicsStep + fmodf( m_PhysicsTime, m_PhysicsStep );
+		}
+
+		for ( i=0;	i<Steps;	i++ )
+		{
+			StepPhysics( m_PhysicsStep );
+			m_PhysicsTime -= m_PhysicsStep;
+		}
+
+		//	draw objects between their last two steps by the time left over
+		StepInterp = m_PhysicsTime / m_PhysicsStep;
+		if ( StepInterp < 0.f )	StepInterp = 0.f;
+		if ( StepInterp > 1.f )	StepInterp = 1.f;
+	}
+	else
+	{
+		m_PhysicsTime = 0.f;
+		StepPhysics( g_App->FrameDelta() );
+	}
 
-	//	do objects update
 	for ( i=0;	i<m_ObjectList.Size();	i++ )
 	{
-		m_ObjectList[i]->Update();
+		GGameObject* pGameObject = m_ObjectList[i];
+		pGameObject->m_StepInterp = pGameObject->Physics() ? StepInterp : 1.f;
+		pGameObject->UpdateSubMapOn( this );
+	}
+}
 
-		//	update shader
-		if ( m_ObjectList[i]->Shader() )
+
+//-------------------------------------------------------------------------
+//	islands of touching objects are kept as a union-find forest over
+//	world indexes
+//-------------------------------------------------------------------------
+static int FindIsland(GList<int>& Islands, int Index)
+{
+	while ( Islands[Index] != Index )
+	{
+		//	halve the path as we go
+		Islands[Index] = Islands[ Islands[Index] ];
+		Index = Islands[Index];
+	}
+
+	return Index;
+}
+
+
+static void JoinIslands(GList<int>& Islands, int a, int b)
+{
+	a = FindIsland( Islands, a );
+	b = FindIsland( Islands, b );
+
+	//	lower index is the root so islands dont depend on the order they're joined in
+	if ( a < b )
+		Islands[b] = a;
+	else if ( b < a )
+		Islands[a] = b;
+}
+
+
+//-------------------------------------------------------------------------
+//	collide each island's objects with the map and each other. an island's
+//	objects only touch each other so islands can be done on different
+//	threads. objects are done in world order and contacts in the order of
+//	their contact buffers so the results dont depend on the threads
+//-------------------------------------------------------------------------
+typedef struct
+{
+	GPhysicsObject**	ppObjects;
+	const int*			pIslandStart;		//	first entry in pIslandObjects for each island, and the end
+	const int*			pIslandObjects;		//	index in ppObjects of each island's objects
+	int2*				pIslandCollisions;	//	result: collisions tested and resolved on each island
+	int2*				pIslandBVHTests;	//	result: mesh hierarchy node and triangle tests on each island
+	int*				pIslandTestCasesCulled;	//	result: mesh tests skipped by the bounds check on each island
+	float				Delta;
+
+} GNarrowphaseJob;
+
+
+//-------------------------------------------------------------------------
+//	check if a sphere moving by Movement could touch the mesh's bounds.
+//	the mesh hierarchy's root has the bounds, without one we cant cull.
+//	collision doesnt use the map object's rotation yet so neither do we
+//-------------------------------------------------------------------------
+static Bool MovementTouchesMesh(GMeshTestRef& TestRef,float3& From,float3& Movement,float Radius)
+{
+	GMeshBVH& BVH = TestRef.pMesh->m_BVH;
+	if ( !BVH.IsValid() )
+		return TRUE;
+
+	//	sphere around the whole movement against the box
+	float3 Centre = From + Movement * 0.5f;
+	Radius += Movement.Length() * 0.5f;
+
+	float DistSq = 0.f;
+	for ( int a=0;	a<3;	a++ )
+	{
+		float Min = TestRef.Pos[a] + BVH.m_Nodes[0].Min[a];
+		float Max = TestRef.Pos[a] + BVH.m_Nodes[0].Max[a];
+		if ( Centre[a] < Min )			DistSq += ( Min - Centre[a] ) * ( Min - Centre[a] );
+		else if ( Centre[a] > Max )		DistSq += ( Centre[a] - Max ) * ( Centre[a] - Max );
+	}
+
+	return ( DistSq <= Radius * Radius );
+}
+
+
+//-------------------------------------------------------------------------
+//	collide with the meshes gathered for the object. meshes are culled with
+//	the movement we have now, as earlier collisions can speed us up.
+//	pBVHTests and pTestCasesCulled collect counts instead of the stats, for worker threads
+//-------------------------------------------------------------------------
+static void CollidePhysicsWithMeshes(GPhysicsObject* pPhysics,float Delta,int2* pBVHTests,int* pTestCasesCulled)
+{
+	//	the sweep has to start from the same place for every mesh, before any of them move us
+	float3 SweptFrom = pPhysics->GetPosition();
+	float3 SweptMovement = ( pPhysics->m_Velocity + pPhysics->m_Force ) * Delta;
+	Bool Swept = pPhysics->SweptCollision() && ( SweptMovement.LengthSq() > NEAR_ZERO );
+
+	GSweptHit SweptHit;
+	SweptHit.Time = 2.f;
+	int TestCasesCulled = 0;
+
+	for ( int tc=0;	tc<pPhysics->m_CollisionTestCases.Size();	tc++ )
+	{
+		GMeshTestRef& TestRef = pPhysics->m_CollisionTestCases[tc];
+
+		float3 Movement = ( pPhysics->m_Velocity + pPhysics->m_Force ) * Delta;
+		float3 Position = pPhysics->GetPosition();
+
+		//	raycast to mesh, meshpos is relative to mesh
+		if ( MovementTouchesMesh( TestRef, Position, Movement, pPhysics->CollisionRadius() ) )
+			pPhysics->CheckMeshCollision( TestRef.pMesh, TestRef.Pos, Position, Movement, pBVHTests );
+		else
+			TestCasesCulled++;
+
+		//	find the first triangle hit in any mesh
+		if ( Swept && MovementTouchesMesh( TestRef, SweptFrom, SweptMovement, pPhysics->CollisionRadius() ) )
+			pPhysics->CheckMeshCollision( TestRef.pMesh, TestRef.Pos, SweptFrom, SweptMovement, pBVHTests, &SweptHit );
+	}
+
+	if ( pTestCasesCulled )
+		*pTestCasesCulled += TestCasesCulled;
+	else
+		GIncCounter( PhysicsTestCasesCulled, TestCasesCulled );
+
+	if ( SweptHit.Time <= 1.f )
+		pPhysics->DoSweptCollision( SweptFrom, SweptMovement, SweptHit.Time, SweptHit.Normal );
+}
+
+
+static void NarrowphaseIslandJob(int Island,void* pParam)
+{
+	GNarrowphaseJob& Job = *(GNarrowphaseJob*)pParam;
+	int CollisionTests = 0;
+	int Collisions = 0;
+	int2 BVHTests( 0, 0 );
+	int TestCasesCulled = 0;
+
+	for ( int i=Job.pIslandStart[Island];	i<Job.pIslandStart[Island+1];	i++ )
+	{
+		GPhysicsObject* pPhysics = Job.ppObjects[ Job.pIslandObjects[i] ];
+
+		//	check each map collision test
+		CollidePhysicsWithMeshes( pPhysics, Job.Delta, &BVHTests, &TestCasesCulled );
+
+		//	resolve the objects we're touching
+		for ( int c=0;	c<pPhysics->m_Contacts.Size();	c++ )
 		{
-			m_ObjectList[i]->Shader()->Update();
+			GPhysicsObject* pOther = pPhysics->m_Contacts[c];
+
+			//	resting against a sleeping object doesnt wake it up
+			if ( pOther->IsSleeping() )
+			{
+				float3 Movement = pPhysics->m_Velocity + pPhysics->m_Force;
+				if ( Movement.LengthSq() < GPhysicsObject::g_SleepSpeed * GPhysicsObject::g_SleepSpeed )
+					continue;
+
+				pOther->Wake();
+			}
+
+			CollisionTests++;
+			if ( GPhysicsObject::ProcessCollision( pPhysics, pOther ) )
+				Collisions++;
+		}
+
+		//	call overloaded post iteration func				
+		pPhysics->PostIteration();
+	}
+
+	Job.pIslandCollisions[Island] = int2( CollisionTests, Collisions );
+	Job.pIslandBVHTests[Island] = BVHTests;
+	Job.pIslandTestCasesCulled[Island] = TestCasesCulled;
+}
+
+
+//-------------------------------------------------------------------------
+//	move all the physics objects on by Delta seconds and collide them
+//-------------------------------------------------------------------------
+void GWorld::StepPhysics(float Delta)
+{
+	int i;
+	GPhysicsObject* pPhysics;
+
+	GPhysicsObject::g_StepDelta = Delta;
+
+	GList<GPhysicsObject*> SleepingObjects;
+	GList<int> Islands;
+	Islands.Resize( m_ObjectList.Size() );
+
+	//	do phsyics' pre-update
+	for ( i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		Islands[i] = i;
+
+		pPhysics = m_ObjectList[i]->Physics();
+		if ( pPhysics )
+		{
+			m_ObjectList[i]->m_StepFromPosition = m_ObjectList[i]->m_Position;
+			m_ObjectList[i]->m_StepFromRotation = m_ObjectList[i]->m_Rotation;
+
+			pPhysics->m_CollisionTestCases.Empty();
+			pPhysics->m_BroadphaseID = i;
+
+			//	sleeping objects are only in the broadphase, so moving objects can wake them
+			if ( !pPhysics->CheckWake() )
+			{
+				SleepingObjects.Add( pPhysics );
+				continue;
+			}
+
+			pPhysics->PreUpdate(this);
 		}
 	}
 
@@ -663,52 +992,163 @@ void GWorld::Update()
 		//	check each physics collision test
 
 		GList<int> RemovePhysicsObjectIndexes;
+		GList<GBroadphaseObject> BroadphaseObjects;
+		GList<int> BroadphaseIndexes;		//	index in PhysicsObjects for each broadphase id
+		GList<int> PairListStart;
+		GList<int> PairList;
+		GList<int> IslandIndexes;			//	island number of each island root
+		GList<int> ObjectIslands;			//	island number of each object in PhysicsObjects
+		GList<int> IslandStart;				//	first entry in IslandObjects for each island
+		GList<int> IslandFill;
+		GList<int> IslandObjects;			//	index in PhysicsObjects of each island's objects
+		GList<int2> IslandCollisions;		//	collisions tested and resolved on each island
+		GList<int2> IslandBVHTests;			//	mesh hierarchy node and triangle tests on each island
+		GList<int> IslandTestCasesCulled;	//	mesh tests skipped by the bounds check on each island
 		int Iteration = 0;
 
 		while ( PhysicsObjects.Size() > 0 )
 		{
-			for ( int po=0;	po<PhysicsObjects.Size();	po++ )
-			{
-				GPhysicsObject* pPhysics = PhysicsObjects[po];
+			//	put the remaining objects' bounds into the broadphase. bounds are grown by
+			//	how far the object could move (or be pushed out of meshes) this iteration
+			BroadphaseObjects.Resize( PhysicsObjects.Size() + SleepingObjects.Size() );
+			BroadphaseIndexes.Resize( m_ObjectList.Size() );
+			BroadphaseIndexes.SetAll( -1 );
 
-				//	check each map collision test
-				for ( int tc=0;	tc<pPhysics->m_CollisionTestCases.Size();	tc++ )
-				{
-					GMeshTestRef& TestRef = pPhysics->m_CollisionTestCases[tc];
+			for ( int bo=0;	bo<PhysicsObjects.Size();	bo++ )
+			{
+				GPhysicsObject* pPhysics = PhysicsObjects[bo];
+				GBounds& Bounds = pPhysics->m_pOwner->GetBounds();
+				float3 Centre = pPhysics->m_pOwner->m_Position + Bounds.m_Offset;
+				float3 Movement = ( pPhysics->m_Velocity + pPhysics->m_Force ) * Delta;
+				float Radius = Bounds.m_Radius + Movement.Length() + pPhysics->CollisionRadius();
+
+				GBroadphaseObject& Object = BroadphaseObjects[bo];
+				Object.ID	= pPhysics->m_BroadphaseID;
+				Object.Min	= Centre - float3( Radius, Radius, Radius );
+				Object.Max	= Centre + float3( Radius, Radius, Radius );
+
+				BroadphaseIndexes[ Object.ID ] = bo;
+			}
 
-					float3 Movement = ( pPhysics->m_Velocity + pPhysics->m_Force ) * g_App->FrameDelta();
-										
-					//if ( Movement.LengthSq() < NEAR_ZERO )
-					//	continue;
+			//	sleeping (or just woken) objects are marked with -2
+			for ( int so=0;	so<SleepingObjects.Size();	so++ )
+			{
+				GPhysicsObject* pPhysics = SleepingObjects[so];
+				GBounds& Bounds = pPhysics->m_pOwner->GetBounds();
+				float3 Centre = pPhysics->m_pOwner->m_Position + Bounds.m_Offset;
+				float Radius = Bounds.m_Radius + pPhysics->CollisionRadius();
 
-					float3 Position = pPhysics->GetPosition();
+				GBroadphaseObject& Object = BroadphaseObjects[ PhysicsObjects.Size() + so ];
+				Object.ID	= pPhysics->m_BroadphaseID;
+				Object.Min	= Centre - float3( Radius, Radius, Radius );
+				Object.Max	= Centre + float3( Radius, Radius, Radius );
 
-					//	todo: check bounds
+				BroadphaseIndexes[ Object.ID ] = -2;
+			}
 
-					//	raycast to mesh, meshpos is relative to mesh
-					pPhysics->CheckMeshCollision( TestRef.pMesh, TestRef.Pos, Position, Movement );
-				}
+			m_pBroadphase->Update( BroadphaseObjects );
+			m_pBroadphase->GetPairLists( m_ObjectList.Size(), PairListStart, PairList );
 
+			//	find what each object is touching and join touching objects into islands
+			int po;
+			for ( po=0;	po<PhysicsObjects.Size();	po++ )
+			{
+				GPhysicsObject* pPhysics = PhysicsObjects[po];
+				pPhysics->m_Contacts.Empty();
 
-				//	check inter-object collision
-				//	todo: reduce to objects in this submap
-				for ( int obj=0;	obj<PhysicsObjects.Size();	obj++ )
+				//	check inter-object collision against objects the broadphase says we might touch
+				int ID = pPhysics->m_BroadphaseID;
+				for ( int p=PairListStart[ID];	p<PairListStart[ID+1];	p++ )
 				{
-					if ( obj == po )
+					int OtherID = PairList[p];
+					int obj = BroadphaseIndexes[ OtherID ];
+					if ( obj == -1 )
+						continue;
+
+					GPhysicsObject* pOther = ( obj == -2 ) ? m_ObjectList[OtherID]->Physics() : PhysicsObjects[obj];
+					if ( !GGameObject::CheckIntersection( pPhysics->m_pOwner, pOther->m_pOwner ) )
 						continue;
 
-					if ( GGameObject::CheckIntersection( pPhysics->m_pOwner, PhysicsObjects[obj]->m_pOwner ) )
+					//	touching objects are resolved (and settle and sleep) together
+					JoinIslands( Islands, ID, OtherID );
+
+					//	contacts are resolved in world order
+					int c = pPhysics->m_Contacts.Size();
+					pPhysics->m_Contacts.Add( pOther );
+					while ( c > 0 && pPhysics->m_Contacts[c-1]->m_BroadphaseID > OtherID )
 					{
-						GPhysicsObject::ProcessCollision( pPhysics, PhysicsObjects[obj] );
+						pPhysics->m_Contacts[c] = pPhysics->m_Contacts[c-1];
+						pPhysics->m_Contacts[c-1] = pOther;
+						c--;
 					}
 				}
-		
+			}
 
-				//	call overloaded post iteration func				
-				pPhysics->PostIteration();
+			//	list this iteration's objects by island (counting sort, so they stay in world order)
+			IslandIndexes.Resize( m_ObjectList.Size() );
+			IslandIndexes.SetAll( -1 );
+			ObjectIslands.Resize( PhysicsObjects.Size() );
+			int IslandCount = 0;
+			for ( po=0;	po<PhysicsObjects.Size();	po++ )
+			{
+				int Root = FindIsland( Islands, PhysicsObjects[po]->m_BroadphaseID );
+				if ( IslandIndexes[Root] == -1 )
+					IslandIndexes[Root] = IslandCount++;
+				ObjectIslands[po] = IslandIndexes[Root];
+			}
 
-				//	no more iterations for this object? remove from list
-				if ( Iteration+1 >= pPhysics->CollisionIterations() )
+			IslandStart.Resize( IslandCount+1 );
+			IslandStart.SetAll( 0 );
+			for ( po=0;	po<PhysicsObjects.Size();	po++ )
+				IslandStart[ ObjectIslands[po]+1 ]++;
+			for ( int is=0;	is<IslandCount;	is++ )
+				IslandStart[is+1] += IslandStart[is];
+
+			IslandObjects.Resize( PhysicsObjects.Size() );
+			IslandFill.Copy( IslandStart );
+			for ( po=0;	po<PhysicsObjects.Size();	po++ )
+				IslandObjects[ IslandFill[ ObjectIslands[po] ]++ ] = po;
+
+			//	islands dont touch each other, so they can be resolved at the same time
+			IslandCollisions.Resize( IslandCount );
+			IslandBVHTests.Resize( IslandCount );
+			IslandTestCasesCulled.Resize( IslandCount );
+
+			GNarrowphaseJob Job;
+			Job.ppObjects			= PhysicsObjects.Data();
+			Job.pIslandStart		= IslandStart.Data();
+			Job.pIslandObjects		= IslandObjects.Data();
+			Job.pIslandCollisions	= IslandCollisions.Data();
+			Job.pIslandBVHTests		= IslandBVHTests.Data();
+			Job.pIslandTestCasesCulled	= IslandTestCasesCulled.Data();
+			Job.Delta				= Delta;
+			GThreadPool::g_ThreadPool.ParallelFor( IslandCount, NarrowphaseIslandJob, &Job );
+
+			//	stats aren't thread safe so the jobs' counts are added up here
+			int CollisionTests = 0;
+			int Collisions = 0;
+			int BVHNodeTests = 0;
+			int BVHTriangleTests = 0;
+			int TestCasesCulled = 0;
+			for ( int ic=0;	ic<IslandCount;	ic++ )
+			{
+				CollisionTests += IslandCollisions[ic][0];
+				Collisions += IslandCollisions[ic][1];
+				BVHNodeTests += IslandBVHTests[ic][0];
+				BVHTriangleTests += IslandBVHTests[ic][1];
+				TestCasesCulled += IslandTestCasesCulled[ic];
+			}
+			GIncCounter( PhysicsCollisionTest, CollisionTests );
+			GIncCounter( PhysicsCollisionSuccess, Collisions );
+			GIncCounter( PhysicsIslands, IslandCount );
+			GIncCounter( MeshBVHNodeTests, BVHNodeTests );
+			GIncCounter( MeshBVHTriangleTests, BVHTriangleTests );
+			GIncCounter( PhysicsTestCasesCulled, TestCasesCulled );
+
+			//	no more iterations for these objects? remove from list
+			for ( po=0;	po<PhysicsObjects.Size();	po++ )
+			{
+				if ( Iteration+1 >= PhysicsObjects[po]->CollisionIterations() )
 					RemovePhysicsObjectIndexes.Add( po );
 			}
 
@@ -722,26 +1162,201 @@ void GWorld::Update()
 			//	next iteration
 			Iteration++;
 		}
+
+		//	sleeping objects woken by a contact missed the pre-update and mesh tests. collide them
+		//	with the meshes now so the hit that woke them cant push them into the map
+		GList<GPhysicsObject*> WokenObjects;
+		for ( i=0;	i<SleepingObjects.Size();	i++ )
+		{
+			pPhysics = SleepingObjects[i];
+			if ( pPhysics->IsSleeping() )
+				continue;
+
+			pPhysics->PreUpdate(this);
+			WokenObjects.Add( pPhysics );
+		}
+
+		if ( WokenObjects.Size() )
+		{
+			GatherPhysicsTestCases( WokenObjects, TRUE );
+
+			for ( i=0;	i<WokenObjects.Size();	i++ )
+			{
+				CollidePhysicsWithMeshes( WokenObjects[i], Delta, NULL, NULL );
+				WokenObjects[i]->PostIteration();
+			}
+		}
 	}
 
 	//	do physics post update
 	for ( i=0;	i<m_ObjectList.Size();	i++ )
 	{
 		pPhysics = m_ObjectList[i]->Physics();
-		if ( pPhysics )
+		if ( pPhysics && !pPhysics->IsSleeping() )
+		{
 			pPhysics->PostUpdate(this);
-		
-		m_ObjectList[i]->UpdateSubMapOn( this );
+			pPhysics->UpdateSettle( m_ObjectList[i]->m_StepFromPosition );
+			m_ObjectList[i]->UpdateSubMapOn( this );
+		}
+	}
+
+	//	objects go to sleep when everything on their island has settled
+	GList<u8> IslandAwake;
+	IslandAwake.Resize( m_ObjectList.Size() );
+	IslandAwake.SetAll( 0 );
+	for ( i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		pPhysics = m_ObjectList[i]->Physics();
+		if ( pPhysics && !pPhysics->IsSleeping() && !pPhysics->IsSettled() )
+			IslandAwake[ FindIsland( Islands, i ) ] = 1;
+	}
+
+	int Active = 0;
+	int Sleeping = 0;
+	for ( i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		pPhysics = m_ObjectList[i]->Physics();
+		if ( !pPhysics )
+			continue;
+
+		if ( !pPhysics->IsSleeping() && !IslandAwake[ FindIsland( Islands, i ) ] )
+			pPhysics->Sleep();
+
+		if ( pPhysics->IsSleeping() )
+			Sleeping++;
+		else
+			Active++;
+	}
+
+	GIncCounter( PhysicsActiveObjects, Active );
+	GIncCounter( PhysicsSleepingObjects, Sleeping );
+}
+
+
+//-------------------------------------------------------------------------
+//	wake up sleeping objects in this box, eg. when map geometry there has changed
+//-------------------------------------------------------------------------
+void GWorld::WakePhysicsObjects(const float3& Min, const float3& Max)
+{
+	for ( int i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		GPhysicsObject* pPhysics = m_ObjectList[i]->Physics();
+		if ( !pPhysics || !pPhysics->IsSleeping() )
+			continue;
+
+		float3 Pos = pPhysics->GetPosition();
+		float Radius = pPhysics->CollisionRadius();
+		if ( Pos.x + Radius < Min.x || Pos.y + Radius < Min.y || Pos.z + Radius < Min.z ||
+			Pos.x - Radius > Max.x || Pos.y - Radius > Max.y || Pos.z - Radius > Max.z )
+			continue;
+
+		pPhysics->Wake();
+	}
+}
+
+
+//-------------------------------------------------------------------------
+//	wake up sleeping objects touching a mapobject's mesh
+//-------------------------------------------------------------------------
+void GWorld::WakePhysicsObjects(GAssetRef MapObjectRef)
+{
+	GMapObject* pMapObject = GAssets::g_MapObjects.Find( MapObjectRef );
+	if ( !pMapObject )
+		return;
+
+	GMesh* pMesh = pMapObject->GetMesh();
+	if ( !pMesh )
+		return;
+
+	//	collision doesnt use the map object's rotation yet so neither do we
+	float3 Min, Max;
+	pMesh->GetVertexMinMax( Min, Max );
+	WakePhysicsObjects( Min + pMapObject->m_Position, Max + pMapObject->m_Position );
+}
+
+
+//-------------------------------------------------------------------------
+//	change the map's geometry. the submap's own functions dont know about
+//	the world, so go through these to wake up anything sleeping there
+//-------------------------------------------------------------------------
+void GWorld::AddMapObject(int SubMapIndex, GAssetRef MapObjectRef)
+{
+	if ( !m_pMap || SubMapIndex < 0 || SubMapIndex >= m_pMap->m_SubMaps.Size() )
+	{
+		GDebug_Break("Invalid submap index %d\n", SubMapIndex );
+		return;
+	}
+
+	m_pMap->m_SubMaps[SubMapIndex]->AddMapObject( MapObjectRef );
+	WakePhysicsObjects( MapObjectRef );
+}
+
+
+void GWorld::RemoveMapObject(int SubMapIndex, GAssetRef MapObjectRef)
+{
+	if ( !m_pMap || SubMapIndex < 0 || SubMapIndex >= m_pMap->m_SubMaps.Size() )
+	{
+		GDebug_Break("Invalid submap index %d\n", SubMapIndex );
+		return;
 	}
 
+	m_pMap->m_SubMaps[SubMapIndex]->RemoveMapObject( MapObjectRef );
+	WakePhysicsObjects( MapObjectRef );
+}
+
+
+Bool GWorld::ChangeMapObjectRef(int SubMapIndex, GAssetRef MapObjectRef, GAssetRef NewRef)
+{
+	if ( !m_pMap || SubMapIndex < 0 || SubMapIndex >= m_pMap->m_SubMaps.Size() )
+	{
+		GDebug_Break("Invalid submap index %d\n", SubMapIndex );
+		return FALSE;
+	}
+
+	if ( !m_pMap->m_SubMaps[SubMapIndex]->ChangeMapObjectRef( MapObjectRef, NewRef ) )
+		return FALSE;
+
+	WakePhysicsObjects( MapObjectRef );
+	WakePhysicsObjects( NewRef );
+	return TRUE;
 }
 
 //-------------------------------------------------------------------------
 //	gather the map's mesh test cases for the physics objects. this is so
-//	we dont have to recalc which meshes we want to test for multiple iterations
+//	we dont have to recalc which meshes we want to test for multiple iterations.
+//	each object gets every mesh on its submaps, they're culled when tested
 //-------------------------------------------------------------------------
-void GWorld::GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects)
+void GWorld::GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects, Bool OnlyListed)
 {
+	int i;
+
+	//	whether we're gathering for each physics object (indexed by broadphase id) and whether it's been gathered yet
+	GList<u8> Wanted;
+	GList<u8> Gathered;
+	Wanted.Resize( m_ObjectList.Size() );
+	Wanted.SetAll( 0 );
+	Gathered.Resize( m_ObjectList.Size() );
+	Gathered.SetAll( 0 );
+
+	if ( OnlyListed )
+	{
+		for ( i=0;	i<PhysicsObjects.Size();	i++ )
+			Wanted[ PhysicsObjects[i]->m_BroadphaseID ] = 1;
+	}
+
+	for ( i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		GPhysicsObject* pPhysics = m_ObjectList[i]->Physics();
+		if ( !pPhysics )
+			continue;
+
+		if ( !OnlyListed )
+			Wanted[i] = !pPhysics->IsSleeping();
+	}
+
+	//	meshes are culled when they're tested, once we know how fast the object is going
+	int TestCases = 0;
+
 	for ( int sm=0;	sm<m_pMap->m_SubMaps.Size();	sm++ )
 	{
 		GSubMap* pSubMap = m_pMap->m_SubMaps[sm];
@@ -750,6 +1365,14 @@ void GWorld::GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects)
 
 		if ( !SubMapObjCount )
 			continue;
+
+		//	every awake object on a submap is simulated, even if it's not near any meshes
+		for ( int go=0;	go<SubMapObjCount;	go++ )
+		{
+			GPhysicsObject* pPhysics = SubMapObjList.ElementAt(go)->Physics();
+			if ( pPhysics && Wanted[ pPhysics->m_BroadphaseID ] )
+				Gathered[ pPhysics->m_BroadphaseID ] = 1;
+		}
 		
 		//	check each mapobject
 		for ( int mo=0;	mo<pSubMap->m_MapObjects.Size();	mo++)
@@ -758,44 +1381,88 @@ void GWorld::GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects)
 			if ( !pMapObject )
 				continue;
 
-			//	todo: check bounds intersection
-
 			//	todo: try gettings collision mesh first
 
 			GMesh* pMapObjectMesh = pMapObject->GetMesh();
 			if ( !pMapObjectMesh )
 				continue;
 
-			float3 MeshPos = pMapObject->m_Position;
+			//	collision needs triangle planes. reported here as mesh tests can run on worker threads
+			GMeshBVH& BVH = pMapObjectMesh->m_BVH;
+			if ( !( BVH.IsValid() && BVH.HasPlanes() ) &&
+				( pMapObjectMesh->m_TrianglePlanes.Size() < pMapObjectMesh->TriCount() || pMapObjectMesh->m_TriStripPlanes.Size() < pMapObjectMesh->TriStripCount() ) )
+			{
+				GDebug_Print("Mesh is missing triangle planes, physics objects won't collide with it\n");
+				continue;
+			}
 
 			GMeshTestRef TestRef;
 			TestRef.pMesh = pMapObjectMesh;
-			TestRef.Pos = MeshPos;
+			TestRef.Pos = pMapObject->m_Position;
 
 			for ( int go=0;	go<SubMapObjCount;	go++ )
 			{
 				GGameObject* pGameObject = SubMapObjList.ElementAt(go);
 				GPhysicsObject* pPhysics = pGameObject->Physics();
-				if ( !pPhysics )
+				if ( !pPhysics || !Wanted[ pPhysics->m_BroadphaseID ] )
 					continue;
-				
-				//	todo: check some stuff here
-
-				
-				//	todo: this will be slow! sort pointer addresses?
-
-				//	add to list if its not already in there 
-				if ( !PhysicsObjects.Exists( pPhysics ) )
-				{
-					PhysicsObjects.Add( pPhysics );
-					PhysicsObjects.Sort();
-				}
 
 				pPhysics->m_CollisionTestCases.Add( TestRef );
+				TestCases++;
 			}
 		}
 	}
 
+	GIncCounter( PhysicsTestCases, TestCases );
+
+	if ( OnlyListed )
+		return;
+
+	//	objects in world order rather than pointer order so results dont depend on where objects were allocated
+	PhysicsObjects.Empty();
+	for ( i=0;	i<Gathered.Size();	i++ )
+		if ( Gathered[i] )
+			PhysicsObjects.Add( m_ObjectList[i]->Physics() );
+
+	GIncCounter( PhysicsGatheredObjects, PhysicsObjects.Size() );
+}
+
+
+//-------------------------------------------------------------------------
+//	hash the bits of every physics object's position, rotation and velocity.
+//	two runs with the same input and m_DeterministicPhysics should match
+//-------------------------------------------------------------------------
+u32 GWorld::PhysicsChecksum()
+{
+	u32 Hash = 2166136261u;
+	for ( int i=0;	i<m_ObjectList.Size();	i++ )
+	{
+		GGameObject* pGameObject = m_ObjectList[i];
+		GPhysicsObject* pPhysics = pGameObject->Physics();
+		if ( !pPhysics )
+			continue;
+
+		float State[10];
+		State[0] = pGameObject->m_Position.x;
+		State[1] = pGameObject->m_Position.y;
+		State[2] = pGameObject->m_Position.z;
+		State[3] = pGameObject->m_Rotation.xyzw.x;
+		State[4] = pGameObject->m_Rotation.xyzw.y;
+		State[5] = pGameObject->m_Rotation.xyzw.z;
+		State[6] = pGameObject->m_Rotation.xyzw.w;
+		State[7] = pPhysics->m_Velocity.x;
+		State[8] = pPhysics->m_Velocity.y;
+		State[9] = pPhysics->m_Velocity.z;
+
+		const u8* pBytes = (const u8*)State;
+		for ( int b=0;	b<(int)sizeof(State);	b++ )
+		{
+			Hash ^= pBytes[b];
+			Hash *= 16777619u;
+		}
+	}
+
+	return Hash;
 }
 
 
@@ -818,6 +1485,10 @@ Bool GWorld::AddObject(GGameObject* pObject)
 
 void GWorld::Draw(GCamera& Camera, u32 DrawFlags)
 {
+	//	skin shaders' anim LOD is from the last camera we were drawn with
+	GSkinShader::g_AnimLODViewPos = Camera.m_Position;
+	GSkinShader::g_AnimLODViewPosValid = TRUE;
+
 	//	create a world render to put everything into
 	GWorldRender WorldRender;
 
@@ -42,6 +42,7 @@ class GGameObject;
 class GWorld;
 class GPhysicsObject;
 class GShader;
+class GBroadphase;
 typedef GList<GGameObject*> GGameObjectList;
 
 
@@ -63,9 +64,14 @@ public:
 
 	float3			m_ExtractedMovement;	//	movement last extracted (zero after use), set by physics etc
 
+	float3			m_StepFromPosition;		//	position before the last physics step
+	GQuaternion		m_StepFromRotation;		//	rotation before the last physics step
+	float			m_StepInterp;			//	how far between the step from position/rotation and the current ones to draw. 1 draws the current ones
+
 private:
 	GShader*		m_pShader;		//	
 	GPhysicsObject*	m_pPhysics;		//	
+	GBounds			m_Bounds;		//	shader's bounds rotated to match the object
 
 public:
 	GGameObject();
@@ -88,6 +94,8 @@ public:
 	const GShader*			Shader() const 					{	return m_pShader;	};
 	const GPhysicsObject*	Physics() const 				{	return m_pPhysics;	};
 
+	float3			RenderPosition();						//	position to draw at, interpolated between physics steps
+	GQuaternion		RenderRotation();						//	rotation to draw with, interpolated between physics steps
 	GBounds&		GetBounds();							//	
 	GMesh*			GetMesh();								//	
 	GTexture*		GetTexture();							//	
@@ -112,6 +120,15 @@ public:
 	float3					m_WorldUp;						//	world up vector (usually 0,1,0)
 	GSkyBox*				m_pSkyBox;
 
+	Bool					m_FixedPhysicsStep;				//	step physics by m_PhysicsStep as many times as the elapsed time allows. else step once by the frame delta
+	Bool					m_DeterministicPhysics;			//	step physics exactly once by m_PhysicsStep each update, ignoring the frame delta, so the same input gives the same results
+	float					m_PhysicsStep;					//	seconds in each fixed physics step
+	int						m_MaxPhysicsSteps;				//	most fixed steps in one update. time beyond this is dropped so a slow frame can't cause a slower one
+
+protected:
+	GBroadphase*			m_pBroadphase;					//	finds pairs of physics objects that need to be tested against each other
+	float					m_PhysicsTime;					//	elapsed time not stepped yet
+
 public:
 	GWorld();
 	~GWorld();
@@ -130,12 +147,21 @@ public:
 	inline int			SubmapOn(float3& Position)				{	return m_pMap ? m_pMap->SubmapOn(Position) : -1;	};	//	get submap index for this position (world space)
 	inline int			SubmapNearest(float3& Position)			{	return m_pMap ? m_pMap->SubmapNearest(Position) : -1;	};	//	get submap index for this position (world space)
 	inline GMapLight*	GetLight(float3& Pos, int Submap=-1)	{	return m_pMap ? m_pMap->GetLight(Pos, Submap ) : NULL;	};
+	void				SetBroadphase(GBroadphase* pBroadphase);	//	change broadphase type, world takes ownership
+	inline GBroadphase*	Broadphase()							{	return m_pBroadphase;	};
+	u32					PhysicsChecksum();						//	hash of the physics objects' state, to check deterministic runs match
+	void				WakePhysicsObjects(const float3& Min, const float3& Max);	//	wake sleeping physics objects in this box (eg. after changing map geometry there)
+	void				WakePhysicsObjects(GAssetRef MapObjectRef);				//	wake sleeping physics objects touching this mapobject's mesh
+	void				AddMapObject(int SubMapIndex, GAssetRef MapObjectRef);		//	add a mapobject to a submap and wake the physics objects around it
+	void				RemoveMapObject(int SubMapIndex, GAssetRef MapObjectRef);	//	remove a mapobject from a submap and wake the physics objects that were resting on it
+	Bool				ChangeMapObjectRef(int SubMapIndex, GAssetRef MapObjectRef, GAssetRef NewRef);	//	swap a submap's mapobject and wake the physics objects around both
 
 protected:
 	Bool				RemoveObjectFromSubmapList( GGameObject* pObject, int SubMapIndex );
 	Bool				AddObjectToSubmapList( GGameObject* pObject, int SubMapIndex );
 	float4*				GetNearestLightPos(const float3& Pos);	//	find the nearest light for this pos
-	void				GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects);
+	void				GatherPhysicsTestCases(GList<GPhysicsObject*>& PhysicsObjects, Bool OnlyListed=FALSE);	//	fills the list with the awake objects to simulate, or with OnlyListed just gathers for the objects already in it
+	void				StepPhysics(float Delta);				//	do one physics step of Delta seconds
 	
 private:
 	void				BuildWorldRender(GWorldRender& WorldRender,GCamera* pCamera);	//	build a world render object
@@ -134,6 +134,10 @@ LIB32=link.exe -lib
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\GAnimCompressed.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GApp.cpp
 # End Source File
 # Begin Source File
@@ -150,6 +154,10 @@ SOURCE=.\GBinaryData.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\GBroadphase.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GCamera.cpp
 # End Source File
 # Begin Source File
@@ -226,6 +234,10 @@ SOURCE=.\GMesh.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\GMeshBVH.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GMouse.cpp
 # End Source File
 # Begin Source File
@@ -242,6 +254,10 @@ SOURCE=.\GPhysics.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\GPoseCache.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GQuaternion.cpp
 # End Source File
 # Begin Source File
@@ -282,6 +298,10 @@ SOURCE=.\GTexture.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\GThreadPool.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GTypes.cpp
 # End Source File
 # Begin Source File
@@ -318,6 +338,10 @@ SOURCE=.\GWorld.cpp
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\GAnimCompressed.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\GApp.h
 # End Source File
 # Begin Source File
@@ -334,6 +358,10 @@ SOURCE=.\GBinaryData.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\GBroadphase.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\GCamera.h
 # End Source File
 # Begin Source File
@@ -414,6 +442,10 @@ SOURCE=.\GMesh.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\GMeshBVH.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\GMouse.h
 # End Source File
 # Begin Source File
@@ -430,6 +462,10 @@ SOURCE=.\GPhysics.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\GPoseCache.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\GQuaternion.h
 # End Source File
 # Begin Source File
@@ -470,6 +506,10 @@ SOURCE=.\GTexture.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\GThreadPool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\GTypes.h
 # End Source File
 # Begin Source File